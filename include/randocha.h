@@ -10,6 +10,7 @@
 #endif
 
 #include <assert.h>
+#include <stdint.h>
 //------------------------------------------------------------------------------
 //  Randocha (Rand + Japanese TEA)
 //
@@ -35,6 +36,7 @@
 //
 //------------------------------------------------------------------------------
 #define randocha__NUM_GENERATED 8
+#define randocha__ROUND_KEY_INCREMENT 0x9E3779B9
 
 //------------------------------------------------------------------------------
 void
@@ -43,11 +45,46 @@ randocha__init(__m128i& curRoundKey)
   curRoundKey = _mm_set_epi32(0xA341316C, 0xC8013EA4, 0xAD90777D, 0x7E95761E);
 }
 
+//------------------------------------------------------------------------------
+// Initialise the round key from a seed, for independent/reproducible streams.
+// The seed is spread across all 128 bits of the key with SplitMix64.
+//------------------------------------------------------------------------------
+void
+randocha__seed(__m128i& curRoundKey, uint64_t seed)
+{
+  uint64_t mixed[2];
+  for (int i = 0; i < 2; ++i)
+  {
+    seed += 0x9E3779B97F4A7C15ull;
+    uint64_t z = seed;
+    z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    mixed[i]   = z ^ (z >> 31);
+  }
+
+  randocha__init(curRoundKey);
+  curRoundKey = _mm_xor_si128(
+    curRoundKey, _mm_set_epi64x((long long)mixed[1], (long long)mixed[0]));
+}
+
+//------------------------------------------------------------------------------
+// Skip ahead by numCalls calls to randocha__generate128i() in O(1).
+// The round key is a simple counter, so chunks of a stream can be generated
+// out of order (e.g. on several threads) and still match a sequential run.
+//------------------------------------------------------------------------------
+void
+randocha__discard(__m128i& curRoundKey, uint64_t numCalls)
+{
+  const uint32_t step = uint32_t(numCalls * randocha__ROUND_KEY_INCREMENT);
+  curRoundKey         = _mm_add_epi32(curRoundKey, _mm_set1_epi32((int)step));
+}
+
 //------------------------------------------------------------------------------
 __m128i
 randocha__generate128i(__m128i& curRoundKey)
 {
-  static const __m128i MAGIC_CONST = _mm_set1_epi32(0x9E3779B9);
+  static const __m128i MAGIC_CONST
+    = _mm_set1_epi32((int)randocha__ROUND_KEY_INCREMENT);
   __m128i randomBits               = _mm_aesenc_si128(curRoundKey, curRoundKey);
   curRoundKey                      = _mm_add_epi32(curRoundKey, MAGIC_CONST);
 
@@ -152,6 +189,17 @@ struct Randocha
   static const size_t NUM_GENERATED = randocha__NUM_GENERATED;
 
   Randocha() { randocha__init(m_curRoundKey); }
+  explicit Randocha(uint64_t seed) { randocha__seed(m_curRoundKey, seed); }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate(), i.e. numCalls * NUM_GENERATED
+  // random numbers. Any values buffered for next() are discarded.
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numCalls)
+  {
+    randocha__discard(m_curRoundKey, numCalls);
+    m_counter = NUM_GENERATED;
+  }
 
   //----------------------------------------------------------------------------
   // Generate random numbers and store the results in a user provided buffer
@@ -197,7 +245,7 @@ struct Randocha
   __m128i m_curRoundKey;
 
   size_t m_counter = NUM_GENERATED;    // force generate on first call to next()
-  float m_internalBuffer[NUM_GENERATED] = {};
+  alignas(16) float m_internalBuffer[NUM_GENERATED] = {};    // _mm_store_ps target
 };
 
 //------------------------------------------------------------------------------
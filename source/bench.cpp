@@ -1,9 +1,22 @@
 #include "randocha.h"
-#include "rand_sse.h"
-#include "rand_tea.h"
-#include "rand_mt.h"
-
+#include "generators.h"
+#include "block_buffer.h"
+#include "cli_args.h"
+#include "bench_report.h"
+#include "cpu_topology.h"
+#include "perf_counters.h"
+#include "bench_baseline.h"
+#include "bench_environment.h"
+#include "latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
 #include <vector>
 #include <numeric>
 #include <algorithm>
@@ -32,16 +45,116 @@
 //------------------------------------------------------------------------------
 #define UNREFERENCED_PARAMETER(P) (P)
 
-constexpr size_t NUM_SAMPLES = 100;
-constexpr size_t NUM_ROUNDS  = 1000;
+// CMake points this at the source tree, where the ctest regression gate looks
+#ifndef RANDOCHA_BASELINE_DIR
+#define RANDOCHA_BASELINE_DIR "bench_baselines"
+#endif
+
+constexpr size_t DEFAULT_NUM_SAMPLES       = 100;
+constexpr size_t DEFAULT_NUM_ROUNDS        = 1000;
+constexpr size_t DEFAULT_NUM_WARMUP_ROUNDS = 10;
+constexpr size_t DEFAULT_NUM_REPETITIONS   = 1;
+
+// Throughput mode sweeps buffer sizes in powers of two over this range. The
+// largest is well past any last level cache, but is capped at half the
+// available memory (see defaultMaxBufferBytes)
+constexpr uint64_t DEFAULT_MIN_BUFFER_BYTES = 1 << 10;
+constexpr uint64_t DEFAULT_MAX_BUFFER_BYTES = uint64_t(4) << 30;
+constexpr double DEFAULT_MIN_FILL_SECONDS   = 0.1;
+
+// Regression check: a generator regresses when its per-round minimum durations
+// are significantly larger (one-sided Mann-Whitney p < alpha) than the
+// baseline's and the median has grown by more than the threshold
+constexpr double DEFAULT_REGRESSION_THRESHOLD = 5.0;    // percent
+constexpr double DEFAULT_REGRESSION_ALPHA     = 0.01;
+
+// Scaling mode: per-thread buffers sized to stay in L2 by default
+constexpr uint64_t DEFAULT_THREAD_BUFFER_BYTES = 256 << 10;
+
+// Floats per timed call of the bulk fill API (4KB, so it stays in L1)
+constexpr size_t BULK_VALUES = 1024;
+
+// Resamples of the rounds for the 95% bootstrap confidence intervals
+constexpr size_t DEFAULT_NUM_BOOTSTRAP_RESAMPLES = 2000;
+
+// Scalar mode: values consumed per timed call by the batched patterns
+constexpr size_t SCALAR_VALUES = 64;
+
+struct BenchOptions
+{
+  size_t numSamples      = DEFAULT_NUM_SAMPLES;    // timed calls per round
+  size_t numRounds       = DEFAULT_NUM_ROUNDS;
+  size_t numWarmupRounds = DEFAULT_NUM_WARMUP_ROUNDS;    // timed, discarded
+  size_t numRepetitions  = DEFAULT_NUM_REPETITIONS;
+  std::vector<std::string> generators;    // empty = all
+  std::vector<std::string> apis;          // empty = all
+  std::string jsonFileName;
+  std::string csvFileName;
+  std::string histogramDir;    // per generator and API histogram CSVs
+
+  bool isThroughputMode   = false;
+  uint64_t minBufferBytes = DEFAULT_MIN_BUFFER_BYTES;
+  uint64_t maxBufferBytes = DEFAULT_MAX_BUFFER_BYTES;
+  double minFillSeconds   = DEFAULT_MIN_FILL_SECONDS;    // per buffer size
+
+  // Optional hardware counters, read over an extra untimed pass of the calls
+  PerfCounters* perfCounters = nullptr;
+
+  // Cost of the cpuid/rdtsc/rdtscp timing code itself, subtracted from every
+  // sample, and the TSC frequency used to convert cycles to nanoseconds
+  bool isCalibrating           = true;
+  uint64_t timingOverhead      = 0;      // cycles
+  double tscGhz                = 0.0;    // 0 = unknown
+  size_t numBootstrapResamples = DEFAULT_NUM_BOOTSTRAP_RESAMPLES;
+
+  bool isSavingBaseline      = false;
+  bool isCheckingBaseline    = false;
+  bool isBaselineRequired    = false;    // fail the check if there is none
+  std::string baselineFileName;
+  double regressionThreshold = DEFAULT_REGRESSION_THRESHOLD;
+  double regressionAlpha     = DEFAULT_REGRESSION_ALPHA;
+
+  bool isScalingMode         = false;
+  unsigned maxThreads        = 0;    // 0 = every CPU
+  uint64_t threadBufferBytes = DEFAULT_THREAD_BUFFER_BYTES;
+
+  bool isScalarMode = false;
+
+  // Pinning, SCHED_FIFO, locked memory and clock checks (bench_environment.h)
+  bool isControlled = false;
+  EnvironmentSettings environment;
+};
 
 //------------------------------------------------------------------------------
 using Durations     = std::vector<uint64_t>;
 using RandomNumbers = std::vector<float>;
 using ReturnValues  = float[Randocha::NUM_GENERATED];
 
+// A statistic with its 95% confidence interval, in cycles
+struct ConfidenceInterval
+{
+  double estimate = 0.0;
+  double low      = 0.0;
+  double high     = 0.0;
+};
+
 struct Results
 {
+  explicit Results(size_t numRounds)
+      : randomNumbers(numRounds)
+      , durations(numRounds)
+      , maxDurations(numRounds)
+      , minDurations(numRounds)
+      , rawMinDurations(numRounds, UINT64_MAX)
+      , avgDurations(numRounds)
+      , medianDurations(numRounds)
+      , variances(numRounds)
+      , deviations(numRounds)
+      , deviationRanges(numRounds)
+      , contextSwitches(numRounds)
+  {
+  }
+
   uint64_t avgDuration         = 0;
   uint64_t avgMinDuration      = 0;
   uint64_t avgVariance         = 0;
@@ -50,18 +163,38 @@ struct Results
   uint64_t varianceOfMins      = 0;
   uint64_t numOutliers         = 0;
   double varianceDeviation     = 0.0;
-
-  std::vector<RandomNumbers> randomNumbers
-    = std::vector<RandomNumbers>(NUM_ROUNDS);
-
-  std::vector<Durations> durations   = std::vector<Durations>(NUM_ROUNDS);
-  std::vector<uint64_t> maxDurations = std::vector<uint64_t>(NUM_ROUNDS);
-  std::vector<uint64_t> minDurations = std::vector<uint64_t>(NUM_ROUNDS);
-  std::vector<uint64_t> avgDurations = std::vector<uint64_t>(NUM_ROUNDS);
-
-  std::vector<uint64_t> variances       = std::vector<uint64_t>(NUM_ROUNDS);
-  std::vector<uint64_t> deviations      = std::vector<uint64_t>(NUM_ROUNDS);
-  std::vector<uint64_t> deviationRanges = std::vector<uint64_t>(NUM_ROUNDS);
+  // False when the outlier filter was skipped, or removed every round; the
+  // filtered averages above are then meaningless and aren't reported
+  bool hasFilteredAverages = false;
+
+  std::vector<RandomNumbers> randomNumbers;
+
+  std::vector<Durations> durations;
+  std::vector<uint64_t> maxDurations;
+  std::vector<uint64_t> minDurations;
+  // Before the timing overhead is subtracted, so comparable across runs
+  // whatever overhead each one calibrated
+  std::vector<uint64_t> rawMinDurations;
+  std::vector<uint64_t> avgDurations;
+  std::vector<double> medianDurations;
+
+  std::vector<uint64_t> variances;
+  std::vector<uint64_t> deviations;
+  std::vector<uint64_t> deviationRanges;
+
+  // Of the thread during each round, between its first and last call
+  std::vector<ContextSwitches> contextSwitches;
+
+  // Hardware counter totals divided by the number of calls
+  std::vector<std::string> counterNames;
+  std::vector<double> countersPerCall;
+
+  // Every sample of every round, outlier rounds included
+  LatencyHistogram histogram;
+
+  // Mean and median cycles per call, bootstrapped over all the rounds
+  ConfidenceInterval meanInterval;
+  ConfidenceInterval medianInterval;
 };
 
 //------------------------------------------------------------------------------
@@ -208,12 +341,36 @@ warmup(uint64_t& startTs, uint64_t& endTs, int cpuInfo[4], uint32_t& aux)
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Stops the compiler treating the generated values as unused
+//------------------------------------------------------------------------------
+static inline void
+escape(ReturnValues& values)
+{
+#if _MSC_VER
+  UNREFERENCED_PARAMETER(values);
+  _ReadWriteBarrier();
+#else
+  __asm__ __volatile__("" : : "r"(values) : "memory");
+#endif
+}
+
+//------------------------------------------------------------------------------
+// The warmup rounds are timed exactly like the others, then discarded
+//
+// Every round's storage is allocated and touched before the first round, so no
+// round allocates or page faults between its calls.
+//
+// Hardware counters are read over a separate pass of the same number of calls,
+// without the serializing cpuid/rdtsc timing code (whose own cycles, uops and
+// VM exits would swamp the counts of an 8 value call).
 //------------------------------------------------------------------------------
 template <typename Func>
 static Results
-runBenchmark(Func _funcToBenchmark)
+runBenchmark(const BenchOptions& options, Func _funcToBenchmark)
 {
-  Results results;
+  const size_t numSamples = options.numSamples;
+  Results results(options.numRounds);
 
   uint64_t start = 0;
   uint64_t end   = 0;
@@ -223,13 +380,27 @@ runBenchmark(Func _funcToBenchmark)
   int cpuInfo[4];
   warmup(start, end, cpuInfo, aux);
 
+  RandomNumbers warmupNumbers(numSamples * Randocha::NUM_GENERATED);
+  Durations warmupDurations(numSamples);
+  for (size_t i = 0; i < options.numRounds; ++i)
+  {
+    results.randomNumbers[i].resize(numSamples * Randocha::NUM_GENERATED);
+    results.durations[i].resize(numSamples);
+  }
+
   // Run benchmarks
-  for (size_t i = 0; i < NUM_ROUNDS; ++i)
+  const size_t numRounds = options.numWarmupRounds + options.numRounds;
+  for (size_t round = 0; round < numRounds; ++round)
   {
-    RandomNumbers randomNumbers(NUM_SAMPLES * Randocha::NUM_GENERATED);
-    Durations durations(NUM_SAMPLES);
-    ReturnValues values;
-    for (size_t j = 0; j < NUM_SAMPLES; ++j)
+    const bool isWarmup = round < options.numWarmupRounds;
+    const size_t i      = isWarmup ? 0 : round - options.numWarmupRounds;
+    RandomNumbers& randomNumbers
+      = isWarmup ? warmupNumbers : results.randomNumbers[i];
+    Durations& durations = isWarmup ? warmupDurations : results.durations[i];
+
+    const ContextSwitches switchesBefore = ContextSwitches::query();
+    ReturnValues values                  = {};
+    for (size_t j = 0; j < numSamples; ++j)
     {
       startTiming(start, cpuInfo, irqFlags);
 
@@ -243,11 +414,44 @@ runBenchmark(Func _funcToBenchmark)
         randomNumbers[(j * Randocha::NUM_GENERATED) + r] = values[r];
       }
 
-      uint64_t duration = (end > start) ? end - start : 0;
-      durations[j]      = duration;
+      const uint64_t elapsed = (end > start) ? end - start : 0;
+      durations[j]           = (elapsed > options.timingOverhead)
+                                 ? elapsed - options.timingOverhead
+                                 : 0;
+      if (!isWarmup)
+      {
+        results.rawMinDurations[i]
+          = std::min(results.rawMinDurations[i], elapsed);
+      }
+    }
+
+    if (!isWarmup)
+    {
+      results.contextSwitches[i] = ContextSwitches::query() - switchesBefore;
+    }
+  }
+
+  PerfCounters* counters = options.perfCounters;
+  if (counters && counters->isAvailable())
+  {
+    const size_t numCalls = options.numRounds * numSamples;
+    ReturnValues values   = {};
+    counters->start();
+    for (size_t i = 0; i < numCalls; ++i)
+    {
+      _funcToBenchmark(values);
+      escape(values);
+    }
+    const std::vector<double> counts = counters->stop();
+
+    if (!counts.empty())
+    {
+      results.counterNames = counters->names();
+      for (double count : counts)
+      {
+        results.countersPerCall.push_back(count / double(numCalls));
+      }
     }
-    results.randomNumbers[i] = std::move(randomNumbers);
-    results.durations[i]     = std::move(durations);
   }
 
   return results;
@@ -296,11 +500,15 @@ calculateVariance(std::vector<uint64_t> values, bool fromPartialSamples = false)
   return calculateVariance(values, calculateMean(values), fromPartialSamples);
 }
 
+//------------------------------------------------------------------------------
+// Per round statistics, then averages over the rounds that deviated by no more
+// than DEVIATION_LIMIT cycles (when isFilteringRounds)
 //------------------------------------------------------------------------------
 static void
-calculateVarianceInfo(Results& results)
+calculateVarianceInfo(Results& results, bool isFilteringRounds = true)
 {
-  for (size_t i = 0; i < NUM_ROUNDS; ++i)
+  const size_t numRounds = results.durations.size();
+  for (size_t i = 0; i < numRounds; ++i)
   {
     // Calculate mean, min, max durations
     uint64_t total       = 0;
@@ -310,6 +518,7 @@ calculateVarianceInfo(Results& results)
     auto& durations = results.durations[i];
     for (auto& duration : durations)
     {
+      results.histogram.record(duration);
       total += duration;
       if (duration < minDuration)
       {
@@ -325,6 +534,7 @@ calculateVarianceInfo(Results& results)
     const uint64_t mean = total / durations.size();
 
     results.avgDurations[i]    = mean;
+    results.medianDurations[i] = median(durations);
     results.maxDurations[i]    = maxDuration;
     results.minDurations[i]    = minDuration;
     results.deviationRanges[i] = maxDuration - minDuration;
@@ -334,6 +544,10 @@ calculateVarianceInfo(Results& results)
   }    // for ensembles
 
   results.varianceOfMins = calculateVariance(results.minDurations);
+  if (!isFilteringRounds)
+  {
+    return;
+  }
 
   // Remove the outlier results
   // Copy the data into new vectors skipping the outliers
@@ -341,22 +555,22 @@ calculateVarianceInfo(Results& results)
   std::vector<uint64_t> filteredRanges;
   std::vector<uint64_t> filteredMinDurations;
   std::vector<uint64_t> filteredAvgDurations;
-  filteredVariances.reserve(NUM_ROUNDS);
-  filteredRanges.reserve(NUM_ROUNDS);
-  filteredMinDurations.reserve(NUM_ROUNDS);
-  filteredAvgDurations.reserve(NUM_ROUNDS);
+  filteredVariances.reserve(numRounds);
+  filteredRanges.reserve(numRounds);
+  filteredMinDurations.reserve(numRounds);
+  filteredAvgDurations.reserve(numRounds);
 
-  assert(results.deviations.size() == NUM_ROUNDS);
+  assert(results.deviations.size() == numRounds);
   uint64_t numOutliers = 0;
-  for (size_t i = 0; i < NUM_ROUNDS; ++i)
+  for (size_t i = 0; i < numRounds; ++i)
   {
     static const uint64_t DEVIATION_LIMIT = 3;
-    while (i < NUM_ROUNDS && results.deviations[i] > DEVIATION_LIMIT)
+    while (i < numRounds && results.deviations[i] > DEVIATION_LIMIT)
     {
       ++i;    // skip and don't copy these ones
       ++numOutliers;
     }
-    if (i >= NUM_ROUNDS)
+    if (i >= numRounds)
     {
       break;
     }
@@ -385,14 +599,72 @@ calculateVarianceInfo(Results& results)
 
   results.varianceOfVariances
     = calculateVariance(filteredVariances, results.avgVariance);
-  results.varianceDeviation = sqrt(results.varianceOfVariances);
+  results.varianceDeviation   = sqrt(results.varianceOfVariances);
+  results.hasFilteredAverages = true;
+}
+
+//------------------------------------------------------------------------------
+// 95% percentile bootstrap interval of statistic(values), resampling values
+// with replacement (a fixed seed keeps reruns of the same data identical)
+//------------------------------------------------------------------------------
+template <typename T, typename Statistic>
+static ConfidenceInterval
+bootstrapInterval(
+  const std::vector<T>& values, size_t numResamples, Statistic statistic)
+{
+  ConfidenceInterval interval;
+  if (values.empty())
+  {
+    return interval;
+  }
+  interval.estimate = statistic(values);
+  interval.low = interval.high = interval.estimate;
+  if (numResamples == 0)
+  {
+    return interval;
+  }
+
+  std::mt19937_64 engine(0x5EED);
+  std::uniform_int_distribution<size_t> pick(0, values.size() - 1);
+  std::vector<T> resample(values.size());
+  std::vector<double> estimates(numResamples);
+  for (auto& estimate : estimates)
+  {
+    for (auto& value : resample)
+    {
+      value = values[pick(engine)];
+    }
+    estimate = statistic(resample);
+  }
+  std::sort(estimates.begin(), estimates.end());
+
+  interval.low  = estimates[size_t(0.025 * double(numResamples - 1) + 0.5)];
+  interval.high = estimates[size_t(0.975 * double(numResamples - 1) + 0.5)];
+  return interval;
+}
+
+//------------------------------------------------------------------------------
+// Rounds are the resampled unit (samples within a round aren't independent),
+// and every round is used, the outliers included
+//------------------------------------------------------------------------------
+static void
+calculateConfidenceIntervals(Results& results, size_t numResamples)
+{
+  results.meanInterval = bootstrapInterval(
+    results.avgDurations, numResamples, [](const std::vector<uint64_t>& v) {
+      return std::accumulate(v.begin(), v.end(), 0.0) / double(v.size());
+    });
+  results.medianInterval = bootstrapInterval(
+    results.medianDurations, numResamples, [](const std::vector<double>& v) {
+      return median(v);
+    });
 }
 
 //------------------------------------------------------------------------------
 static void
 printResults(Results& results)
 {
-  for (size_t i = 0; i < NUM_ROUNDS; ++i)
+  for (size_t i = 0; i < results.durations.size(); ++i)
   {
     std::cout << i << ":->  mean: " << results.avgDurations[i]
               << ", min: " << results.minDurations[i]
@@ -404,34 +676,1403 @@ printResults(Results& results)
   std::cout << "\n";
 }
 
+//------------------------------------------------------------------------------
+// Per call count of the named hardware counter, 0 if it wasn't counted
+//------------------------------------------------------------------------------
+static double
+counterPerCall(const Results& results, const std::string& name)
+{
+  for (size_t i = 0; i < results.counterNames.size(); ++i)
+  {
+    if (results.counterNames[i] == name)
+    {
+      return results.countersPerCall[i];
+    }
+  }
+  return 0.0;
+}
+
+//------------------------------------------------------------------------------
+// 0 if cycles or instructions weren't counted
+//------------------------------------------------------------------------------
+static double
+instructionsPerCycle(const Results& results)
+{
+  const double cycles = counterPerCall(results, "cycles");
+  return (cycles > 0.0) ? counterPerCall(results, "instructions") / cycles
+                        : 0.0;
+}
+
+//------------------------------------------------------------------------------
+// Fraction of branches mispredicted, 0 if they weren't counted
+//------------------------------------------------------------------------------
+static double
+branchMissRate(const Results& results)
+{
+  const double branches = counterPerCall(results, "branches");
+  return (branches > 0.0) ? counterPerCall(results, "branch_misses") / branches
+                          : 0.0;
+}
+
+//------------------------------------------------------------------------------
+// Context switches over every round, and the number of rounds that had any
+//------------------------------------------------------------------------------
+static ContextSwitches
+totalContextSwitches(const Results& results, uint64_t& numSwitchedRounds)
+{
+  ContextSwitches switches;
+  numSwitchedRounds = 0;
+  for (auto& round : results.contextSwitches)
+  {
+    switches += round;
+    numSwitchedRounds += (round.total() > 0) ? 1 : 0;
+  }
+  return switches;
+}
+
+//------------------------------------------------------------------------------
+static std::string
+formatInterval(const ConfidenceInterval& interval, double tscGhz)
+{
+  std::string text = fmt::format(
+    "{:.1f} cycles [{:.1f}, {:.1f}]",
+    interval.estimate,
+    interval.low,
+    interval.high);
+  if (tscGhz > 0.0)
+  {
+    text += fmt::format(
+      " = {:.2f} ns [{:.2f}, {:.2f}]",
+      interval.estimate / tscGhz,
+      interval.low / tscGhz,
+      interval.high / tscGhz);
+  }
+  return text;
+}
+
 //------------------------------------------------------------------------------
 static void
-printSummary(Results& results)
+printSummary(Results& results, double tscGhz)
 {
-  std::cout << "Benchmark Results:\n";
-  std::cout << "==================\n";
-  std::cout << "average duration: " << results.avgDuration << "\n"
-            << "average min duration: " << results.avgMinDuration << "\n";
+  if (results.hasFilteredAverages)
+  {
+    std::cout << "Benchmark Results:\n";
+    std::cout << "==================\n";
+    std::cout << "average duration: " << results.avgDuration << "\n"
+              << "average min duration: " << results.avgMinDuration << "\n";
+    std::cout << "\n";
+  }
 
-  std::cout << "\n";
   std::cout << "Quality of Results:\n";
   std::cout << "===================\n";
-  std::cout << "number of outlier rounds removed: " << results.numOutliers
-            << " (from " << NUM_ROUNDS << ")\n"
-            << "average variance: " << results.avgVariance << " (error: +/-"
-            << sqrt(results.avgVariance) << " cycles)\n"
-            << "absolute max deviation: " << results.maxDeviationRange << "\n"
-            << "variance of variances: " << results.varianceOfVariances
-            << " (error: +/-" << results.varianceDeviation << " cycles)\n"
-            << "variance of min values: " << results.varianceOfMins << "\n"
+  if (results.hasFilteredAverages)
+  {
+    std::cout << "number of outlier rounds removed from the averages: "
+              << results.numOutliers << " (from " << results.durations.size()
+              << ")\n"
+              << "average variance: " << results.avgVariance << " (error: +/-"
+              << sqrt(results.avgVariance) << " cycles)\n"
+              << "absolute max deviation: " << results.maxDeviationRange
+              << "\n"
+              << "variance of variances: " << results.varianceOfVariances
+              << " (error: +/-" << results.varianceDeviation << " cycles)\n";
+  }
+  std::cout << "variance of min values: " << results.varianceOfMins << "\n";
+
+  uint64_t numSwitchedRounds = 0;
+  const ContextSwitches switches
+    = totalContextSwitches(results, numSwitchedRounds);
+  std::cout << "context switches: " << switches.voluntary << " voluntary, "
+            << switches.involuntary << " involuntary, in "
+            << numSwitchedRounds << " of " << results.contextSwitches.size()
+            << " rounds\n"
+            << "\n";
+
+  // The averages above skip noisy rounds; the tail is reported here instead
+  const LatencyHistogram& histogram = results.histogram;
+  const uint64_t p50                = histogram.percentile(50.0);
+  const uint64_t typical            = std::max<uint64_t>(p50, 1);
+  std::cout << "Latency Distribution (every sample, in cycles):\n";
+  std::cout << "===============================================\n";
+  std::cout << fmt::format(
+    "samples: {}, min: {}, p50: {}, p90: {}, p99: {}, p99.9: {}, max: {}\n",
+    histogram.count(),
+    histogram.min(),
+    p50,
+    histogram.percentile(90.0),
+    histogram.percentile(99.0),
+    histogram.percentile(99.9),
+    histogram.max());
+  std::cout << "samples over 2x p50: " << histogram.countAbove(2 * typical)
+            << ", over 10x p50: " << histogram.countAbove(10 * typical) << "\n"
+            << "\n";
+
+  std::cout << "Per Call, with 95% Bootstrap Confidence Intervals:\n";
+  std::cout << "==================================================\n";
+  std::cout << "mean: " << formatInterval(results.meanInterval, tscGhz) << "\n"
+            << "median: " << formatInterval(results.medianInterval, tscGhz)
             << "\n"
-            << std::flush;
+            << "\n";
+
+  if (!results.countersPerCall.empty())
+  {
+    std::cout << "Hardware Counters (per call):\n";
+    std::cout << "=============================\n";
+    for (size_t i = 0; i < results.counterNames.size(); ++i)
+    {
+      std::cout << results.counterNames[i] << ": "
+                << results.countersPerCall[i] << "\n";
+    }
+    const double ipc = instructionsPerCycle(results);
+    if (ipc > 0.0)
+    {
+      std::cout << "IPC: " << ipc << "\n";
+    }
+    std::cout << "\n";
+  }
+  std::cout << std::flush;
+}
+
+//------------------------------------------------------------------------------
+static void
+addResultsToReport(
+  BenchReport& report,
+  const char* mode,
+  const char* generator,
+  const char* api,
+  size_t valuesPerCall,
+  size_t repetition,
+  const BenchOptions& options,
+  const Results& results)
+{
+  const LatencyHistogram& histogram = results.histogram;
+  report.beginRecord();
+  report.add("mode", mode);
+  report.add("generator", generator);
+  report.add("api", api);
+  report.add("repetition", uint64_t(repetition));
+  report.add("samples", uint64_t(options.numSamples));
+  report.add("rounds", uint64_t(options.numRounds));
+  report.add("warmup_rounds", uint64_t(options.numWarmupRounds));
+  report.add("values_per_call", uint64_t(valuesPerCall));
+  if (results.hasFilteredAverages)
+  {
+    report.add("avg_duration", results.avgDuration);
+    report.add("avg_min_duration", results.avgMinDuration);
+    report.add("avg_variance", results.avgVariance);
+    report.add("max_deviation_range", results.maxDeviationRange);
+    report.add("variance_of_variances", results.varianceOfVariances);
+    report.add("variance_deviation", results.varianceDeviation);
+    report.add("num_outliers", results.numOutliers);
+  }
+  report.add("variance_of_mins", results.varianceOfMins);
+
+  uint64_t numSwitchedRounds = 0;
+  const ContextSwitches switches
+    = totalContextSwitches(results, numSwitchedRounds);
+  report.add("context_switches_voluntary", switches.voluntary);
+  report.add("context_switches_involuntary", switches.involuntary);
+  report.add("rounds_with_context_switches", numSwitchedRounds);
+  report.add("min", histogram.min());
+  report.add("p50", histogram.percentile(50.0));
+  report.add("p90", histogram.percentile(90.0));
+  report.add("p99", histogram.percentile(99.0));
+  report.add("p99_9", histogram.percentile(99.9));
+  report.add("max", histogram.max());
+  report.add("timing_overhead_cycles", options.timingOverhead);
+  report.add("tsc_ghz", options.tscGhz);
+
+  auto addInterval = [&](
+                       const std::string& name, const ConfidenceInterval& ci) {
+    report.add(name + "_cycles", ci.estimate);
+    report.add(name + "_ci_low_cycles", ci.low);
+    report.add(name + "_ci_high_cycles", ci.high);
+    if (options.tscGhz > 0.0)
+    {
+      report.add(name + "_ns", ci.estimate / options.tscGhz);
+      report.add(name + "_ci_low_ns", ci.low / options.tscGhz);
+      report.add(name + "_ci_high_ns", ci.high / options.tscGhz);
+    }
+  };
+  addInterval("mean", results.meanInterval);
+  addInterval("median", results.medianInterval);
+
+  for (size_t i = 0; i < results.counterNames.size(); ++i)
+  {
+    report.add("perf_" + results.counterNames[i], results.countersPerCall[i]);
+  }
+  const double ipc = instructionsPerCycle(results);
+  if (ipc > 0.0)
+  {
+    report.add("perf_ipc", ipc);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Each generator fills ReturnValues (8 floats) per timed call of run, and one
+// value per call of runNext (if it has a single value API)
+//------------------------------------------------------------------------------
+// Bulk fill of count floats (a multiple of 8)
+using FillFunc = std::function<void(float* values, size_t count)>;
+
+struct BenchGenerator
+{
+  const char* id;      // used on the command line and in reports
+  const char* title;
+  std::function<Results(const BenchOptions&)> run;
+  std::function<FillFunc()> makeFill;    // fill function owning a generator
+  std::function<Results(const BenchOptions&)> runNext = nullptr;
+  size_t valuesPerRun = Randocha::NUM_GENERATED;    // per timed call of run
+};
+
+//------------------------------------------------------------------------------
+// Every registered generator (generators.h) is timed with the same batched
+// call: one timed call fills ReturnValues through BulkGenerator, i.e. as many
+// consecutive blocks as make up 8 floats. An engine with larger blocks
+// generates one whole block per timed call instead, and the first 8 values
+// are kept. next() is timed when the engine has a single value API.
+//------------------------------------------------------------------------------
+template <typename Rand>
+static BenchGenerator
+makeBenchGenerator(const GeneratorEntry<Rand>& entry)
+{
+  using Generator             = BulkGenerator<Rand>;
+  constexpr size_t BLOCK_SIZE = Generator::BLOCK_SIZE;
+
+  BenchGenerator generator = {
+    entry.id,
+    entry.title,
+    [](const BenchOptions& options) {
+      Generator rand;
+      if constexpr ((Randocha::NUM_GENERATED % BLOCK_SIZE) == 0)
+      {
+        return runBenchmark(
+          options, [&rand](ReturnValues& values) { rand.fill(values); });
+      }
+      else
+      {
+        alignas(64) float block[BLOCK_SIZE];
+        return runBenchmark(options, [&rand, &block](ReturnValues& values) {
+          rand.fill(block);
+          std::copy(block, block + Randocha::NUM_GENERATED, values);
+        });
+      }
+    },
+    []() -> FillFunc {
+      auto rand = std::make_shared<Generator>();
+      return [rand](float* values, size_t count) { rand->fill(values, count); };
+    },
+    nullptr,
+    std::max<size_t>(BLOCK_SIZE, Randocha::NUM_GENERATED)};
+  if constexpr (Generator::Traits::HAS_NEXT)
+  {
+    generator.runNext = [](const BenchOptions& options) {
+      Generator rand;
+      return runBenchmark(
+        options, [&rand](ReturnValues& values) { values[0] = rand.next(); });
+    };
+  }
+  return generator;
+}
+
+//------------------------------------------------------------------------------
+static std::vector<BenchGenerator>
+benchGenerators()
+{
+  std::vector<BenchGenerator> generators = {
+    // Baseline benchmark, with no instructions
+    {"baseline",
+     "Baseline",
+     [](const BenchOptions& options) {
+       return runBenchmark(options, [](ReturnValues& values) {
+         values[0] = 0.0f;
+         values[1] = 1.0f;
+         values[2] = 2.0f;
+         values[3] = 3.0f;
+         values[4] = 4.0f;
+         values[5] = 5.0f;
+         values[6] = 6.0f;
+         values[7] = 7.0f;
+       });
+     },
+     []() -> FillFunc {
+       return [](float* values, size_t count) {
+         std::fill(values, values + count, 0.5f);
+       };
+     }},
+  };
+  forEachGenerator([&generators](const auto& entry) {
+    generators.push_back(makeBenchGenerator(entry));
+  });
+  return generators;
+}
+
+//------------------------------------------------------------------------------
+static void
+printHeading(const std::string& title)
+{
+  std::cout << "\n\n"
+            << title << "\n"
+            << std::string(title.size(), '=') << "\n";
+}
+
+//------------------------------------------------------------------------------
+// Median duration of an empty timed region, i.e. of the cpuid/rdtsc/rdtscp
+// sequence itself, measured the same way as every benchmark. The median rather
+// than the minimum, so that subtracting it leaves the generator's typical cost.
+//------------------------------------------------------------------------------
+static uint64_t
+calibrateTimingOverhead(const BenchOptions& options)
+{
+  BenchOptions calibration   = options;
+  calibration.perfCounters   = nullptr;
+  calibration.timingOverhead = 0;
+  Results results = runBenchmark(calibration, [](ReturnValues& values) {
+    escape(values);
+  });
+
+  LatencyHistogram histogram;
+  for (auto& durations : results.durations)
+  {
+    for (uint64_t duration : durations)
+    {
+      histogram.record(duration);
+    }
+  }
+  return histogram.percentile(50.0);
+}
+
+//------------------------------------------------------------------------------
+// TSC ticks per nanosecond. Intel CPUs report it in cpuid leaf 0x15 (crystal
+// clock * TSC ratio); elsewhere it is measured against the steady clock.
+//------------------------------------------------------------------------------
+static double
+calibrateTscGhz()
+{
+  uint32_t regs[4];
+  queryCpuid(0, 0, regs);
+  if (regs[0] >= 0x15)
+  {
+    queryCpuid(0x15, 0, regs);    // eax denominator, ebx numerator, ecx Hz
+    if (regs[0] != 0 && regs[1] != 0 && regs[2] != 0)
+    {
+      return (double(regs[2]) * double(regs[1])) / (double(regs[0]) * 1e9);
+    }
+  }
+
+  using Clock              = std::chrono::steady_clock;
+  const auto start         = Clock::now();
+  const uint64_t startTsc  = __rdtsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const uint64_t endTsc    = __rdtsc();
+  const double nanoseconds = std::chrono::duration<double, std::nano>(
+                               Clock::now() - start)
+                               .count();
+  return double(endTsc - startTsc) / nanoseconds;
+}
+
+//------------------------------------------------------------------------------
+// The ways of getting numbers out of a generator that are timed per call
+//------------------------------------------------------------------------------
+struct BenchApi
+{
+  const char* id;    // used on the command line and in reports
+  const char* title;
+  size_t valuesPerCall;
+};
+
+static const BenchApi BENCH_APIS[] = {
+  {"generate", "generate()", Randocha::NUM_GENERATED},
+  {"next", "next()", 1},
+  {"bulk", "bulk fill", BULK_VALUES},
+};
+
+//------------------------------------------------------------------------------
+// Times BULK_VALUES floats per call, through the generator's fill function
+//------------------------------------------------------------------------------
+static Results
+runBulk(const BenchOptions& options, const BenchGenerator& generator)
+{
+  FillFunc fill = generator.makeFill();
+  std::vector<float> buffer(BULK_VALUES);
+  return runBenchmark(options, [&fill, &buffer](ReturnValues& values) {
+    fill(buffer.data(), BULK_VALUES);
+    std::copy(buffer.begin(), buffer.begin() + Randocha::NUM_GENERATED, values);
+  });
+}
+
+//------------------------------------------------------------------------------
+// Columns p50 -> max of the summary table
+//------------------------------------------------------------------------------
+static std::string
+formatPercentiles(const LatencyHistogram& histogram)
+{
+  return fmt::format(
+    "{:>8} {:>8} {:>8} {:>8} {:>9}",
+    histogram.percentile(50.0),
+    histogram.percentile(90.0),
+    histogram.percentile(99.0),
+    histogram.percentile(99.9),
+    histogram.max());
+}
+
+//------------------------------------------------------------------------------
+// RDTSC timing of single calls of each API (generate, next, bulk)
+// Every round's raw minimum duration (timing overhead included) is collected
+// into roundMinimums, keyed by generator id (and ".<api>" for the APIs other
+// than generate).
+//------------------------------------------------------------------------------
+static void
+runLatency(
+  const BenchOptions& options,
+  const std::vector<const BenchGenerator*>& generators,
+  BenchReport& report,
+  BenchBaseline& roundMinimums)
+{
+  std::string table;
+  for (auto* generator : generators)
+  {
+    for (auto& api : BENCH_APIS)
+    {
+      const bool isSelected
+        = options.apis.empty()
+          || std::find(options.apis.begin(), options.apis.end(), api.id)
+               != options.apis.end();
+      const bool isNext = std::string(api.id) == "next";
+      if (!isSelected || (isNext && !generator->runNext))
+      {
+        continue;
+      }
+
+      const bool isGenerate = std::string(api.id) == "generate";
+      const std::string key = isGenerate
+                                ? generator->id
+                                : std::string(generator->id) + "." + api.id;
+      for (size_t rep = 0; rep < options.numRepetitions; ++rep)
+      {
+        Results results = isGenerate ? generator->run(options)
+                          : isNext   ? generator->runNext(options)
+                                     : runBulk(options, *generator);
+        calculateVarianceInfo(results);
+        calculateConfidenceIntervals(results, options.numBootstrapResamples);
+
+        std::string title = std::string(generator->title) + " " + api.title;
+        if (options.numRepetitions > 1)
+        {
+          title += " (repetition " + std::to_string(rep + 1) + " of "
+                   + std::to_string(options.numRepetitions) + ")";
+        }
+        printHeading(title);
+        // printResults(results);
+        printSummary(results, options.tscGhz);
+
+        addResultsToReport(
+          report,
+          "latency",
+          generator->id,
+          api.id,
+          isGenerate ? generator->valuesPerRun : api.valuesPerCall,
+          rep,
+          options,
+          results);
+        table += fmt::format(
+          "  {:<12} {:<9} {}\n",
+          generator->id,
+          api.id,
+          formatPercentiles(results.histogram));
+
+        if (!options.histogramDir.empty())
+        {
+          std::string fileName = options.histogramDir + "/" + generator->id
+                                 + "_" + api.id;
+          if (options.numRepetitions > 1)
+          {
+            fileName += "_" + std::to_string(rep + 1);
+          }
+          fileName += ".csv";
+          if (!results.histogram.writeCsv(fileName.c_str()))
+          {
+            std::cerr << "Failed writing " << fileName << "\n";
+          }
+        }
+
+        std::vector<uint64_t>& minimums = roundMinimums.rounds[key];
+        minimums.insert(
+          minimums.end(),
+          results.rawMinDurations.begin(),
+          results.rawMinDurations.end());
+      }
+    }
+  }
+
+  printHeading(fmt::format(
+    "Latency percentiles (cycles per call, every sample, {} cycles of timing "
+    "overhead subtracted)",
+    options.timingOverhead));
+  std::cout
+    << "  generator    api            p50      p90      p99    p99.9       max\n"
+    << table << std::flush;
+}
+
+//------------------------------------------------------------------------------
+// Scalar consumption, one value at a time as most call sites use a generator.
+// Randocha::next() refills its buffer on every 8th call, TEA's per value API
+// is getF() on a pair generated on every 2nd call, and MT returns one value
+// per generate(). Every registered generator is also timed through
+// BlockBuffer::next(), which refills 256 values at a time.
+//------------------------------------------------------------------------------
+struct ScalarRandocha
+{
+  float next() { return rand.next(); }
+
+  Randocha rand;
+};
+
+struct ScalarTea
+{
+  float next()
+  {
+    if (index == RandTea::NUM_GENERATED)
+    {
+      rand.generate();
+      index = 0;
+    }
+    return rand.getF(index++);
+  }
+
+  RandTea rand;
+  size_t index = RandTea::NUM_GENERATED;
+};
+
+struct ScalarMT
+{
+  float next() { return rand.generate(); }
+
+  RandMT rand;
+};
+
+//------------------------------------------------------------------------------
+// How the values are consumed within one timed call
+//   single       one value, so the distribution shows every refill separately
+//   independent  SCALAR_VALUES values, each stored on its own, so consecutive
+//                calls are free to overlap
+//   dependent    SCALAR_VALUES values folded into one serial chain, as when
+//                each value feeds the next computation
+//------------------------------------------------------------------------------
+enum class ScalarPattern
+{
+  Single,
+  Independent,
+  Dependent
+};
+
+struct ScalarPatternInfo
+{
+  const char* id;
+  ScalarPattern pattern;
+  size_t valuesPerCall;
+};
+
+static const ScalarPatternInfo SCALAR_PATTERNS[] = {
+  {"single", ScalarPattern::Single, 1},
+  {"independent", ScalarPattern::Independent, SCALAR_VALUES},
+  {"dependent", ScalarPattern::Dependent, SCALAR_VALUES},
+};
+
+//------------------------------------------------------------------------------
+template <typename Source>
+static Results
+runScalarPattern(const BenchOptions& options, ScalarPattern pattern)
+{
+  Source source;
+  switch (pattern)
+  {
+  case ScalarPattern::Single:
+    return runBenchmark(
+      options, [&source](ReturnValues& values) { values[0] = source.next(); });
+  case ScalarPattern::Independent:
+    return runBenchmark(options, [&source](ReturnValues& values) {
+      for (size_t i = 0; i < SCALAR_VALUES; ++i)
+      {
+        values[i % Randocha::NUM_GENERATED] = source.next();
+      }
+    });
+  case ScalarPattern::Dependent:
+  default:
+    return runBenchmark(options, [&source](ReturnValues& values) {
+      float chain = values[0];
+      for (size_t i = 0; i < SCALAR_VALUES; ++i)
+      {
+        chain = (chain * 0.5f) + source.next();
+      }
+      values[0] = chain;
+    });
+  }
+}
+
+//------------------------------------------------------------------------------
+struct ScalarGenerator
+{
+  const char* id;     // the generator's id in benchGenerators()
+  const char* api;    // "native" or "buffered" (BlockBuffer)
+  std::string title;
+  Results (*run)(const BenchOptions&, ScalarPattern);
+};
+
+static std::vector<ScalarGenerator>
+scalarGenerators()
+{
+  std::vector<ScalarGenerator> generators = {
+    {"randocha",
+     "native",
+     "Randocha::next()",
+     &runScalarPattern<ScalarRandocha>},
+    {"tea", "native", "RandTea::getF()", &runScalarPattern<ScalarTea>},
+    {"mt", "native", "RandMT::generate()", &runScalarPattern<ScalarMT>},
+  };
+  forEachGenerator([&generators](auto entry) {
+    using Rand = typename decltype(entry)::Type;
+    generators.push_back(
+      {entry.id,
+       "buffered",
+       std::string(entry.title) + " BlockBuffer::next()",
+       &runScalarPattern<BlockBuffer<Rand>>});
+  });
+  return generators;
+}
+
+//------------------------------------------------------------------------------
+// RDTSC timing of the scalar APIs in each consumption pattern, with the latency
+// distribution per timed call and the cost and branch misses per value
+//------------------------------------------------------------------------------
+static void
+runScalar(
+  const BenchOptions& options,
+  const std::vector<const BenchGenerator*>& generators,
+  BenchReport& report)
+{
+  std::string table;
+  for (auto& scalar : scalarGenerators())
+  {
+    const bool isSelected = std::any_of(
+      generators.begin(), generators.end(), [&scalar](auto* generator) {
+        return std::string(scalar.id) == generator->id;
+      });
+    if (!isSelected)
+    {
+      continue;
+    }
+
+    for (auto& pattern : SCALAR_PATTERNS)
+    {
+      // A single value call is a few cycles but for its refills, and a 64
+      // value call is long enough to take interrupts, so rounds always deviate
+      // by more than the filter allows: use the percentiles instead
+      Results results = scalar.run(options, pattern.pattern);
+      calculateVarianceInfo(results, false);
+      calculateConfidenceIntervals(results, options.numBootstrapResamples);
+
+      printHeading(scalar.title + ", " + pattern.id);
+      printSummary(results, options.tscGhz);
+
+      const double valuesPerCall = double(pattern.valuesPerCall);
+      const double cyclesPerValue
+        = results.meanInterval.estimate / valuesPerCall;
+      const double missesPerValue
+        = counterPerCall(results, "branch_misses") / valuesPerCall;
+      const double missRate = branchMissRate(results);
+      const std::string perfColumns
+        = results.countersPerCall.empty()
+            ? fmt::format("{:>11} {:>14}", "n/a", "n/a")
+            : fmt::format(
+              "{:>10.2f}% {:>14.4f}", 100.0 * missRate, missesPerValue);
+      table += fmt::format(
+        "  {:<12} {:<8} {:<12} {} {:>10.2f} {}\n",
+        scalar.id,
+        scalar.api,
+        pattern.id,
+        formatPercentiles(results.histogram),
+        cyclesPerValue,
+        perfColumns);
+
+      addResultsToReport(
+        report,
+        "scalar",
+        scalar.id,
+        scalar.api,
+        pattern.valuesPerCall,
+        0,
+        options,
+        results);
+      report.add("pattern", pattern.id);
+      report.add("cycles_per_value", cyclesPerValue);
+      report.add("branch_miss_rate", missRate);
+      report.add("branch_misses_per_value", missesPerValue);
+
+      if (!options.histogramDir.empty())
+      {
+        const std::string fileName = options.histogramDir + "/" + scalar.id
+                                     + "_scalar_" + scalar.api + "_"
+                                     + pattern.id + ".csv";
+        if (!results.histogram.writeCsv(fileName.c_str()))
+        {
+          std::cerr << "Failed writing " << fileName << "\n";
+        }
+      }
+    }
+  }
+
+  printHeading(fmt::format(
+    "Scalar APIs (cycles per timed call of 1 or {} values, {} cycles of "
+    "timing overhead subtracted)",
+    SCALAR_VALUES,
+    options.timingOverhead));
+  std::cout << "  generator    api      pattern           p50      p90      p99"
+               "    p99.9       max  cyc/value  br-miss%  br-miss/value\n"
+            << table << std::flush;
+}
+
+//------------------------------------------------------------------------------
+// Compares this run's per-round raw minimum durations against the baseline's.
+// Both include the timing code, rather than each having its own calibrated
+// overhead subtracted, so drift in the calibration can't read as a
+// regression. Returns false if any generator regressed.
+//------------------------------------------------------------------------------
+static bool
+checkRegressions(
+  const BenchOptions& options,
+  const BenchBaseline& baseline,
+  const BenchBaseline& current,
+  BenchReport& report)
+{
+  printHeading("Regression check against " + options.baselineFileName);
+  if (baseline.cpuModel != current.cpuModel)
+  {
+    std::cout << "Warning: baseline was recorded on '" << baseline.cpuModel
+              << "'\n";
+  }
+  if (baseline.numSamples != current.numSamples)
+  {
+    std::cout << "Warning: baseline used " << baseline.numSamples
+              << " samples per round, this run " << current.numSamples
+              << "\n";
+  }
+  std::cout << "Cycles per call include the timing overhead (baseline "
+            << baseline.timingOverhead << ", this run "
+            << current.timingOverhead << " cycles)\n";
+
+  std::cout << "  generator             baseline   current   change    p-value"
+               "  verdict\n";
+  bool isPassing = true;
+  for (auto& generator : current.rounds)
+  {
+    auto it = baseline.rounds.find(generator.first);
+    if (it == baseline.rounds.end())
+    {
+      std::cout << fmt::format(
+        "  {:<18}  not in baseline\n", generator.first);
+      continue;
+    }
+
+    const double baselineMedian = median(it->second);
+    const double currentMedian  = median(generator.second);
+    const double change
+      = (baselineMedian > 0.0)
+          ? 100.0 * ((currentMedian / baselineMedian) - 1.0)
+          : 0.0;
+    const MannWhitneyResult test
+      = mannWhitneyTest(generator.second, it->second);
+
+    const bool isRegressed = test.pValueGreater < options.regressionAlpha
+                             && change > options.regressionThreshold;
+    const bool isImproved = test.pValueLess < options.regressionAlpha
+                            && change < -options.regressionThreshold;
+    isPassing = isPassing && !isRegressed;
+
+    const double pValue
+      = (change >= 0.0) ? test.pValueGreater : test.pValueLess;
+    std::cout << fmt::format(
+      "  {:<18} {:>9.1f} {:>9.1f} {:>+7.1f}% {:>10.2e}  {}\n",
+      generator.first,
+      baselineMedian,
+      currentMedian,
+      change,
+      pValue,
+      isRegressed ? "REGRESSED" : isImproved ? "improved" : "ok");
+
+    report.beginRecord();
+    report.add("mode", "regression");
+    report.add("generator", generator.first);
+    report.add("baseline_median_cycles", baselineMedian);
+    report.add("current_median_cycles", currentMedian);
+    report.add("change_percent", change);
+    report.add("p_value", pValue);
+    report.add("regressed", uint64_t(isRegressed));
+  }
+  return isPassing;
+}
+
+//------------------------------------------------------------------------------
+// Bulk throughput, filling buffers from minBufferBytes to maxBufferBytes
+//
+// Each size is filled repeatedly (from the same buffer, so it stays resident in
+// whichever cache it fits) until minFillSeconds have passed. Nothing is
+// serialized inside the timed region, so unlike the RDTSC harness this shows
+// sustained generation speed, and where each generator becomes bound by the
+// L2, L3 or DRAM bandwidth. Cycles are TSC reference cycles.
+//------------------------------------------------------------------------------
+static void
+runThroughput(
+  const BenchOptions& options,
+  const std::vector<const BenchGenerator*>& generators,
+  BenchReport& report)
+{
+  using Clock            = std::chrono::steady_clock;
+  const size_t maxValues = size_t(options.maxBufferBytes / sizeof(float));
+
+  // Touch every page once up front, so page faults aren't timed
+  std::unique_ptr<float[]> buffer(new float[maxValues]);
+  std::fill(buffer.get(), buffer.get() + maxValues, 0.0f);
+
+  for (auto* generator : generators)
+  {
+    printHeading(std::string(generator->title) + " throughput");
+    std::cout << "  buffer      ns/value  values/cycle      GB/s\n";
+
+    FillFunc fill = generator->makeFill();
+    for (uint64_t bytes = options.minBufferBytes;
+         bytes <= options.maxBufferBytes;
+         bytes *= 2)
+    {
+      const size_t count = size_t(bytes / sizeof(float));
+      fill(buffer.get(), count);    // warm the caches and generator
+
+      uint64_t numFills       = 0;
+      const auto start        = Clock::now();
+      const uint64_t startTsc = __rdtsc();
+      double seconds          = 0.0;
+      // Small buffers are filled several times between clock reads
+      const uint64_t fillsPerCheck = std::max<uint64_t>(1, (1 << 20) / bytes);
+      do
+      {
+        for (uint64_t i = 0; i < fillsPerCheck; ++i)
+        {
+          fill(buffer.get(), count);
+        }
+        numFills += fillsPerCheck;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      } while (seconds < options.minFillSeconds);
+      const uint64_t cycles = __rdtsc() - startTsc;
+
+      const double numValues      = double(numFills) * double(count);
+      const double nsPerValue     = (seconds * 1e9) / numValues;
+      const double valuesPerCycle = numValues / double(cycles);
+      const double gbPerSecond
+        = (numValues * sizeof(float)) / (seconds * 1e9);
+
+      const std::string size
+        = (bytes < (1 << 20))   ? std::to_string(bytes >> 10) + " KB"
+          : (bytes < (1 << 30)) ? std::to_string(bytes >> 20) + " MB"
+                                : std::to_string(bytes >> 30) + " GB";
+      std::cout << fmt::format(
+        "  {:>8} {:>11.3f} {:>13.3f} {:>9.2f}\n",
+        size,
+        nsPerValue,
+        valuesPerCycle,
+        gbPerSecond);
+
+      report.beginRecord();
+      report.add("mode", "throughput");
+      report.add("generator", generator->id);
+      report.add("buffer_bytes", bytes);
+      report.add("fills", numFills);
+      report.add("ns_per_value", nsPerValue);
+      report.add("values_per_cycle", valuesPerCycle);
+      report.add("gb_per_second", gbPerSecond);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Fills per-thread buffers on one thread per entry of cpus for the given time.
+// Returns the aggregate values per second (each thread's own rate, summed).
+//------------------------------------------------------------------------------
+struct ThreadedFillResult
+{
+  double valuesPerSecond = 0.0;
+  unsigned numPinned     = 0;
+};
+
+static ThreadedFillResult
+runThreadedFill(
+  const BenchGenerator& generator,
+  const std::vector<unsigned>& cpus,
+  size_t bufferValues,
+  double seconds)
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::atomic<unsigned> numReady(0);
+  std::atomic<bool> isStarted(false);
+  std::atomic<bool> isStopped(false);
+  std::vector<double> rates(cpus.size(), 0.0);
+  std::vector<char> isPinned(cpus.size(), 0);
+
+  auto worker = [&](size_t index) {
+    isPinned[index] = pinCurrentThread(cpus[index]);
+
+    // Allocated and first touched after pinning, so it's local to the CPU
+    std::vector<float> buffer(bufferValues);
+    FillFunc fill = generator.makeFill();
+    fill(buffer.data(), bufferValues);
+
+    ++numReady;
+    while (!isStarted)
+    {
+      std::this_thread::yield();
+    }
+
+    uint64_t numFills = 0;
+    const auto start  = Clock::now();
+    auto end          = start;
+    while (!isStopped)
+    {
+      fill(buffer.data(), bufferValues);
+      ++numFills;
+      end = Clock::now();
+    }
+
+    const double elapsed = std::chrono::duration<double>(end - start).count();
+    rates[index]
+      = (elapsed > 0.0) ? double(numFills * bufferValues) / elapsed : 0.0;
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < cpus.size(); ++i)
+  {
+    threads.emplace_back(worker, i);
+  }
+  while (numReady < cpus.size())
+  {
+    std::this_thread::yield();
+  }
+  isStarted = true;
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  isStopped = true;
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  ThreadedFillResult result;
+  for (size_t i = 0; i < cpus.size(); ++i)
+  {
+    result.valuesPerSecond += rates[i];
+    result.numPinned += isPinned[i] ? 1 : 0;
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Aggregate throughput on 1 -> maxThreads pinned threads (powers of two, and
+// maxThreads), one generator and buffer per thread. Threads are placed on
+// separate physical cores first, then on SMT siblings.
+//
+// Then an SMT pairing test runs two threads on the siblings of one core, and
+// two on separate cores, to show how much the siblings contend (e.g. for the
+// AES unit).
+//------------------------------------------------------------------------------
+static void
+runScaling(
+  const BenchOptions& options,
+  const std::vector<const BenchGenerator*>& generators,
+  BenchReport& report)
+{
+  const CpuTopology topology = CpuTopology::query();
+  const std::vector<unsigned> order = topology.spreadOrder();
+  const unsigned maxThreads
+    = (options.maxThreads == 0) ? unsigned(order.size()) : options.maxThreads;
+  const size_t bufferValues
+    = size_t(options.threadBufferBytes / sizeof(float));
+
+  std::cout << "\n" << topology.cores.size() << " cores, " << order.size()
+            << " logical CPUs available\n";
+
+  std::vector<unsigned> threadCounts;
+  for (unsigned n = 1; n < maxThreads; n *= 2)
+  {
+    threadCounts.push_back(n);
+  }
+  threadCounts.push_back(maxThreads);
+
+  for (auto* generator : generators)
+  {
+    printHeading(std::string(generator->title) + " scaling");
+    std::cout << "  threads  Mvalues/s      GB/s  per thread  efficiency\n";
+
+    double singleRate = 0.0;
+    for (unsigned numThreads : threadCounts)
+    {
+      // More threads than CPUs wrap around (and are oversubscribed)
+      std::vector<unsigned> cpus(numThreads);
+      for (unsigned i = 0; i < numThreads; ++i)
+      {
+        cpus[i] = order[i % order.size()];
+      }
+
+      const ThreadedFillResult result = runThreadedFill(
+        *generator, cpus, bufferValues, options.minFillSeconds);
+      singleRate = (numThreads == 1) ? result.valuesPerSecond : singleRate;
+      const double efficiency
+        = result.valuesPerSecond / (double(numThreads) * singleRate);
+      const double gbPerSecond = (result.valuesPerSecond * sizeof(float)) / 1e9;
+
+      std::cout << fmt::format(
+        "  {:>7} {:>10.1f} {:>9.2f} {:>11.1f} {:>10.1f}%{}\n",
+        numThreads,
+        result.valuesPerSecond / 1e6,
+        gbPerSecond,
+        result.valuesPerSecond / (1e6 * numThreads),
+        efficiency * 100.0,
+        (result.numPinned == numThreads) ? "" : " (not all pinned)");
+
+      report.beginRecord();
+      report.add("mode", "scaling");
+      report.add("generator", generator->id);
+      report.add("threads", uint64_t(numThreads));
+      report.add("pinned_threads", uint64_t(result.numPinned));
+      report.add("thread_buffer_bytes", options.threadBufferBytes);
+      report.add("values_per_second", result.valuesPerSecond);
+      report.add("gb_per_second", gbPerSecond);
+      report.add("efficiency", efficiency);
+    }
+
+    // SMT pairing
+    auto smtCore = std::find_if(
+      topology.cores.begin(),
+      topology.cores.end(),
+      [](const std::vector<unsigned>& core) { return core.size() >= 2; });
+    if (smtCore == topology.cores.end() || topology.cores.size() < 2)
+    {
+      std::cout << "  SMT pairing: needs two cores, one with SMT siblings; "
+                   "skipped\n";
+      continue;
+    }
+
+    const unsigned otherCore = (smtCore == topology.cores.begin()) ? 1 : 0;
+    const std::vector<unsigned> siblings = {(*smtCore)[0], (*smtCore)[1]};
+    const std::vector<unsigned> separate
+      = {(*smtCore)[0], topology.cores[otherCore][0]};
+
+    const double seconds     = options.minFillSeconds;
+    const double siblingRate = runThreadedFill(
+                                 *generator, siblings, bufferValues, seconds)
+                                 .valuesPerSecond;
+    const double separateRate = runThreadedFill(
+                                  *generator, separate, bufferValues, seconds)
+                                  .valuesPerSecond;
+    const double ratio = siblingRate / separateRate;
+
+    std::cout << fmt::format(
+      "  SMT pairing: siblings (cpus {},{}) {:.1f} Mvalues/s, separate cores "
+      "(cpus {},{}) {:.1f} Mvalues/s, ratio {:.2f}\n",
+      siblings[0],
+      siblings[1],
+      siblingRate / 1e6,
+      separate[0],
+      separate[1],
+      separateRate / 1e6,
+      ratio);
+
+    report.beginRecord();
+    report.add("mode", "smt_pairing");
+    report.add("generator", generator->id);
+    report.add(
+      "sibling_cpus",
+      std::to_string(siblings[0]) + " " + std::to_string(siblings[1]));
+    report.add(
+      "separate_cpus",
+      std::to_string(separate[0]) + " " + std::to_string(separate[1]));
+    report.add("sibling_values_per_second", siblingRate);
+    report.add("separate_values_per_second", separateRate);
+    report.add("sibling_ratio", ratio);
+  }
+}
+
+//------------------------------------------------------------------------------
+static void
+printEnvironment(const BenchEnvironment& environment)
+{
+  printHeading("Controlled environment");
+  std::cout << "pinned to CPU: "
+            << ((environment.pinnedCpu >= 0)
+                  ? std::to_string(environment.pinnedCpu)
+                  : std::string("no"))
+            << "\n"
+            << "SCHED_FIFO: " << (environment.isRealtime ? "yes" : "no")
+            << "\n"
+            << "memory locked: " << (environment.isMemoryLocked ? "yes" : "no")
+            << "\n"
+            << "governor: "
+            << (environment.governor.empty() ? "unknown" : environment.governor)
+            << "\n"
+            << "turbo: "
+            << (environment.turbo.empty() ? "unknown" : environment.turbo)
+            << "\n";
+  for (auto& warning : environment.warnings)
+  {
+    std::cout << "Warning: " << warning << "\n";
+  }
+  std::cout << std::flush;
+}
+
+//------------------------------------------------------------------------------
+static void
+addEnvironmentToReport(
+  BenchReport& report, const BenchEnvironment& environment)
+{
+  report.beginRecord();
+  report.add("mode", "environment");
+  if (environment.pinnedCpu >= 0)
+  {
+    report.add("pinned_cpu", uint64_t(environment.pinnedCpu));
+  }
+  report.add("sched_fifo", uint64_t(environment.isRealtime));
+  report.add("memory_locked", uint64_t(environment.isMemoryLocked));
+  report.add("governor", environment.governor);
+  report.add("turbo", environment.turbo);
+  report.add("warnings", uint64_t(environment.warnings.size()));
+}
+
+//------------------------------------------------------------------------------
+// DEFAULT_MAX_BUFFER_BYTES, halved until it fits in half the available memory
+//------------------------------------------------------------------------------
+static uint64_t
+defaultMaxBufferBytes()
+{
+  const uint64_t available = queryAvailableMemory();
+  uint64_t bytes           = DEFAULT_MAX_BUFFER_BYTES;
+  while (available != 0 && bytes > available / 2
+         && bytes > DEFAULT_MIN_BUFFER_BYTES)
+  {
+    bytes /= 2;
+  }
+  return bytes;
+}
+
+//------------------------------------------------------------------------------
+static void
+printUsage()
+{
+  std::cout
+    << "Usage: randocha-bench [options]\n"
+       "  --generators <list> comma separated, from: baseline, randocha, sse,\n"
+       "                      sse8, tea, tea_simd, mt, sfmt, xoshiro256pp,\n"
+       "                      xoshiro128p, pcg32, pcg64, wyrand, splitmix64,\n"
+       "                      philox\n"
+       "                      (default: all)\n"
+       "  --samples <n>       timed calls per round (default 100)\n"
+       "  --rounds <n>        rounds per benchmark (default 1000)\n"
+       "  --warmup <n>        rounds run and discarded first (default 10)\n"
+       "  --repetitions <n>   times to repeat each benchmark (default 1)\n"
+       "  --apis <list>       comma separated, from: generate, next (for the\n"
+       "                      generators with a single value API), bulk\n"
+       "                      (1024 floats per call) (default: all)\n"
+       "  --histogram-dir <d> write each latency histogram there as CSV\n"
+       "                      (<generator>_<api>.csv) for plotting\n"
+       "  --no-calibration    don't subtract the timing code's own overhead\n"
+       "  --bootstrap <n>     resamples for the confidence intervals\n"
+       "                      (default 2000, 0 = none)\n"
+       "  --throughput        measure bulk fill throughput over a sweep of\n"
+       "                      buffer sizes instead\n"
+       "  --min-buffer <n>    smallest buffer in bytes (default 1024)\n"
+       "  --max-buffer <n>    largest buffer in bytes (default 4GB, or the power\n"
+       "                      of two below half the available memory)\n"
+       "  --min-time <s>      seconds to spend on each size (default 0.1)\n"
+       "  --scaling           measure aggregate throughput on 1 -> N pinned\n"
+       "                      threads, and SMT sibling contention\n"
+       "  --max-threads <n>   most threads to scale to (default: all CPUs)\n"
+       "  --thread-buffer <n> per-thread buffer in bytes (default 256KB)\n"
+       "  --scalar            time the single value APIs (randocha next(),\n"
+       "                      tea getF(), mt generate()) consumed singly, and\n"
+       "                      64 at a time independently or as a serial chain\n"
+       "  --controlled        pin to one CPU, lock and prefault memory, and\n"
+       "                      warn about the cpufreq governor and turbo\n"
+       "  --cpu <n>           CPU to pin to (default: first CPU of the last\n"
+       "                      core), implies --controlled\n"
+       "  --fifo              run as SCHED_FIFO, implies --controlled\n"
+       "  --priority <n>      SCHED_FIFO priority 1 -> 99 (default 1)\n"
+       "  --no-perf           don't read hardware performance counters\n"
+       "  --perf-raw <list>   extra raw counters as name=config, e.g. uops\n"
+       "                      on Skylake ports 0 and 5:\n"
+       "                      port0=0x01a1,port5=0x20a1\n"
+       "  --save-baseline     store this run as the machine's baseline\n"
+       "  --check-baseline    compare this run against the machine's\n"
+       "                      baseline, exiting with 2 on a regression\n"
+       "                      (passes if there is no baseline yet)\n"
+       "  --require-baseline  fail the check when there is no baseline\n"
+       "  --baseline-dir <d>  where baselines are kept, one per machine\n"
+       "                      (default: " RANDOCHA_BASELINE_DIR ")\n"
+       "  --baseline <file>   use this baseline file instead\n"
+       "  --threshold <pct>   slowdown of the median treated as a\n"
+       "                      regression (default 5)\n"
+       "  --alpha <p>         significance level (default 0.01)\n"
+       "  --json <file>       write the results as JSON\n"
+       "  --csv <file>        write the results as CSV\n";
 }
 
 //------------------------------------------------------------------------------
 int
-main()
+main(int argc, char* argv[])
 {
+  CliArgs args(argc, argv);
+  if (args.has("help"))
+  {
+    printUsage();
+    return 0;
+  }
+
+  BenchOptions options;
+  options.generators      = args.getList("generators");
+  options.apis            = args.getList("apis");
+  options.numSamples      = args.getUInt("samples", options.numSamples);
+  options.numRounds       = args.getUInt("rounds", options.numRounds);
+  options.numWarmupRounds = args.getUInt("warmup", options.numWarmupRounds);
+  options.numRepetitions  = args.getUInt("repetitions", options.numRepetitions);
+  options.jsonFileName    = args.getString("json", "");
+  options.csvFileName     = args.getString("csv", "");
+  options.histogramDir    = args.getString("histogram-dir", "");
+  options.isCalibrating   = !args.has("no-calibration");
+  options.numBootstrapResamples
+    = args.getUInt("bootstrap", options.numBootstrapResamples);
+
+  options.isThroughputMode = args.has("throughput");
+  options.minBufferBytes   = args.getUInt("min-buffer", options.minBufferBytes);
+  options.maxBufferBytes
+    = args.getUInt("max-buffer", defaultMaxBufferBytes());
+  options.minFillSeconds   = args.getDouble("min-time", options.minFillSeconds);
+
+  options.isScalingMode = args.has("scaling");
+  options.maxThreads
+    = static_cast<unsigned>(args.getUInt("max-threads", options.maxThreads));
+  options.threadBufferBytes
+    = args.getUInt("thread-buffer", options.threadBufferBytes);
+
+  options.isScalarMode = args.has("scalar");
+
+  options.isControlled
+    = args.has("controlled") || args.has("cpu") || args.has("fifo");
+  options.environment.cpu
+    = args.has("cpu") ? int(args.getUInt("cpu", 0)) : options.environment.cpu;
+  options.environment.isRealtime = args.has("fifo");
+  options.environment.realtimePriority = int(
+    args.getUInt("priority", uint64_t(options.environment.realtimePriority)));
+
+  const bool isPerfDisabled             = args.has("no-perf");
+  std::vector<PerfEventSpec> perfEvents = PerfCounters::defaultEvents();
+  if (!PerfCounters::parseRawEvents(args.getList("perf-raw"), perfEvents))
+  {
+    args.addError("--perf-raw expects name=config pairs");
+  }
+
+  options.isSavingBaseline   = args.has("save-baseline");
+  options.isCheckingBaseline = args.has("check-baseline");
+  options.isBaselineRequired = args.has("require-baseline");
+  const std::string baselineDir
+    = args.getString("baseline-dir", RANDOCHA_BASELINE_DIR);
+  options.baselineFileName = args.getString(
+    "baseline", baselineDir + "/" + machineName() + ".baseline");
+  options.regressionThreshold
+    = args.getDouble("threshold", options.regressionThreshold);
+  options.regressionAlpha = args.getDouble("alpha", options.regressionAlpha);
+
+  const std::vector<BenchGenerator> allGenerators = benchGenerators();
+  std::vector<const BenchGenerator*> generators;
+  for (auto& generator : allGenerators)
+  {
+    const bool isSelected
+      = options.generators.empty()
+        || std::find(
+             options.generators.begin(),
+             options.generators.end(),
+             generator.id)
+             != options.generators.end();
+    if (isSelected)
+    {
+      generators.push_back(&generator);
+    }
+  }
+  for (auto& id : options.generators)
+  {
+    auto matches = [&id](const BenchGenerator& g) { return id == g.id; };
+    if (std::none_of(allGenerators.begin(), allGenerators.end(), matches))
+    {
+      args.addError("Unknown generator: " + id);
+    }
+  }
+  for (auto& id : options.apis)
+  {
+    auto matches = [&id](const BenchApi& api) { return id == api.id; };
+    if (std::none_of(std::begin(BENCH_APIS), std::end(BENCH_APIS), matches))
+    {
+      args.addError("Unknown API: " + id);
+    }
+  }
+  if (options.numSamples == 0 || options.numRounds == 0)
+  {
+    args.addError("--samples and --rounds must be at least 1");
+  }
+  // Whole calls of every generator
+  const uint64_t bufferAlignment = largestBlockSize() * sizeof(float);
+  if (
+    options.minBufferBytes < bufferAlignment
+    || options.minBufferBytes % bufferAlignment != 0
+    || options.maxBufferBytes < options.minBufferBytes)
+  {
+    args.addError(fmt::format(
+      "--min-buffer must be a multiple of {} bytes, and no more than "
+      "--max-buffer",
+      bufferAlignment));
+  }
+  if (
+    options.threadBufferBytes < bufferAlignment
+    || options.threadBufferBytes % bufferAlignment != 0)
+  {
+    args.addError(fmt::format(
+      "--thread-buffer must be a multiple of {} bytes", bufferAlignment));
+  }
+  if (
+    int(options.isThroughputMode) + int(options.isScalingMode)
+      + int(options.isScalarMode)
+    > 1)
+  {
+    args.addError("Choose one of --throughput, --scaling and --scalar");
+  }
+  const bool usesBaseline
+    = options.isSavingBaseline || options.isCheckingBaseline;
+  if (
+    usesBaseline
+    && (options.isThroughputMode || options.isScalingMode
+        || options.isScalarMode))
+  {
+    args.addError("Baselines are only kept for the latency benchmark");
+  }
+  if (options.isControlled && options.isScalingMode)
+  {
+    args.addError("--scaling pins its own threads, so can't be --controlled");
+  }
+  if (
+    options.environment.realtimePriority < 1
+    || options.environment.realtimePriority > 99)
+  {
+    args.addError("--priority must be between 1 and 99");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
   if (!isRdtscpSupported())
   {
     return 1;
@@ -447,94 +2088,120 @@ main()
     std::cout << "AES-NI supported\n";
   }
 
-  // Baseline benchmark, with no instructions
-  Results baselineResults = runBenchmark([](ReturnValues& values) {
-    values[0] = 0.0f;
-    values[1] = 1.0f;
-    values[2] = 2.0f;
-    values[3] = 3.0f;
-    values[4] = 4.0f;
-    values[5] = 5.0f;
-    values[6] = 6.0f;
-    values[7] = 7.0f;
-  });
-  calculateVarianceInfo(baselineResults);
-  std::cout << "\n\n";
-  std::cout << "Baseline\n";
-  std::cout << "========\n";
-  // printResults(baselineResults);
-  printSummary(baselineResults);
+  const SystemInfo system = SystemInfo::query();
+  std::cout << "CPU: " << system.cpuModel << "\n";
+  BenchReport report(system);
+  int exitCode = 0;
 
-  Randocha rand;
-  Results randochaResults
-    = runBenchmark([&rand](ReturnValues& values) { rand.generate(values); });
-  calculateVarianceInfo(randochaResults);
-  std::cout << "\n\n";
-  std::cout << "Randocha\n";
-  std::cout << "========\n";
-  // printResults(randochaResults);
-  printSummary(randochaResults);
-
-  static_assert(
-    Randocha::NUM_GENERATED == RandSSE::NUM_GENERATED,
-    "Can't use ReturnValues for the SSE Benchmark as it has a different output size");
-  RandSSE randSseGen;
-  Results sseResults = runBenchmark(
-    [&randSseGen](ReturnValues& values) { randSseGen.rand_sse(values); });
-  calculateVarianceInfo(sseResults);
-  std::cout << "\n\n";
-  std::cout << "SSE\n";
-  std::cout << "===\n";
-  // printResults(sseResults);
-  printSummary(sseResults);
-
-  static_assert(
-    Randocha::NUM_GENERATED == RandTea::NUM_GENERATED * 4,
-    "TEA Benchmark only generates 2 values, need to call repeatedly to match required output size");
-  RandTea randTeaGen;
-  Results teaResults = runBenchmark([&randTeaGen](ReturnValues& values) {
-    randTeaGen.generate();
-    values[0] = randTeaGen.getF(0);
-    values[1] = randTeaGen.getF(1);
-    randTeaGen.generate();
-    values[2] = randTeaGen.getF(0);
-    values[3] = randTeaGen.getF(1);
-    randTeaGen.generate();
-    values[4] = randTeaGen.getF(0);
-    values[5] = randTeaGen.getF(1);
-    randTeaGen.generate();
-    values[6] = randTeaGen.getF(0);
-    values[7] = randTeaGen.getF(1);
-  });
-  calculateVarianceInfo(teaResults);
-  std::cout << "\n\n";
-  std::cout << "TEA\n";
-  std::cout << "===\n";
-  // printResults(teaResults);
-  printSummary(teaResults);
-
-  static_assert(
-    Randocha::NUM_GENERATED == RandMT::NUM_GENERATED * 8,
-    "MT Benchmark only generates 1 value, need to call repeatedly to match required output size");
-  RandMT randMtGen;
-  Results mtResults = runBenchmark([&randMtGen](ReturnValues& values) {
-    values[0] = randMtGen.generate();
-    values[1] = randMtGen.generate();
-    values[2] = randMtGen.generate();
-    values[3] = randMtGen.generate();
-    values[4] = randMtGen.generate();
-    values[5] = randMtGen.generate();
-    values[6] = randMtGen.generate();
-    values[7] = randMtGen.generate();
-  });
-  calculateVarianceInfo(mtResults);
-  std::cout << "\n\n";
-  std::cout << "Mersenne Twister\n";
-  std::cout << "================\n";
-  //printResults(mtResults);
-  printSummary(mtResults);
+  if (options.isControlled)
+  {
+    const BenchEnvironment environment
+      = BenchEnvironment::apply(options.environment);
+    printEnvironment(environment);
+    addEnvironmentToReport(report, environment);
+  }
+
+  if (options.isThroughputMode)
+  {
+    runThroughput(options, generators, report);
+  }
+  else if (options.isScalingMode)
+  {
+    runScaling(options, generators, report);
+  }
+  else
+  {
+    std::unique_ptr<PerfCounters> counters;
+    if (!isPerfDisabled)
+    {
+      counters = std::make_unique<PerfCounters>(perfEvents);
+      if (counters->isAvailable())
+      {
+        options.perfCounters = counters.get();
+      }
+      else
+      {
+        std::cout << "Hardware counters unavailable: " << counters->why()
+                  << "\n";
+      }
+    }
+    if (!options.histogramDir.empty())
+    {
+      std::error_code error;
+      std::filesystem::create_directories(options.histogramDir, error);
+    }
+
+    options.tscGhz = calibrateTscGhz();
+    if (options.isCalibrating)
+    {
+      options.timingOverhead = calibrateTimingOverhead(options);
+    }
+    std::cout << fmt::format(
+      "TSC: {:.3f} GHz, timing overhead subtracted: {} cycles\n",
+      options.tscGhz,
+      options.timingOverhead);
+
+    if (options.isScalarMode)
+    {
+      runScalar(options, generators, report);
+    }
+    else
+    {
+      BenchBaseline current;
+      current.cpuModel       = system.cpuModel;
+      current.numSamples     = options.numSamples;
+      current.timingOverhead = options.timingOverhead;
+      runLatency(options, generators, report, current);
+
+      if (options.isCheckingBaseline)
+      {
+        BenchBaseline baseline;
+        if (baseline.load(options.baselineFileName))
+        {
+          const bool isPassing
+            = checkRegressions(options, baseline, current, report);
+          exitCode = isPassing ? 0 : 2;
+        }
+        else
+        {
+          std::cout << "\nNo baseline at " << options.baselineFileName
+                    << (options.isBaselineRequired ? "\n"
+                                                   : ", skipping check\n");
+          exitCode = options.isBaselineRequired ? 1 : 0;
+        }
+      }
+
+      if (options.isSavingBaseline)
+      {
+        std::error_code error;
+        const std::filesystem::path path(options.baselineFileName);
+        if (path.has_parent_path())
+        {
+          std::filesystem::create_directories(path.parent_path(), error);
+        }
+        if (!current.save(options.baselineFileName))
+        {
+          std::cerr << "Failed writing " << options.baselineFileName << "\n";
+          return 1;
+        }
+        std::cout << "\nSaved baseline to " << options.baselineFileName
+                  << "\n";
+      }
+    }
+  }
+
+  if (!options.jsonFileName.empty() && !report.writeJson(options.jsonFileName))
+  {
+    std::cerr << "Failed writing " << options.jsonFileName << "\n";
+    return 1;
+  }
+  if (!options.csvFileName.empty() && !report.writeCsv(options.csvFileName))
+  {
+    std::cerr << "Failed writing " << options.csvFileName << "\n";
+    return 1;
+  }
 
-  return 0;
+  return exitCode;
 }
 
 //------------------------------------------------------------------------------
@@ -542,7 +2209,7 @@ main()
 static int __init
 bench_start(void)
 {
-  return main();
+  return main(0, nullptr);
 }
 
 static void __exit
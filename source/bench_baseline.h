@@ -0,0 +1,228 @@
+#pragma once
+
+#if _MSC_VER
+#include <cstdlib>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Stored benchmark baselines and the significance test used to compare a run
+// against them
+//
+// A baseline holds every round's duration for each generator, so later runs can
+// be compared distribution against distribution rather than mean against mean.
+// Durations are raw, including the timing code; the overhead calibrated for
+// the run is kept for reference only. The file is plain text:
+//   cpu_model <model string>
+//   samples <calls timed per round>
+//   timing_overhead <cycles>
+//   generator <id> <round 0> <round 1> ...
+//
+// Sources:
+// Mann & Whitney, On a Test of Whether one of Two Random Variables is
+// Stochastically Larger than the Other (1947)
+//------------------------------------------------------------------------------
+struct BenchBaseline
+{
+  std::string cpuModel;
+  uint64_t numSamples     = 0;
+  uint64_t timingOverhead = 0;    // not subtracted from the durations
+  std::map<std::string, std::vector<uint64_t>> rounds;
+
+  //----------------------------------------------------------------------------
+  bool save(const std::string& fileName) const
+  {
+    std::ofstream file(fileName);
+    file << "cpu_model " << cpuModel << "\n";
+    file << "samples " << numSamples << "\n";
+    file << "timing_overhead " << timingOverhead << "\n";
+    for (auto& generator : rounds)
+    {
+      file << "generator " << generator.first;
+      for (uint64_t duration : generator.second)
+      {
+        file << " " << duration;
+      }
+      file << "\n";
+    }
+    return bool(file);
+  }
+
+  //----------------------------------------------------------------------------
+  bool load(const std::string& fileName)
+  {
+    std::ifstream file(fileName);
+    if (!file)
+    {
+      return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+      std::istringstream fields(line);
+      std::string key;
+      fields >> key;
+      if (key == "cpu_model")
+      {
+        std::getline(fields >> std::ws, cpuModel);
+      }
+      else if (key == "samples")
+      {
+        fields >> numSamples;
+      }
+      else if (key == "timing_overhead")
+      {
+        fields >> timingOverhead;
+      }
+      else if (key == "generator")
+      {
+        std::string id;
+        fields >> id;
+        std::vector<uint64_t>& durations = rounds[id];
+        for (uint64_t duration; fields >> duration;)
+        {
+          durations.push_back(duration);
+        }
+      }
+    }
+    return !rounds.empty();
+  }
+};
+
+//------------------------------------------------------------------------------
+// Name of this machine, for the default baseline file name
+//------------------------------------------------------------------------------
+inline std::string
+machineName()
+{
+  std::string name;
+#if _MSC_VER
+  const char* computerName = std::getenv("COMPUTERNAME");
+  name                     = computerName ? computerName : "";
+#else
+  char hostName[256] = {};
+  if (gethostname(hostName, sizeof(hostName) - 1) == 0)
+  {
+    name = hostName;
+  }
+#endif
+
+  // Keep it usable as a file name
+  for (char& c : name)
+  {
+    const bool isSafe = std::isalnum(static_cast<unsigned char>(c))
+                        || c == '-' || c == '_' || c == '.';
+    c = isSafe ? c : '_';
+  }
+  return name.empty() ? "unknown" : name;
+}
+
+//------------------------------------------------------------------------------
+template <typename T>
+double
+median(std::vector<T> values)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+  const size_t mid = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + mid, values.end());
+  const double upper = double(values[mid]);
+  if (values.size() % 2 == 1)
+  {
+    return upper;
+  }
+  const double lower
+    = double(*std::max_element(values.begin(), values.begin() + mid));
+  return 0.5 * (lower + upper);
+}
+
+//------------------------------------------------------------------------------
+// Mann-Whitney U test of sample a against sample b, using the normal
+// approximation with tie and continuity corrections (fine for the hundreds of
+// rounds a benchmark collects)
+//------------------------------------------------------------------------------
+struct MannWhitneyResult
+{
+  double u             = 0.0;    // U statistic of a
+  double z             = 0.0;
+  double pValueGreater = 1.0;    // one-sided: a tends to be larger than b
+  double pValueLess    = 1.0;    // one-sided: a tends to be smaller than b
+};
+
+inline MannWhitneyResult
+mannWhitneyTest(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b)
+{
+  MannWhitneyResult result;
+  const double nA = double(a.size());
+  const double nB = double(b.size());
+  if (a.empty() || b.empty())
+  {
+    return result;
+  }
+
+  // Rank the pooled samples, giving ties their average rank
+  std::vector<std::pair<uint64_t, bool>> pooled;    // {value, is from a}
+  pooled.reserve(a.size() + b.size());
+  for (uint64_t value : a)
+  {
+    pooled.push_back({value, true});
+  }
+  for (uint64_t value : b)
+  {
+    pooled.push_back({value, false});
+  }
+  std::sort(pooled.begin(), pooled.end());
+
+  double rankSumA      = 0.0;
+  double tieCorrection = 0.0;    // sum of (t^3 - t) over groups of ties
+  for (size_t i = 0; i < pooled.size();)
+  {
+    size_t end = i;
+    while (end < pooled.size() && pooled[end].first == pooled[i].first)
+    {
+      ++end;
+    }
+    const double numTied     = double(end - i);
+    const double averageRank = (double(i + 1) + double(end)) / 2.0;
+    for (size_t j = i; j < end; ++j)
+    {
+      rankSumA += pooled[j].second ? averageRank : 0.0;
+    }
+    tieCorrection += (numTied * numTied * numTied) - numTied;
+    i = end;
+  }
+
+  const double n    = nA + nB;
+  result.u          = rankSumA - (nA * (nA + 1.0)) / 2.0;
+  const double mean = (nA * nB) / 2.0;
+  const double variance
+    = ((nA * nB) / 12.0) * ((n + 1.0) - tieCorrection / (n * (n - 1.0)));
+  if (variance <= 0.0)
+  {
+    return result;    // every value identical
+  }
+
+  const double sigma = std::sqrt(variance);
+  const double SQRT2 = 1.41421356237309504880;
+  result.z           = (result.u - mean) / sigma;
+  result.pValueGreater
+    = 0.5 * std::erfc(((result.u - mean - 0.5) / sigma) / SQRT2);
+  result.pValueLess
+    = 0.5 * std::erfc((-(result.u - mean + 0.5) / sigma) / SQRT2);
+  return result;
+}
+
+//------------------------------------------------------------------------------
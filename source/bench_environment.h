@@ -0,0 +1,253 @@
+#pragma once
+
+#include "cpu_topology.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// A controlled benchmark environment: the userspace counterpart of running as
+// a kernel module with interrupts disabled (AS_KERNEL_MODULE)
+//
+// The process is pinned to one CPU. SCHED_FIFO is optional, so that ordinary
+// tasks can't preempt a round. Memory is locked and prefaulted, so page faults
+// can't land in a round.
+//
+// The cpufreq governor and turbo state are read too. They change the core
+// clock under load, and so the TSC cycles each call takes.
+//
+// Every step that fails or finds something noisy adds a warning rather than
+// stopping the benchmark. The steps are Linux only; elsewhere each one reports
+// itself unsupported.
+//------------------------------------------------------------------------------
+struct EnvironmentSettings
+{
+  int cpu              = -1;    // -1 = the first CPU of the last core
+  bool isRealtime      = false;
+  int realtimePriority = 1;    // above every SCHED_OTHER task
+};
+
+//------------------------------------------------------------------------------
+struct BenchEnvironment
+{
+  static const size_t STACK_PREFAULT_BYTES = 256 << 10;
+
+  int pinnedCpu       = -1;    // -1 = not pinned
+  bool isRealtime     = false;
+  bool isMemoryLocked = false;
+  std::string governor;    // empty if unknown
+  std::string turbo;       // "on", "off", or empty if unknown
+  std::vector<std::string> warnings;
+
+  //----------------------------------------------------------------------------
+  static BenchEnvironment apply(const EnvironmentSettings& settings)
+  {
+    BenchEnvironment environment;
+#if defined(__linux__)
+    // CPU 0 usually takes the most interrupts, so default to the last core
+    const CpuTopology topology = CpuTopology::query();
+    const unsigned cpu = (settings.cpu >= 0) ? unsigned(settings.cpu)
+                         : topology.cores.empty()
+                           ? 0
+                           : topology.cores.back().front();
+    if (pinCurrentThread(cpu))
+    {
+      environment.pinnedCpu = int(cpu);
+    }
+    else
+    {
+      environment.warn(
+        "Unable to pin to CPU " + std::to_string(cpu) + ": "
+        + std::strerror(errno));
+    }
+
+    if (settings.isRealtime)
+    {
+      sched_param param = {};
+      param.sched_priority = settings.realtimePriority;
+      if (sched_setscheduler(0, SCHED_FIFO, &param) == 0)
+      {
+        environment.isRealtime = true;
+        // Realtime throttling still takes the CPU back for part of each period
+        const std::string runtime
+          = readLine("/proc/sys/kernel/sched_rt_runtime_us");
+        if (!runtime.empty() && runtime != "-1")
+        {
+          environment.warn(
+            "SCHED_FIFO is throttled to " + runtime
+            + "us per period (kernel.sched_rt_runtime_us)");
+        }
+      }
+      else
+      {
+        environment.warn(
+          std::string("Unable to use SCHED_FIFO: ") + std::strerror(errno)
+          + " (needs CAP_SYS_NICE or an rtprio limit)");
+      }
+    }
+
+#if defined(__GLIBC__)
+    // Keep freed memory mapped, so later allocations don't fault pages back in
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+    {
+      environment.isMemoryLocked = true;
+    }
+    else
+    {
+      environment.warn(
+        std::string("Unable to lock memory: ") + std::strerror(errno)
+        + " (needs CAP_IPC_LOCK or a higher memlock limit)");
+    }
+    prefaultStack();
+
+    const std::string cpuDir
+      = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/";
+    environment.governor = readLine(cpuDir + "scaling_governor");
+    if (environment.governor.empty())
+    {
+      environment.warn("cpufreq governor unknown (no cpufreq in sysfs)");
+    }
+    else if (environment.governor != "performance")
+    {
+      environment.warn(
+        "cpufreq governor is '" + environment.governor
+        + "', the clock varies with load (use 'performance')");
+    }
+
+    // intel_pstate reports no_turbo, acpi-cpufreq and amd-pstate report boost
+    const std::string noTurbo
+      = readLine("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    const std::string boost
+      = readLine("/sys/devices/system/cpu/cpufreq/boost");
+    environment.turbo = !noTurbo.empty() ? (noTurbo == "0" ? "on" : "off")
+                        : !boost.empty() ? (boost == "1" ? "on" : "off")
+                                         : "";
+    if (environment.turbo == "on")
+    {
+      environment.warn(
+        "Turbo is on, the clock depends on temperature and the load on other "
+        "cores");
+    }
+#else
+    (void)settings;
+    environment.warn("A controlled environment is only supported on Linux");
+#endif
+    return environment;
+  }
+
+private:
+  void warn(const std::string& warning) { warnings.push_back(warning); }
+
+  //----------------------------------------------------------------------------
+  // Empty if the file can't be read
+  //----------------------------------------------------------------------------
+  static std::string readLine(const std::string& fileName)
+  {
+    std::ifstream file(fileName);
+    std::string line;
+    std::getline(file, line);
+    return line;
+  }
+
+  //----------------------------------------------------------------------------
+  // Touches the stack the benchmark will grow into, so it's already mapped (and
+  // locked, after mlockall)
+  //----------------------------------------------------------------------------
+  static void prefaultStack()
+  {
+    volatile uint8_t stack[STACK_PREFAULT_BYTES];
+    for (size_t i = 0; i < STACK_PREFAULT_BYTES; i += 4096)
+    {
+      stack[i] = 0;
+    }
+    // Read back, so the writes are used (and not warned about or dropped)
+    volatile uint8_t sink = stack[STACK_PREFAULT_BYTES - 1];
+    (void)sink;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Context switches of the calling thread so far, for counting the switches
+// during a round (zero where unsupported)
+//------------------------------------------------------------------------------
+struct ContextSwitches
+{
+  uint64_t voluntary   = 0;    // blocked, e.g. on I/O or a page fault
+  uint64_t involuntary = 0;    // preempted
+
+  static ContextSwitches query()
+  {
+    ContextSwitches switches;
+#if defined(__linux__)
+    rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+    {
+      switches.voluntary   = uint64_t(usage.ru_nvcsw);
+      switches.involuntary = uint64_t(usage.ru_nivcsw);
+    }
+#endif
+    return switches;
+  }
+
+  uint64_t total() const { return voluntary + involuntary; }
+
+  ContextSwitches operator-(const ContextSwitches& other) const
+  {
+    ContextSwitches difference;
+    difference.voluntary   = voluntary - other.voluntary;
+    difference.involuntary = involuntary - other.involuntary;
+    return difference;
+  }
+
+  ContextSwitches& operator+=(const ContextSwitches& other)
+  {
+    voluntary += other.voluntary;
+    involuntary += other.involuntary;
+    return *this;
+  }
+};
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Memory that can be allocated without swapping, in bytes (0 = unknown)
+//------------------------------------------------------------------------------
+inline uint64_t
+queryAvailableMemory()
+{
+#if defined(__linux__)
+  std::ifstream file("/proc/meminfo");
+  std::string key;
+  uint64_t kilobytes = 0;
+  std::string unit;
+  while (file >> key >> kilobytes >> unit)
+  {
+    if (key == "MemAvailable:")
+    {
+      return kilobytes * 1024;
+    }
+  }
+  return 0;
+#elif _MSC_VER
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  return GlobalMemoryStatusEx(&status) ? uint64_t(status.ullAvailPhys) : 0;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Machine readable benchmark records
+//
+// A record is an ordered list of named fields. Records are collected during a
+// run and written out at the end as JSON ({"system": {...}, "results": [...]})
+// and/or CSV (one row per record, the system fields repeated on every row so
+// the file can be loaded as a single table).
+//------------------------------------------------------------------------------
+struct ReportField
+{
+  std::string name;
+  std::string value;    // already formatted
+  bool isString;
+};
+
+using ReportRecord = std::vector<ReportField>;
+
+//------------------------------------------------------------------------------
+// cpuid(leaf, subLeaf) -> {eax, ebx, ecx, edx}
+//------------------------------------------------------------------------------
+inline void
+queryCpuid(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+{
+#if _MSC_VER
+  int cpuInfo[4];
+  __cpuidex(cpuInfo, int(leaf), int(subLeaf));
+  for (int i = 0; i < 4; ++i)
+  {
+    regs[i] = uint32_t(cpuInfo[i]);
+  }
+#else
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+  __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Description of the machine and build, attached to every set of results
+//------------------------------------------------------------------------------
+struct SystemInfo
+{
+  std::string cpuModel;
+  std::string cpuFlags;      // space separated, of those relevant here
+  std::string compiler;
+  std::string buildFlags;    // instruction sets the executable was built for
+  std::string timestamp;     // UTC, ISO 8601
+
+  static SystemInfo query()
+  {
+    SystemInfo info;
+
+    uint32_t regs[4];
+    queryCpuid(0x80000000, 0, regs);
+    const uint32_t maxExtended = regs[0];
+    queryCpuid(0, 0, regs);
+    const uint32_t maxLeaf = regs[0];
+
+    if (maxExtended >= 0x80000004)
+    {
+      char brand[49] = {};
+      for (uint32_t i = 0; i < 3; ++i)
+      {
+        queryCpuid(0x80000002 + i, 0, regs);
+        std::memcpy(brand + (i * 16), regs, 16);
+      }
+      info.cpuModel = brand;
+      info.cpuModel.erase(0, info.cpuModel.find_first_not_of(' '));
+    }
+
+    auto addFlag = [&info](bool isPresent, const char* name) {
+      if (isPresent)
+      {
+        info.cpuFlags += info.cpuFlags.empty() ? name : std::string(" ") + name;
+      }
+    };
+
+    queryCpuid(1, 0, regs);
+    addFlag((regs[3] >> 26) & 1, "sse2");
+    addFlag((regs[2] >> 19) & 1, "sse4.1");
+    addFlag((regs[2] >> 20) & 1, "sse4.2");
+    addFlag((regs[2] >> 25) & 1, "aes");
+    addFlag((regs[2] >> 28) & 1, "avx");
+    if (maxLeaf >= 7)
+    {
+      queryCpuid(7, 0, regs);
+      addFlag((regs[1] >> 5) & 1, "avx2");
+      addFlag((regs[1] >> 16) & 1, "avx512f");
+      addFlag((regs[2] >> 9) & 1, "vaes");
+    }
+    if (maxExtended >= 0x80000001)
+    {
+      queryCpuid(0x80000001, 0, regs);
+      addFlag((regs[3] >> 27) & 1, "rdtscp");
+    }
+    if (maxExtended >= 0x80000007)
+    {
+      queryCpuid(0x80000007, 0, regs);
+      addFlag((regs[3] >> 8) & 1, "invariant_tsc");
+    }
+
+#if defined(__clang__)
+    info.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    info.compiler = "gcc " __VERSION__;
+#elif _MSC_VER
+    info.compiler = "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+    info.compiler = "unknown";
+#endif
+
+    info.buildFlags = "aes";
+#if defined(__AVX2__)
+    info.buildFlags += " avx2";
+#endif
+#if defined(__AVX512F__)
+    info.buildFlags += " avx512f";
+#endif
+#if defined(NDEBUG)
+    info.buildFlags += " ndebug";
+#endif
+
+    const std::time_t now = std::time(nullptr);
+    std::tm utc;
+#if _MSC_VER
+    gmtime_s(&utc, &now);
+#else
+    gmtime_r(&now, &utc);
+#endif
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    info.timestamp = timestamp;
+
+    return info;
+  }
+};
+
+//------------------------------------------------------------------------------
+class BenchReport
+{
+public:
+  explicit BenchReport(const SystemInfo& system)
+      : m_system(system)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Starts a new record; subsequent add() calls append fields to it
+  //----------------------------------------------------------------------------
+  void beginRecord() { m_records.emplace_back(); }
+
+  void add(const std::string& name, const std::string& value)
+  {
+    m_records.back().push_back({name, value, true});
+  }
+
+  void add(const std::string& name, const char* value)
+  {
+    add(name, std::string(value));
+  }
+
+  void add(const std::string& name, uint64_t value)
+  {
+    m_records.back().push_back({name, fmt::format("{}", value), false});
+  }
+
+  void add(const std::string& name, double value)
+  {
+    m_records.back().push_back({name, fmt::format("{:.10g}", value), false});
+  }
+
+  bool isEmpty() const { return m_records.empty(); }
+
+  //----------------------------------------------------------------------------
+  bool writeJson(const std::string& fileName) const
+  {
+    FILE* file = std::fopen(fileName.c_str(), "wb");
+    if (!file)
+    {
+      return false;
+    }
+
+    fmt::memory_buffer out;
+    fmt::format_to(out, "{{\n  \"system\": {{");
+    writeJsonFields(out, systemFields(), "\n    ");
+    fmt::format_to(out, "\n  }},\n  \"results\": [");
+    for (size_t i = 0; i < m_records.size(); ++i)
+    {
+      fmt::format_to(out, "{}\n    {{", (i == 0) ? "" : ",");
+      writeJsonFields(out, m_records[i], " ");
+      fmt::format_to(out, " }}");
+    }
+    fmt::format_to(out, "\n  ]\n}}\n");
+
+    const bool success
+      = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return (std::fclose(file) == 0) && success;
+  }
+
+  //----------------------------------------------------------------------------
+  // Columns are the union of every record's fields, in first seen order.
+  // Fields a record doesn't have are left empty.
+  //----------------------------------------------------------------------------
+  bool writeCsv(const std::string& fileName) const
+  {
+    FILE* file = std::fopen(fileName.c_str(), "wb");
+    if (!file)
+    {
+      return false;
+    }
+
+    const ReportRecord system = systemFields();
+    std::vector<std::string> columns;
+    for (auto& field : system)
+    {
+      columns.push_back(field.name);
+    }
+    for (auto& record : m_records)
+    {
+      for (auto& field : record)
+      {
+        auto it = std::find(columns.begin(), columns.end(), field.name);
+        if (it == columns.end())
+        {
+          columns.push_back(field.name);
+        }
+      }
+    }
+
+    fmt::memory_buffer out;
+    for (size_t c = 0; c < columns.size(); ++c)
+    {
+      fmt::format_to(out, "{}{}", (c == 0) ? "" : ",", columns[c]);
+    }
+    fmt::format_to(out, "\n");
+
+    for (auto& record : m_records)
+    {
+      for (size_t c = 0; c < columns.size(); ++c)
+      {
+        const ReportField* field = find(record, columns[c]);
+        field = field ? field : find(system, columns[c]);
+        fmt::format_to(out, "{}", (c == 0) ? "" : ",");
+        if (field)
+        {
+          writeCsvValue(out, *field);
+        }
+      }
+      fmt::format_to(out, "\n");
+    }
+
+    const bool success
+      = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return (std::fclose(file) == 0) && success;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  ReportRecord systemFields() const
+  {
+    return {
+      {"cpu_model", m_system.cpuModel, true},
+      {"cpu_flags", m_system.cpuFlags, true},
+      {"compiler", m_system.compiler, true},
+      {"build_flags", m_system.buildFlags, true},
+      {"timestamp", m_system.timestamp, true},
+    };
+  }
+
+  //----------------------------------------------------------------------------
+  static const ReportField*
+  find(const ReportRecord& record, const std::string& name)
+  {
+    for (auto& field : record)
+    {
+      if (field.name == name)
+      {
+        return &field;
+      }
+    }
+    return nullptr;
+  }
+
+  //----------------------------------------------------------------------------
+  static void writeJsonFields(
+    fmt::memory_buffer& out, const ReportRecord& record, const char* separator)
+  {
+    for (size_t i = 0; i < record.size(); ++i)
+    {
+      const ReportField& field = record[i];
+      fmt::format_to(
+        out, "{}{}\"{}\": ", (i == 0) ? "" : ",", separator, field.name);
+      if (!field.isString)
+      {
+        fmt::format_to(out, "{}", field.value);
+        continue;
+      }
+
+      fmt::format_to(out, "\"");
+      for (char c : field.value)
+      {
+        if (c == '"' || c == '\\')
+        {
+          fmt::format_to(out, "\\{}", c);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+          fmt::format_to(out, "\\u{:04x}", int(c));
+        }
+        else
+        {
+          out.push_back(c);
+        }
+      }
+      fmt::format_to(out, "\"");
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Strings are quoted, with embedded quotes doubled (RFC 4180)
+  //----------------------------------------------------------------------------
+  static void writeCsvValue(fmt::memory_buffer& out, const ReportField& field)
+  {
+    if (!field.isString)
+    {
+      fmt::format_to(out, "{}", field.value);
+      return;
+    }
+
+    out.push_back('"');
+    for (char c : field.value)
+    {
+      if (c == '"')
+      {
+        out.push_back('"');
+      }
+      out.push_back(c);
+    }
+    out.push_back('"');
+  }
+
+  SystemInfo m_system;
+  std::vector<ReportRecord> m_records;
+};
+
+//------------------------------------------------------------------------------
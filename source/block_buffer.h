@@ -0,0 +1,137 @@
+#pragma once
+
+#include "generators.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if _MSC_VER
+#define BLOCK_BUFFER_NOINLINE __declspec(noinline)
+#else
+#define BLOCK_BUFFER_NOINLINE __attribute__((noinline))
+#endif
+//------------------------------------------------------------------------------
+// Single values from any registered generator, through a cache line aligned
+// buffer of NUM_BUFFERED values refilled a whole buffer at a time
+//
+// next() is an index increment and a load, with one branch that is taken once
+// per buffer. The refill is kept out of line, so next() inlines small at every
+// call site, and the refill cost (one bulk fill, see BulkGenerator) is shared
+// by NUM_BUFFERED values. The default of 256 floats (1KB) stays in L1 with
+// room for the caller's own data; larger buffers amortise the refill further
+// at the cost of cache footprint.
+//
+// copy() hands out any number of values in the same sequence as next(),
+// filling whole blocks straight into the destination when it's 32-byte
+// aligned.
+//------------------------------------------------------------------------------
+template <typename Rand, size_t BUFFER_VALUES = 256>
+class BlockBuffer
+{
+public:
+  using Generator = BulkGenerator<Rand>;
+  using Output    = typename Generator::Output;
+
+  static const size_t CACHE_LINE     = 64;
+  static const size_t FILL_ALIGNMENT = 32;    // widest generator store (AVX2)
+  static const size_t NUM_BUFFERED   = BUFFER_VALUES;
+  static_assert(
+    (NUM_BUFFERED % Generator::BLOCK_SIZE) == 0,
+    "The buffer must hold a whole number of generator blocks");
+  static_assert(
+    ((NUM_BUFFERED * sizeof(Output)) % CACHE_LINE) == 0,
+    "The buffer must be a whole number of cache lines");
+
+  BlockBuffer() = default;
+  explicit BlockBuffer(uint64_t seed)
+      : m_rand(seed)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  Output next()
+  {
+    if (m_index == NUM_BUFFERED)
+    {
+      refill();
+    }
+    return m_buffer[m_index++];
+  }
+
+  //----------------------------------------------------------------------------
+  // Uniform in [0 -> range), by scaling the next value. The result keeps the
+  // generator's precision (16 or 24 bits), so the bias is below range / 2^16:
+  // fine for small ranges such as dice, see nextIndex otherwise.
+  //----------------------------------------------------------------------------
+  uint32_t nextInt(uint32_t range)
+  {
+    return uint32_t(double(next()) * double(range));
+  }
+
+  //----------------------------------------------------------------------------
+  // Uniform in [0 -> range) for ranges of any size, e.g. shuffles and sampling
+  // large arrays. The top 16 bits of three values (the precision every
+  // generator has, randocha and sse keep only 16) make a 48-bit fraction,
+  // which is scaled by multiply-shift, so the bias is below range / 2^48.
+  //----------------------------------------------------------------------------
+  uint64_t nextIndex(uint64_t range)
+  {
+    uint64_t bits = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+      bits = (bits << 16) | uint64_t(next() * 65536.0f);
+    }
+    uint64_t index;
+    mulHiLo64(bits << 16, range, index);
+    return index;
+  }
+
+  //----------------------------------------------------------------------------
+  // The next count values, as count calls to next() would return them
+  //----------------------------------------------------------------------------
+  void copy(Output* out, size_t count)
+  {
+    while (count != 0)
+    {
+      if (m_index == NUM_BUFFERED)
+      {
+        // Whole blocks straight into out, if it suits the generators' aligned
+        // stores, and the rest through a new buffer
+        const bool isAligned
+          = (reinterpret_cast<uintptr_t>(out) % FILL_ALIGNMENT) == 0;
+        const size_t numDirect
+          = isAligned ? count - (count % Generator::BLOCK_SIZE) : 0;
+        if (numDirect != 0)
+        {
+          m_rand.fill(out, numDirect);
+          out += numDirect;
+          count -= numDirect;
+          continue;
+        }
+        refill();
+      }
+
+      const size_t numBuffered = std::min(count, NUM_BUFFERED - m_index);
+      std::copy(m_buffer + m_index, m_buffer + m_index + numBuffered, out);
+      m_index += numBuffered;
+      out += numBuffered;
+      count -= numBuffered;
+    }
+  }
+
+  Generator& generator() { return m_rand; }
+
+private:
+  BLOCK_BUFFER_NOINLINE void refill()
+  {
+    m_rand.fill(m_buffer, NUM_BUFFERED);
+    m_index = 0;
+  }
+
+  alignas(CACHE_LINE) Output m_buffer[NUM_BUFFERED];
+  size_t m_index = NUM_BUFFERED;    // refill on the first call to next()
+  Generator m_rand;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Minimal command line parsing shared by the executables
+//
+// Accepts options of the form "--name value" and bare flags "--name".
+// Getters take a default value and record any parse errors, so a tool can query
+// all of its options first and then report every problem at once.
+//
+// e.g.
+// CliArgs args(argc, argv);
+// uint64_t count = args.getUInt("count", 100'000);
+// if (!args.validate(std::cerr)) { return 1; }
+//------------------------------------------------------------------------------
+class CliArgs
+{
+public:
+  CliArgs(int argc, char* argv[])
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      const std::string arg = argv[i];
+      if (arg.size() < 3 || arg[0] != '-' || arg[1] != '-')
+      {
+        m_errors.push_back("Unexpected argument: " + arg);
+        continue;
+      }
+
+      const std::string name = arg.substr(2);
+      const bool hasValue
+        = (i + 1 < argc)
+          && !(argv[i + 1][0] == '-' && argv[i + 1][1] == '-');
+      m_options[name] = hasValue ? argv[++i] : "";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool has(const std::string& name) const
+  {
+    m_queried.insert(name);
+    return m_options.find(name) != m_options.end();
+  }
+
+  //----------------------------------------------------------------------------
+  std::string getString(const std::string& name, const std::string& fallback)
+    const
+  {
+    m_queried.insert(name);
+    auto it = m_options.find(name);
+    return (it == m_options.end()) ? fallback : it->second;
+  }
+
+  //----------------------------------------------------------------------------
+  uint64_t getUInt(const std::string& name, uint64_t fallback) const
+  {
+    m_queried.insert(name);
+    auto it = m_options.find(name);
+    if (it == m_options.end())
+    {
+      return fallback;
+    }
+
+    const std::string& str = it->second;
+    char* end              = nullptr;
+    const uint64_t value   = std::strtoull(str.c_str(), &end, 0);
+    if (str.empty() || str[0] == '-' || *end != '\0')
+    {
+      m_errors.push_back(
+        "Option --" + name + " expects an unsigned integer, got '" + str + "'");
+      return fallback;
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  double getDouble(const std::string& name, double fallback) const
+  {
+    m_queried.insert(name);
+    auto it = m_options.find(name);
+    if (it == m_options.end())
+    {
+      return fallback;
+    }
+
+    const std::string& str = it->second;
+    char* end              = nullptr;
+    const double value     = std::strtod(str.c_str(), &end);
+    if (str.empty() || *end != '\0')
+    {
+      m_errors.push_back(
+        "Option --" + name + " expects a number, got '" + str + "'");
+      return fallback;
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  // Comma separated list e.g. "--generators randocha,tea"
+  //----------------------------------------------------------------------------
+  std::vector<std::string> getList(const std::string& name) const
+  {
+    std::vector<std::string> list;
+    std::string str = getString(name, "");
+    size_t start    = 0;
+    while (start < str.size())
+    {
+      size_t end = str.find(',', start);
+      if (end == std::string::npos)
+      {
+        end = str.size();
+      }
+      if (end > start)
+      {
+        list.push_back(str.substr(start, end - start));
+      }
+      start = end + 1;
+    }
+    return list;
+  }
+
+  //----------------------------------------------------------------------------
+  void addError(const std::string& error) const { m_errors.push_back(error); }
+
+  //----------------------------------------------------------------------------
+  // Reports parse errors and any options that were never queried.
+  // Call only after every option has been read.
+  //----------------------------------------------------------------------------
+  template <typename Stream>
+  bool validate(Stream& errStream) const
+  {
+    for (auto& option : m_options)
+    {
+      if (m_queried.find(option.first) == m_queried.end())
+      {
+        m_errors.push_back("Unknown option: --" + option.first);
+      }
+    }
+
+    for (auto& error : m_errors)
+    {
+      errStream << error << "\n";
+    }
+    return m_errors.empty();
+  }
+
+private:
+  std::map<std::string, std::string> m_options;
+  mutable std::set<std::string> m_queried;
+  mutable std::vector<std::string> m_errors;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,617 @@
+#pragma once
+
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "rand_simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+//------------------------------------------------------------------------------
+// Coherent noise built on the AES hash: value, gradient (Perlin) and simplex
+// noise in 2, 3 and 4 dimensions, and fBm sums of their octaves
+//
+// The classic implementations hash each lattice point through a 256 entry
+// permutation table, one dependent lookup per axis, and then look up its
+// gradient. Here a lattice point is hashed by a single aesenc instead, so
+// there are no tables to keep in cache and no gathers:
+//   - each lattice coordinate is multiplied by an odd constant (once per
+//     point, the neighbouring corners just add the constant)
+//   - their sum, which carries between the axes, and the scaled coordinates
+//     make one 128-bit block
+//   - one aesenc round with the seed as the round key, folded to 32 bits
+// One round on its own only mixes each byte through the S-box and MixColumns,
+// so the result would be a xor of per-axis terms and repeat along the axes;
+// the carries of the sum (and of an add in the fold) are what tie the axes
+// together.
+//
+// Four points are evaluated together, one per SSE lane, and their four blocks
+// transposed into the AES unit and back. A call evaluates NUM_POINTS (8 or 16)
+// points, several groups of four in flight to hide the aesenc latency.
+// Points are given as one array of coordinates per axis (SoA), e.g.
+// CoherentNoise<> noise(42);
+// noise.evaluate<NoiseType::Simplex>({xs, ys, zs}, out);
+// evaluatePoints() takes any number of points, and evaluateGrid() samples a
+// regular 2D or 3D grid (a slice of 4D) without the coordinate arrays.
+//
+// Results are in about [-1 -> 1]: value noise interpolates hashes in
+// [-1 -> 1), and gradient and simplex noise are scaled to that range with the
+// usual constants for their gradient sets.
+//
+// Sources:
+// Ken Perlin, Improving Noise (2002)
+// Stefan Gustavson, Simplex noise demystified (2005), and simplexnoise1234
+//------------------------------------------------------------------------------
+enum class NoiseType
+{
+  Value,
+  Perlin,
+  Simplex
+};
+
+//------------------------------------------------------------------------------
+// Fractional Brownian motion: octaves summed at rising frequency and falling
+// amplitude, normalised by the total amplitude. One octave is plain noise.
+//------------------------------------------------------------------------------
+struct FbmSettings
+{
+  size_t octaves   = 1;
+  float lacunarity = 2.0f;    // frequency multiplier per octave
+  float gain       = 0.5f;    // amplitude multiplier per octave
+};
+
+//------------------------------------------------------------------------------
+// width x height (x depth) samples, step lattice units apart, from origin.
+// x is consecutive in the output. A 4D grid is a 3D slice at w = origin[3].
+//------------------------------------------------------------------------------
+template <size_t DIMENSIONS>
+struct NoiseGrid
+{
+  size_t width             = 1;
+  size_t height            = 1;
+  size_t depth             = 1;    // 3D and 4D only
+  float origin[DIMENSIONS] = {};
+  float step               = 1.0f;
+};
+
+//------------------------------------------------------------------------------
+template <size_t POINTS = 8>
+class CoherentNoise
+{
+public:
+  static const size_t NUM_LANES  = 4;
+  static const size_t NUM_POINTS = POINTS;
+  static_assert(
+    NUM_POINTS != 0 && (NUM_POINTS % NUM_LANES) == 0,
+    "Points per call must be a multiple of 4");
+
+  // Odd constants the lattice coordinates are scaled by, one per axis
+  static constexpr uint32_t AXIS_PRIMES[4]
+    = {0x8DA6B343u, 0xD8163841u, 0xCB1AB31Fu, 0x165667B1u};
+
+  CoherentNoise()
+      : CoherentNoise(0)
+  {
+  }
+  explicit CoherentNoise(uint64_t seed)
+  {
+    const uint64_t lo = splitMix64(seed);
+    const uint64_t hi = splitMix64(seed);
+    m_key             = _mm_set_epi64x((long long)hi, (long long)lo);
+  }
+
+  //----------------------------------------------------------------------------
+  // NUM_POINTS points, their coordinates given as one array per axis
+  //----------------------------------------------------------------------------
+  template <NoiseType TYPE, size_t DIMENSIONS>
+  void evaluate(
+    const float* const (&axes)[DIMENSIONS],
+    float out[NUM_POINTS],
+    const FbmSettings& fbm = FbmSettings()) const
+  {
+    for (size_t point = 0; point < NUM_POINTS; point += NUM_LANES)
+    {
+      __m128 p[DIMENSIONS];
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        p[axis] = _mm_loadu_ps(axes[axis] + point);
+      }
+      _mm_storeu_ps(out + point, fbm4<TYPE, DIMENSIONS>(p, fbm));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Any number of points (the last call is padded)
+  //----------------------------------------------------------------------------
+  template <NoiseType TYPE, size_t DIMENSIONS>
+  void evaluatePoints(
+    const float* const (&axes)[DIMENSIONS],
+    size_t count,
+    float* out,
+    const FbmSettings& fbm = FbmSettings()) const
+  {
+    const size_t numWhole = count - (count % NUM_POINTS);
+    for (size_t point = 0; point < numWhole; point += NUM_POINTS)
+    {
+      const float* callAxes[DIMENSIONS];
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        callAxes[axis] = axes[axis] + point;
+      }
+      evaluate<TYPE, DIMENSIONS>(callAxes, out + point, fbm);
+    }
+
+    const size_t numLeft = count - numWhole;
+    if (numLeft != 0)
+    {
+      float padded[DIMENSIONS][NUM_POINTS] = {};
+      const float* paddedAxes[DIMENSIONS];
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        std::copy(axes[axis] + numWhole, axes[axis] + count, padded[axis]);
+        paddedAxes[axis] = padded[axis];
+      }
+      float values[NUM_POINTS];
+      evaluate<TYPE, DIMENSIONS>(paddedAxes, values, fbm);
+      std::copy(values, values + numLeft, out + numWhole);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Every sample of the grid, in x, then y, then z order
+  //----------------------------------------------------------------------------
+  template <NoiseType TYPE, size_t DIMENSIONS>
+  void evaluateGrid(
+    const NoiseGrid<DIMENSIONS>& grid,
+    float* out,
+    const FbmSettings& fbm = FbmSettings()) const
+  {
+    assert(DIMENSIONS != 2 || grid.depth == 1);
+
+    float coords[DIMENSIONS][NUM_POINTS];
+    const float* axes[DIMENSIONS];
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      axes[axis] = coords[axis];
+    }
+    float values[NUM_POINTS];
+
+    for (size_t z = 0; z < grid.depth; ++z)
+    {
+      for (size_t y = 0; y < grid.height; ++y)
+      {
+        // The axes after x are constant along a row
+        for (size_t axis = 1; axis < DIMENSIONS; ++axis)
+        {
+          const size_t index = (axis == 1) ? y : (axis == 2) ? z : 0;
+          std::fill(
+            coords[axis],
+            coords[axis] + NUM_POINTS,
+            grid.origin[axis] + float(index) * grid.step);
+        }
+
+        for (size_t x = 0; x < grid.width; x += NUM_POINTS)
+        {
+          for (size_t i = 0; i < NUM_POINTS; ++i)
+          {
+            coords[0][i] = grid.origin[0] + float(x + i) * grid.step;
+          }
+
+          const size_t count = std::min(size_t(NUM_POINTS), grid.width - x);
+          if (count == NUM_POINTS)
+          {
+            evaluate<TYPE, DIMENSIONS>(axes, out + x, fbm);
+          }
+          else
+          {
+            evaluate<TYPE, DIMENSIONS>(axes, values, fbm);
+            std::copy(values, values + count, out + x);
+          }
+        }
+        out += grid.width;
+      }
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  // Lane helpers (SSE2)
+  //----------------------------------------------------------------------------
+  static __m128i mulLo32(__m128i a, uint32_t constant)
+  {
+    const __m128i b    = _mm_set1_epi32(int(constant));
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+    return _mm_unpacklo_epi32(
+      _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+
+  // Rounds towards -infinity (cvttps rounds towards zero)
+  static __m128i floorToInt(__m128 x)
+  {
+    const __m128i truncated = _mm_cvttps_epi32(x);
+    const __m128 isAbove    = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), x);
+    return _mm_add_epi32(truncated, _mm_castps_si128(isAbove));
+  }
+
+  static __m128 select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  static __m128 isBelow(__m128i x, int limit)
+  {
+    return _mm_castsi128_ps(_mm_cmplt_epi32(x, _mm_set1_epi32(limit)));
+  }
+
+  // x negated where the given bit of hash is set
+  template <int BIT>
+  static __m128 flipSign(__m128 x, __m128i hash)
+  {
+    const __m128i sign = _mm_slli_epi32(_mm_srli_epi32(hash, BIT), 31);
+    return _mm_xor_ps(x, _mm_castsi128_ps(sign));
+  }
+
+  // 6t^5 - 15t^4 + 10t^3, so the second derivative is 0 at the lattice
+  static __m128 fade(__m128 t)
+  {
+    const __m128 inner = _mm_add_ps(
+      _mm_mul_ps(
+        t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+      _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+  }
+
+  static __m128 lerp(__m128 a, __m128 b, __m128 t)
+  {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+  }
+
+  //----------------------------------------------------------------------------
+  // The 32-bit hashes of four lattice points, given their scaled coordinates
+  // one axis per register (unused axes zero): a 4x4 transpose makes one block
+  // per point, and after the aesenc a transpose back lines the columns up for
+  // the fold. The fold adds two of its xors, as the carries remove most of the
+  // bias left by a single round.
+  //----------------------------------------------------------------------------
+  static __m128i hash4(const __m128i (&scaled)[4], __m128i key)
+  {
+    const __m128i sum = _mm_add_epi32(
+      _mm_add_epi32(scaled[0], scaled[1]), _mm_add_epi32(scaled[2], scaled[3]));
+    const __m128i last = _mm_xor_si128(scaled[2], scaled[3]);
+
+    __m128i blocks[4] = {sum, scaled[0], scaled[1], last};
+    transpose(blocks);
+    for (auto& block : blocks)
+    {
+      block = _mm_aesenc_si128(block, key);
+    }
+    transpose(blocks);
+    return _mm_add_epi32(
+      _mm_xor_si128(blocks[0], blocks[1]), _mm_xor_si128(blocks[2], blocks[3]));
+  }
+
+  static void transpose(__m128i (&rows)[4])
+  {
+    const __m128i t0 = _mm_unpacklo_epi32(rows[0], rows[1]);
+    const __m128i t1 = _mm_unpacklo_epi32(rows[2], rows[3]);
+    const __m128i t2 = _mm_unpackhi_epi32(rows[0], rows[1]);
+    const __m128i t3 = _mm_unpackhi_epi32(rows[2], rows[3]);
+    rows[0]          = _mm_unpacklo_epi64(t0, t1);
+    rows[1]          = _mm_unpackhi_epi64(t0, t1);
+    rows[2]          = _mm_unpacklo_epi64(t2, t3);
+    rows[3]          = _mm_unpackhi_epi64(t2, t3);
+  }
+
+  //----------------------------------------------------------------------------
+  // Hash of the lattice point at base (scaled coordinates), offset by one on
+  // the axes whose offset mask is set
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128i hashCorner(
+    const __m128i (&base)[DIMENSIONS],
+    const __m128i (&offsets)[DIMENSIONS],
+    __m128i key)
+  {
+    __m128i scaled[4] = {};
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      const __m128i step
+        = _mm_and_si128(offsets[axis], _mm_set1_epi32(int(AXIS_PRIMES[axis])));
+      scaled[axis] = _mm_add_epi32(base[axis], step);
+    }
+    return hash4(scaled, key);
+  }
+
+  template <size_t DIMENSIONS>
+  static __m128i hashCorner(
+    const __m128i (&base)[DIMENSIONS], size_t corner, __m128i key)
+  {
+    __m128i offsets[DIMENSIONS];
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      offsets[axis] = _mm_set1_epi32(((corner >> axis) & 1) ? -1 : 0);
+    }
+    return hashCorner(base, offsets, key);
+  }
+
+  //----------------------------------------------------------------------------
+  // Dot product of d with the gradient the hash selects: 8 in 2D ((1, 2)
+  // and (2, 1) with signs), Perlin's 12 cube edges (16 with repeats) in 3D,
+  // and the 32 edges of the hypercube in 4D
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128 gradientDot(__m128i hash, const __m128 (&d)[DIMENSIONS])
+  {
+    if constexpr (DIMENSIONS == 2)
+    {
+      const __m128 isX = isBelow(_mm_and_si128(hash, _mm_set1_epi32(7)), 4);
+      const __m128 u   = select(isX, d[0], d[1]);
+      const __m128 v   = select(isX, d[1], d[0]);
+      return _mm_add_ps(
+        flipSign<0>(u, hash),
+        _mm_mul_ps(_mm_set1_ps(2.0f), flipSign<1>(v, hash)));
+    }
+    else if constexpr (DIMENSIONS == 3)
+    {
+      const __m128i h   = _mm_and_si128(hash, _mm_set1_epi32(15));
+      const __m128 uIsX = isBelow(h, 8);
+      const __m128 vIsY = isBelow(h, 4);
+      const __m128 vIsX = _mm_castsi128_ps(_mm_cmpeq_epi32(
+        _mm_and_si128(h, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+      const __m128 u    = select(uIsX, d[0], d[1]);
+      const __m128 v    = select(vIsY, d[1], select(vIsX, d[0], d[2]));
+      return _mm_add_ps(flipSign<0>(u, hash), flipSign<1>(v, hash));
+    }
+    else
+    {
+      const __m128i h   = _mm_and_si128(hash, _mm_set1_epi32(31));
+      const __m128 uIsX = isBelow(h, 24);
+      const __m128 vIsY = isBelow(h, 16);
+      const __m128 wIsZ = isBelow(h, 8);
+      const __m128 u    = select(uIsX, d[0], d[1]);
+      const __m128 v    = select(vIsY, d[1], d[2]);
+      const __m128 w    = select(wIsZ, d[2], d[3]);
+      return _mm_add_ps(
+        _mm_add_ps(flipSign<0>(u, hash), flipSign<1>(v, hash)),
+        flipSign<2>(w, hash));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Lattice cells and the position within them
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static void locate(
+    const __m128 (&p)[DIMENSIONS],
+    __m128i (&base)[DIMENSIONS],
+    __m128 (&frac)[DIMENSIONS])
+  {
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      const __m128i cell = floorToInt(p[axis]);
+      frac[axis]         = _mm_sub_ps(p[axis], _mm_cvtepi32_ps(cell));
+      base[axis]         = mulLo32(cell, AXIS_PRIMES[axis]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Corner values blended along each axis in turn, with faded weights
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128 interpolate(
+    __m128 (&values)[size_t(1) << DIMENSIONS],
+    const __m128 (&frac)[DIMENSIONS])
+  {
+    size_t numValues = size_t(1) << DIMENSIONS;
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      const __m128 weight = fade(frac[axis]);
+      numValues /= 2;
+      for (size_t i = 0; i < numValues; ++i)
+      {
+        values[i] = lerp(values[2 * i], values[2 * i + 1], weight);
+      }
+    }
+    return values[0];
+  }
+
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128 value4(const __m128 (&p)[DIMENSIONS], __m128i key)
+  {
+    __m128i base[DIMENSIONS];
+    __m128 frac[DIMENSIONS];
+    locate(p, base, frac);
+
+    const size_t NUM_CORNERS = size_t(1) << DIMENSIONS;
+    __m128 values[NUM_CORNERS];
+    for (size_t corner = 0; corner < NUM_CORNERS; ++corner)
+    {
+      const __m128i hash = hashCorner(base, corner, key);
+      values[corner]
+        = _mm_mul_ps(_mm_cvtepi32_ps(hash), _mm_set1_ps(1.0f / 2147483648.0f));
+    }
+    return interpolate<DIMENSIONS>(values, frac);
+  }
+
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128 perlin4(const __m128 (&p)[DIMENSIONS], __m128i key)
+  {
+    // Scales to about [-1 -> 1], from simplexnoise1234's noise1234
+    static const float SCALES[5] = {0.0f, 0.0f, 0.507f, 0.936f, 0.87f};
+
+    __m128i base[DIMENSIONS];
+    __m128 frac[DIMENSIONS];
+    locate(p, base, frac);
+
+    const size_t NUM_CORNERS = size_t(1) << DIMENSIONS;
+    __m128 values[NUM_CORNERS];
+    for (size_t corner = 0; corner < NUM_CORNERS; ++corner)
+    {
+      __m128 d[DIMENSIONS];
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        d[axis] = ((corner >> axis) & 1)
+                    ? _mm_sub_ps(frac[axis], _mm_set1_ps(1.0f))
+                    : frac[axis];
+      }
+      values[corner] = gradientDot(hashCorner(base, corner, key), d);
+    }
+    return _mm_mul_ps(
+      interpolate<DIMENSIONS>(values, frac), _mm_set1_ps(SCALES[DIMENSIONS]));
+  }
+
+  //----------------------------------------------------------------------------
+  // The D + 1 corners of the simplex containing p, found by skewing space so
+  // the simplices tile the cubic lattice, then ranking p's coordinates within
+  // its cube: the k-th corner steps along the k highest ranked axes
+  //----------------------------------------------------------------------------
+  template <size_t DIMENSIONS>
+  static __m128 simplex4(const __m128 (&p)[DIMENSIONS], __m128i key)
+  {
+    // Kernel radius^2 and the scales to about [-1 -> 1], from simplexnoise1234
+    static const float RADII_SQUARED[5] = {0.0f, 0.0f, 0.5f, 0.6f, 0.6f};
+    static const float SCALES[5]        = {0.0f, 0.0f, 40.0f, 32.0f, 27.0f};
+
+    const float n            = float(DIMENSIONS);
+    const float skewFactor   = (std::sqrt(n + 1.0f) - 1.0f) / n;
+    const float unskewFactor = (1.0f - 1.0f / std::sqrt(n + 1.0f)) / n;
+
+    __m128 sum = p[0];
+    for (size_t axis = 1; axis < DIMENSIONS; ++axis)
+    {
+      sum = _mm_add_ps(sum, p[axis]);
+    }
+    const __m128 skew = _mm_mul_ps(sum, _mm_set1_ps(skewFactor));
+
+    __m128i cells[DIMENSIONS];
+    __m128i base[DIMENSIONS];
+    __m128i cellSum = _mm_setzero_si128();
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      cells[axis] = floorToInt(_mm_add_ps(p[axis], skew));
+      base[axis]  = mulLo32(cells[axis], AXIS_PRIMES[axis]);
+      cellSum     = _mm_add_epi32(cellSum, cells[axis]);
+    }
+    const __m128 unskew
+      = _mm_mul_ps(_mm_cvtepi32_ps(cellSum), _mm_set1_ps(unskewFactor));
+
+    __m128 d0[DIMENSIONS];
+    for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+    {
+      d0[axis] = _mm_sub_ps(
+        p[axis], _mm_sub_ps(_mm_cvtepi32_ps(cells[axis]), unskew));
+    }
+
+    // Of each pair of axes exactly one wins, the first on a tie
+    __m128i ranks[DIMENSIONS] = {};
+    for (size_t a = 0; a < DIMENSIONS; ++a)
+    {
+      for (size_t b = a + 1; b < DIMENSIONS; ++b)
+      {
+        const __m128i aWins = _mm_castps_si128(_mm_cmpge_ps(d0[a], d0[b]));
+        const __m128i bWins = _mm_add_epi32(aWins, _mm_set1_epi32(1));
+        ranks[a]            = _mm_sub_epi32(ranks[a], aWins);
+        ranks[b]            = _mm_add_epi32(ranks[b], bWins);
+      }
+    }
+
+    __m128 total = _mm_setzero_ps();
+    for (size_t k = 0; k <= DIMENSIONS; ++k)
+    {
+      __m128i offsets[DIMENSIONS];
+      __m128 d[DIMENSIONS];
+      __m128 distanceSquared = _mm_setzero_ps();
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        offsets[axis] = _mm_cmpgt_epi32(
+          ranks[axis], _mm_set1_epi32(int(DIMENSIONS) - int(k) - 1));
+        const __m128 offset
+          = _mm_and_ps(_mm_castsi128_ps(offsets[axis]), _mm_set1_ps(1.0f));
+        d[axis] = _mm_add_ps(
+          _mm_sub_ps(d0[axis], offset), _mm_set1_ps(float(k) * unskewFactor));
+        distanceSquared
+          = _mm_add_ps(distanceSquared, _mm_mul_ps(d[axis], d[axis]));
+      }
+
+      // (r^2 - |d|^2)^4 falls to 0 at the kernel's edge
+      __m128 t = _mm_sub_ps(
+        _mm_set1_ps(RADII_SQUARED[DIMENSIONS]), distanceSquared);
+      t        = _mm_max_ps(t, _mm_setzero_ps());
+      t        = _mm_mul_ps(t, t);
+      t        = _mm_mul_ps(t, t);
+
+      const __m128i hash = hashCorner(base, offsets, key);
+      total = _mm_add_ps(total, _mm_mul_ps(t, gradientDot(hash, d)));
+    }
+    return _mm_mul_ps(total, _mm_set1_ps(SCALES[DIMENSIONS]));
+  }
+
+  //----------------------------------------------------------------------------
+  template <NoiseType TYPE, size_t DIMENSIONS>
+  static __m128 noise4(const __m128 (&p)[DIMENSIONS], __m128i key)
+  {
+    static_assert(
+      DIMENSIONS >= 2 && DIMENSIONS <= 4, "Noise is 2, 3 or 4 dimensional");
+    if constexpr (TYPE == NoiseType::Value)
+    {
+      return value4(p, key);
+    }
+    else if constexpr (TYPE == NoiseType::Perlin)
+    {
+      return perlin4(p, key);
+    }
+    else
+    {
+      return simplex4(p, key);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Each octave hashes with its own key, so the octaves are uncorrelated
+  //----------------------------------------------------------------------------
+  template <NoiseType TYPE, size_t DIMENSIONS>
+  __m128 fbm4(const __m128 (&p)[DIMENSIONS], const FbmSettings& fbm) const
+  {
+    if (fbm.octaves <= 1)
+    {
+      return noise4<TYPE, DIMENSIONS>(p, m_key);
+    }
+
+    __m128 total        = _mm_setzero_ps();
+    float frequency     = 1.0f;
+    float amplitude     = 1.0f;
+    float sumAmplitudes = 0.0f;
+    for (size_t octave = 0; octave < fbm.octaves; ++octave)
+    {
+      __m128 scaled[DIMENSIONS];
+      for (size_t axis = 0; axis < DIMENSIONS; ++axis)
+      {
+        scaled[axis] = _mm_mul_ps(p[axis], _mm_set1_ps(frequency));
+      }
+      const __m128i key = _mm_add_epi32(
+        m_key, _mm_set1_epi32(int(uint32_t(octave) * 0x9E3779B9u)));
+      const __m128 octaveNoise = noise4<TYPE, DIMENSIONS>(scaled, key);
+      total
+        = _mm_add_ps(total, _mm_mul_ps(octaveNoise, _mm_set1_ps(amplitude)));
+
+      sumAmplitudes += amplitude;
+      frequency *= fbm.lacunarity;
+      amplitude *= fbm.gain;
+    }
+    return _mm_mul_ps(total, _mm_set1_ps(1.0f / sumAmplitudes));
+  }
+
+  __m128i m_key;
+};
+
+//------------------------------------------------------------------------------
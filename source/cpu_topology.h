@@ -0,0 +1,179 @@
+#pragma once
+
+#if _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+//------------------------------------------------------------------------------
+// Logical CPUs grouped by physical core, and thread pinning
+//
+// On Linux the SMT siblings of each CPU are read from sysfs. Elsewhere every
+// logical CPU is treated as its own core.
+//------------------------------------------------------------------------------
+struct CpuTopology
+{
+  // Logical CPU ids of each physical core, first sibling first
+  std::vector<std::vector<unsigned>> cores;
+
+  //----------------------------------------------------------------------------
+  static CpuTopology query()
+  {
+    CpuTopology topology;
+    std::vector<unsigned> cpus;
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+      for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+          cpus.push_back(cpu);
+        }
+      }
+    }
+#endif
+    if (cpus.empty())
+    {
+      const unsigned numCpus
+        = std::max(1u, std::thread::hardware_concurrency());
+      for (unsigned cpu = 0; cpu < numCpus; ++cpu)
+      {
+        cpus.push_back(cpu);
+      }
+    }
+
+    std::set<unsigned> assigned;
+    for (unsigned cpu : cpus)
+    {
+      if (assigned.count(cpu))
+      {
+        continue;
+      }
+
+      std::vector<unsigned> core;
+      for (unsigned sibling : readSiblings(cpu))
+      {
+        const bool isAllowed
+          = std::find(cpus.begin(), cpus.end(), sibling) != cpus.end();
+        if (isAllowed && !assigned.count(sibling))
+        {
+          core.push_back(sibling);
+          assigned.insert(sibling);
+        }
+      }
+      if (!assigned.count(cpu))
+      {
+        core.insert(core.begin(), cpu);
+        assigned.insert(cpu);
+      }
+      topology.cores.push_back(core);
+    }
+    return topology;
+  }
+
+  //----------------------------------------------------------------------------
+  size_t numCpus() const
+  {
+    size_t count = 0;
+    for (auto& core : cores)
+    {
+      count += core.size();
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  // One CPU from every core before any SMT siblings, so the first numCores
+  // threads of a scaling run don't share a core
+  //----------------------------------------------------------------------------
+  std::vector<unsigned> spreadOrder() const
+  {
+    std::vector<unsigned> order;
+    for (size_t sibling = 0; order.size() < numCpus(); ++sibling)
+    {
+      for (auto& core : cores)
+      {
+        if (sibling < core.size())
+        {
+          order.push_back(core[sibling]);
+        }
+      }
+    }
+    return order;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  // Parses a sysfs cpu list such as "0,4" or "0-1"
+  //----------------------------------------------------------------------------
+  static std::vector<unsigned> readSiblings(unsigned cpu)
+  {
+    std::vector<unsigned> siblings;
+#if defined(__linux__)
+    std::ifstream file(
+      "/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+      + "/topology/thread_siblings_list");
+    std::string list;
+    std::getline(file, list);
+
+    size_t start = 0;
+    while (start < list.size())
+    {
+      size_t end = list.find(',', start);
+      end        = (end == std::string::npos) ? list.size() : end;
+      const std::string range = list.substr(start, end - start);
+      const size_t dash       = range.find('-');
+      const unsigned first    = unsigned(std::stoul(range));
+      const unsigned last
+        = (dash == std::string::npos)
+            ? first
+            : unsigned(std::stoul(range.substr(dash + 1)));
+      for (unsigned id = first; id <= last; ++id)
+      {
+        siblings.push_back(id);
+      }
+      start = end + 1;
+    }
+#else
+    (void)cpu;
+#endif
+    return siblings;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Pins the calling thread to one logical CPU. Returns false if unsupported or
+// refused (e.g. the CPU is outside the container's cpuset).
+//------------------------------------------------------------------------------
+inline bool
+pinCurrentThread(unsigned cpu)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif _MSC_VER
+  return (cpu < 64)
+         && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
@@ -1,33 +1,466 @@
-#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <iostream>
-#include <iomanip>
+#include <string>
 #include <vector>
 
+#if _MSC_VER
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include <fmt/format.h>
+
 #include "randocha.h"
+#include "generators.h"
+#include "cli_args.h"
+#include "parallel.h"
+
+//------------------------------------------------------------------------------
+// Writes random numbers to a CSV file.
+//
+// Worker threads generate and format fixed size chunks of rows into their own
+// preallocated buffers, which are then written to the file in order. Each chunk
+// skips ahead in the Randocha stream, so the output is identical no matter how
+// many threads are used.
+//
+// Any generator in the registry can be exported as text. Those that can't skip
+// ahead are generated on one thread instead, as a single stream.
+//
+// In binary mode the raw 128-bit Randocha blocks are streamed instead (by
+// default forever), for piping into external test batteries e.g.
+//   randocha-csv --binary --output - | RNG_test stdin32
+//------------------------------------------------------------------------------
+constexpr size_t ROWS_PER_CHUNK = 1 << 16;
+
+constexpr size_t PAGE_SIZE           = 4096;
+constexpr size_t BINARY_CHUNK_BYTES  = 1 << 20;
+constexpr size_t PIPE_REQUESTED_SIZE = 1 << 20;
+
+struct ExportOptions
+{
+  uint64_t numRows      = 100'000;
+  uint64_t numColumns   = 1;
+  uint64_t precision    = 9;
+  bool isBinary         = false;
+  bool isSeeded         = false;
+  uint64_t seed         = 0;
+  std::string delimiter = ",";
+  std::string fileName  = "random_numbers.csv";
+  std::string generator = "randocha";
+  unsigned numThreads   = defaultThreadCount();
+};
+
+//------------------------------------------------------------------------------
+static void
+printUsage()
+{
+  std::cout
+    << "Usage: randocha-csv [options]\n"
+       "  --count <n>         number of rows (default 100000)\n"
+       "                      in binary mode: number of 32-bit words\n"
+       "                      (default 0, meaning stream forever)\n"
+       "  --binary            write raw generator output instead of text\n"
+       "  --columns <n>       values per row (default 1)\n"
+       "  --generator <id>    generator for text output (default randocha)\n"
+       "                      randocha, sse, sse8, tea, tea_simd, mt, sfmt,\n"
+       "                      xoshiro256pp, xoshiro128p, pcg32, pcg64,\n"
+       "                      wyrand, splitmix64, philox\n"
+       "  --seed <n>          seed the generator (default: unseeded stream)\n"
+       "  --precision <n>     digits after the decimal point (default 9)\n"
+       "  --delimiter <str>   separator between columns (default ',')\n"
+       "  --output <file>     output file name, '-' for stdout\n"
+       "                      (default random_numbers.csv)\n"
+       "  --threads <n>       worker threads (default: all cores)\n";
+}
+
+//------------------------------------------------------------------------------
+struct ChunkStorage
+{
+  std::vector<float> values;
+  fmt::memory_buffer text;
+};
+
+//------------------------------------------------------------------------------
+// Fills values with at least count values of the stream, starting at value
+// first, and returns the index of that value within them
+//------------------------------------------------------------------------------
+using ChunkValues    = std::vector<float>;
+using ChunkGenerator = std::function<size_t(
+  uint64_t first, uint64_t count, ChunkValues& values)>;
+
+struct ChunkSource
+{
+  ChunkGenerator generate;
+  bool isParallel;    // chunks can be generated in any order
+};
+
+//------------------------------------------------------------------------------
+template <typename Rand>
+static ChunkSource
+makeChunkSource(const ExportOptions& options)
+{
+  using Generator             = BulkGenerator<Rand>;
+  constexpr size_t BLOCK_SIZE = Generator::BLOCK_SIZE;
+  const bool isSeeded         = options.isSeeded;
+  const uint64_t seed         = options.seed;
 
-constexpr size_t NUM_FLOATS  = 100'000;
-constexpr size_t NUM_SAMPLES = NUM_FLOATS / Randocha::NUM_GENERATED;
-static_assert(
-  (NUM_FLOATS % Randocha::NUM_GENERATED) == 0,
-  "Please ensure that the buffer size will be an exact multiple of the number generated per call");
+  if constexpr (Generator::Traits::HAS_DISCARD)
+  {
+    // Generate from the block containing the first value of each chunk
+    auto generate = [=](uint64_t first, uint64_t count, ChunkValues& values) {
+      const uint64_t offset = first % BLOCK_SIZE;
+      Generator rand        = isSeeded ? Generator(seed) : Generator();
+      rand.discard(first / BLOCK_SIZE);
+
+      values.resize(Generator::wholeBlocks(size_t(offset + count)));
+      rand.fill(values.data(), values.size());
+      return size_t(offset);
+    };
+    return {generate, true};
+  }
+  else
+  {
+    // Chunks are produced in order from one stream. Chunks are a whole number
+    // of blocks, apart from the last
+    auto rand = isSeeded ? std::make_shared<Generator>(seed)
+                         : std::make_shared<Generator>();
+    auto generate = [=](
+                      [[maybe_unused]] uint64_t first,
+                      uint64_t count,
+                      ChunkValues& values) {
+      assert((first % BLOCK_SIZE) == 0);
+      values.resize(Generator::wholeBlocks(size_t(count)));
+      rand->fill(values.data(), values.size());
+      return size_t(0);
+    };
+    return {generate, false};
+  }
+}
+
+//------------------------------------------------------------------------------
+// Returns false if id isn't a registered generator
+//------------------------------------------------------------------------------
+static bool
+findChunkSource(
+  const std::string& id, const ExportOptions& options, ChunkSource& source)
+{
+  bool isFound = false;
+  forEachGenerator([&](auto entry) {
+    if (id == entry.id)
+    {
+      source  = makeChunkSource<typename decltype(entry)::Type>(options);
+      isFound = true;
+    }
+  });
+  return isFound;
+}
+
+//------------------------------------------------------------------------------
+static void
+formatChunk(
+  const ExportOptions& options,
+  const ChunkSource& source,
+  uint64_t chunk,
+  ChunkStorage& storage)
+{
+  const uint64_t firstRow = chunk * ROWS_PER_CHUNK;
+  const uint64_t numRows
+    = std::min<uint64_t>(ROWS_PER_CHUNK, options.numRows - firstRow);
+  const size_t offset = source.generate(
+    firstRow * options.numColumns,
+    numRows * options.numColumns,
+    storage.values);
+
+  const int precision = static_cast<int>(options.precision);
+  const float* values = storage.values.data() + offset;
+  auto& text          = storage.text;
+  text.clear();
+  for (uint64_t row = 0; row < numRows; ++row)
+  {
+    for (uint64_t col = 0; col < options.numColumns; ++col)
+    {
+      if (col != 0)
+      {
+        text.append(
+          options.delimiter.data(),
+          options.delimiter.data() + options.delimiter.size());
+      }
+      fmt::format_to(text, "{:.{}f}", *values++, precision);
+    }
+    text.push_back('\n');
+  }
+}
+
+//------------------------------------------------------------------------------
+// Writes the whole buffer, retrying short writes.
+// Returns false on error. A closed reader (EPIPE) is reported via isClosed.
+//------------------------------------------------------------------------------
+static bool
+writeAll(int fd, const uint8_t* data, size_t size, bool& isClosed)
+{
+  while (size > 0)
+  {
+#if _MSC_VER
+    const int chunk   = (int)std::min<size_t>(size, 1 << 30);
+    const int written = _write(fd, data, chunk);
+#else
+    const ssize_t written = write(fd, data, size);
+#endif
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      isClosed = (errno == EPIPE);
+      return false;
+    }
+    data += written;
+    size -= size_t(written);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+#if defined(__linux__)
+// Maps the buffer pages into the pipe rather than copying them.
+// The pages are referenced by the pipe until the reader consumes them, so the
+// caller must not modify the buffer until enough further data has been spliced
+// to have pushed it out of the pipe.
+static bool
+vmspliceAll(int fd, const uint8_t* data, size_t size, bool& isClosed)
+{
+  struct iovec iov;
+  iov.iov_base = const_cast<uint8_t*>(data);
+  iov.iov_len  = size;
+  while (iov.iov_len > 0)
+  {
+    const ssize_t written = vmsplice(fd, &iov, 1, 0);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      isClosed = (errno == EPIPE);
+      return false;
+    }
+    iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + written;
+    iov.iov_len -= size_t(written);
+  }
+  return true;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Streams raw Randocha blocks to the output.
+//
+// Generation is double buffered against the writes: worker threads fill
+// page aligned chunks while the main thread writes completed chunks in order.
+// When the output is a pipe on Linux the chunks are vmspliced, with chunks
+// sized to half the pipe so a chunk is guaranteed to have left the pipe once
+// the two chunks after it have been spliced.
+//------------------------------------------------------------------------------
+static int
+streamBinary(const ExportOptions& options, int fd)
+{
+#if _MSC_VER
+  _setmode(fd, _O_BINARY);
+#else
+  std::signal(SIGPIPE, SIG_IGN);    // report EPIPE from write() instead
+#endif
+
+  size_t chunkBytes     = BINARY_CHUNK_BYTES;
+  size_t slotReuseDelay = 0;
+  bool useVmsplice      = false;
+#if defined(__linux__)
+  fcntl(fd, F_SETPIPE_SZ, (int)PIPE_REQUESTED_SIZE);    // best effort
+  const int pipeSize = fcntl(fd, F_GETPIPE_SZ);
+  if (pipeSize >= int(2 * PAGE_SIZE))
+  {
+    useVmsplice    = true;
+    chunkBytes     = (size_t(pipeSize) / 2) & ~(PAGE_SIZE - 1);
+    slotReuseDelay = 2;
+  }
+#endif
+
+  const uint64_t blocksPerChunk = chunkBytes / sizeof(__m128i);
+  const uint64_t totalBytes     = options.numRows * sizeof(uint32_t);
+  const uint64_t numChunks
+    = (options.numRows == 0) ? UINT64_MAX
+                             : (totalBytes + chunkBytes - 1) / chunkBytes;
+
+  // One contiguous, page aligned allocation for every slot
+  const size_t numSlots = size_t(options.numThreads) * 2 + slotReuseDelay;
+  std::vector<uint8_t> storage((numSlots * chunkBytes) + PAGE_SIZE);
+  uint8_t* slotMemory = storage.data()
+                        + ((PAGE_SIZE - (uintptr_t(storage.data()) % PAGE_SIZE))
+                           % PAGE_SIZE);
+
+  bool isClosed      = false;
+  const bool success = orderedPipeline(
+    size_t(numChunks),
+    options.numThreads,
+    numSlots,
+    [&](size_t chunk, size_t slot) {
+      __m128i roundKey;
+      if (options.isSeeded)
+      {
+        randocha__seed(roundKey, options.seed);
+      }
+      else
+      {
+        randocha__init(roundKey);
+      }
+      randocha__discard(roundKey, chunk * blocksPerChunk);
+
+      __m128i* out = reinterpret_cast<__m128i*>(slotMemory + slot * chunkBytes);
+      for (uint64_t i = 0; i < blocksPerChunk; ++i)
+      {
+        _mm_store_si128(out + i, randocha__generate128i(roundKey));
+      }
+    },
+    [&](size_t chunk, size_t slot) {
+      const uint64_t written = uint64_t(chunk) * chunkBytes;
+      const size_t size
+        = (options.numRows == 0)
+            ? chunkBytes
+            : size_t(std::min<uint64_t>(chunkBytes, totalBytes - written));
+      const uint8_t* data = slotMemory + slot * chunkBytes;
+#if defined(__linux__)
+      if (useVmsplice)
+      {
+        return vmspliceAll(fd, data, size, isClosed);
+      }
+#endif
+      return writeAll(fd, data, size, isClosed);
+    },
+    slotReuseDelay);
+
+  if (!success && !isClosed)
+  {
+    std::cerr << "Failed writing binary stream: " << std::strerror(errno)
+              << "\n";
+    return 1;
+  }
+  return 0;    // finished, or the reader stopped consuming
+}
 
 //------------------------------------------------------------------------------
 int
-main()
+main(int argc, char* argv[])
 {
-  std::vector<float> results(NUM_FLOATS);
+  CliArgs args(argc, argv);
+  if (args.has("help"))
+  {
+    printUsage();
+    return 0;
+  }
+
+  ExportOptions options;
+  options.isBinary   = args.has("binary");
+  options.numRows    = args.getUInt("count", options.isBinary ? 0 : 100'000);
+  options.numColumns = args.getUInt("columns", options.numColumns);
+  options.precision  = args.getUInt("precision", options.precision);
+  options.isSeeded   = args.has("seed");
+  options.seed       = args.getUInt("seed", options.seed);
+  options.delimiter  = args.getString("delimiter", options.delimiter);
+  options.fileName   = args.getString("output", options.fileName);
+  options.generator  = args.getString("generator", options.generator);
+  options.numThreads
+    = static_cast<unsigned>(args.getUInt("threads", options.numThreads));
+
+  if (options.numColumns == 0)
+  {
+    args.addError("--columns must be at least 1");
+  }
+  if (options.precision > 20)
+  {
+    args.addError("--precision must be 20 or less");
+  }
+  ChunkSource source;
+  if (!findChunkSource(options.generator, options, source))
+  {
+    args.addError("Unknown generator: " + options.generator);
+  }
+  else if (options.isBinary && options.generator != "randocha")
+  {
+    args.addError("--binary only supports the randocha generator");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
 
-  Randocha rand;
-  for (size_t i = 0; i < NUM_SAMPLES; ++i)
+  if (options.isBinary)
   {
-    rand.generate(results.data() + (i * Randocha::NUM_GENERATED));
+    if (options.fileName == "-")
+    {
+      return streamBinary(options, fileno(stdout));
+    }
+
+    FILE* file = std::fopen(options.fileName.c_str(), "wb");
+    if (!file)
+    {
+      std::cerr << "Unable to open " << options.fileName << " for writing\n";
+      return 1;
+    }
+    const int result = streamBinary(options, fileno(file));
+    std::fclose(file);
+    return result;
   }
 
-  std::ofstream file("random_numbers.csv");
-  file << std::fixed << std::setprecision(9);
-  for (float f : results)
+  FILE* file = (options.fileName == "-")
+                 ? stdout
+                 : std::fopen(options.fileName.c_str(), "wb");
+  if (!file)
+  {
+    std::cerr << "Unable to open " << options.fileName << " for writing\n";
+    return 1;
+  }
+
+  // Two chunks in flight per thread keeps the writer busy without unbounded
+  // memory growth
+  const uint64_t numChunks
+    = (options.numRows + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+  const size_t numSlots = size_t(options.numThreads) * 2;
+  std::vector<ChunkStorage> slots(numSlots);
+  for (auto& slot : slots)
+  {
+    slot.text.reserve(
+      ROWS_PER_CHUNK * options.numColumns
+      * (options.precision + options.delimiter.size() + 3));
+  }
+
+  const bool success = orderedPipeline(
+    numChunks,
+    source.isParallel ? options.numThreads : 1,
+    numSlots,
+    [&](size_t chunk, size_t slot) {
+      formatChunk(options, source, chunk, slots[slot]);
+    },
+    [&](size_t, size_t slot) {
+      const auto& text = slots[slot].text;
+      return std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    });
+
+  const bool closed = (file == stdout) ? (std::fflush(file) == 0)
+                                       : (std::fclose(file) == 0);
+  if (!success || !closed)
   {
-    file << f << "\n";
+    std::cerr << "Failed writing to " << options.fileName << "\n";
+    return 1;
   }
 
   return 0;
@@ -1,7 +1,10 @@
 #include "randocha.h"
-#include "rand_sse.h"
-#include "rand_tea.h"
-#include "rand_mt.h"
+#include "generators.h"
+#include "cli_args.h"
+#include "stat_tests.h"
+#include "histogram.h"
+#include "online_stats.h"
+#include "fft.h"
 
 #if _MSC_VER
 #define STBI_MSC_SECURE_CRT
@@ -16,6 +19,7 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -23,20 +27,26 @@
 #include <numeric>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 //------------------------------------------------------------------------------
 constexpr size_t NUM_FLOATS = 4'000'000;
 using Results               = std::vector<float>;
 
 constexpr size_t VIZ_RESOLUTION = 50;
 
+// Streaming modes generate this many floats at a time (64KB)
+constexpr size_t STREAM_CHUNK_SIZE = 1 << 14;
+
 constexpr int IMAGE_WIDTH  = 640;
 constexpr int IMAGE_HEIGHT = 480;
 constexpr int NUM_PIXELS   = IMAGE_WIDTH * IMAGE_HEIGHT;
 static_assert(
   NUM_PIXELS <= NUM_FLOATS,
   "Must have enough random variables to fill an image");
-using ImageBuffer = std::vector<uint32_t>;
+using ImageBuffer = std::vector<uint8_t>;
 
+//------------------------------------------------------------------------------
+// Greyscale, one byte per pixel (large textures: see randocha-texture)
 //------------------------------------------------------------------------------
 bool
 saveImage(const Results& results, const std::string& fileName)
@@ -45,139 +55,834 @@ saveImage(const Results& results, const std::string& fileName)
 
   for (int i = 0; i < NUM_PIXELS; ++i)
   {
-    const uint8_t channelVal = uint8_t(255.99f * results[i]);
-
-    image[i] = uint32_t(
-      (channelVal << 24) | (channelVal << 16) | (channelVal << 8)
-      | (channelVal));
-
+    image[i] = uint8_t(255.99f * results[i]);
   }    // for NUM_PIXELS
 
   return (
-    stbi_write_bmp(fileName.c_str(), IMAGE_WIDTH, IMAGE_HEIGHT, 3, image.data())
+    stbi_write_bmp(fileName.c_str(), IMAGE_WIDTH, IMAGE_HEIGHT, 1, image.data())
     != 0);
 }
 
 //------------------------------------------------------------------------------
+template <typename Rand>
 void
-generateRandocha(Results& results)
+generate(Results& results)
 {
-  constexpr size_t numSamples = NUM_FLOATS / Randocha::NUM_GENERATED;
   static_assert(
-    (NUM_FLOATS % Randocha::NUM_GENERATED) == 0,
+    (NUM_FLOATS % GeneratorTraits<Rand>::BLOCK_SIZE) == 0,
     "Please ensure to use an exact multiple of the number generated per call");
 
-  Randocha rand;
-  for (size_t i = 0; i < numSamples; ++i)
+  BulkGenerator<Rand> rand;
+  rand.fill(results.data(), NUM_FLOATS);
+}
+
+//------------------------------------------------------------------------------
+void
+printDistribution(const Histogram& histogram)
+{
+  const size_t numBuckets = histogram.counts.size();
+  std::cout << std::fixed << std::setw(11) << std::setprecision(8);
+  std::cout << "Mean: " << (histogram.sum / double(histogram.numValues))
+            << " Min: " << histogram.min << " Max: " << histogram.max << "\n";
+  if (histogram.numOutOfRange != 0)
   {
-    rand.generate(results.data() + (i * Randocha::NUM_GENERATED));
+    std::cout << "WARNING: " << histogram.numOutOfRange
+              << " values outside of [0 -> 1)\n";
   }
+
+  // Bucket counts far from the expected uniform count
+  const double expected = double(histogram.numValues) / double(numBuckets);
+  const auto minMax     = std::minmax_element(
+    histogram.counts.begin(), histogram.counts.end());
+  std::cout << numBuckets << " buckets, expected count: " << expected
+            << " min: " << *minMax.first << " max: " << *minMax.second << "\n";
+
+  // Display at most VIZ_RESOLUTION rows, each summing a range of buckets
+  const size_t numRows = std::min(numBuckets, VIZ_RESOLUTION);
+  for (size_t row = 0; row < numRows; ++row)
+  {
+    const size_t begin = (row * numBuckets) / numRows;
+    const size_t end   = ((row + 1) * numBuckets) / numRows;
+    uint64_t count     = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+      count += histogram.counts[i];
+    }
+
+    constexpr double MAX_WIDTH     = 80.0;
+    constexpr double TARGET_OF_MAX = 2.0;    // 1/2 of max_width (if uniform)
+    const double rowExpected = expected * double(end - begin);
+    const int scaledCount
+      = int((double(count) * MAX_WIDTH) / (rowExpected * TARGET_OF_MAX));
+
+    std::cout << row << "\t:" << std::string(size_t(scaledCount), '*')
+              << "\n";
+  }    // for numRows
+  std::cout << "\n";
 }
 
 //------------------------------------------------------------------------------
 void
-generateSse(Results& results)
+vizDistribution(const Results& results, size_t numBuckets, unsigned numThreads)
 {
-  constexpr size_t numSamples = NUM_FLOATS / RandSSE::NUM_GENERATED;
-  static_assert(
-    (NUM_FLOATS % RandSSE::NUM_GENERATED) == 0,
-    "Please ensure to use an exact multiple of the number generated per call");
+  printDistribution(
+    parallelHistogram(results.data(), results.size(), numBuckets, numThreads));
+}
+
+//------------------------------------------------------------------------------
+// Streaming source for the registry entry's generator, one independent stream
+// per seed. The modes below run every generator in the registry (generators.h).
+//------------------------------------------------------------------------------
+template <typename Entry>
+using SourceOf = BulkGenerator<typename Entry::Type>;
 
-  RandSSE rand;
-  for (size_t i = 0; i < numSamples; ++i)
+//------------------------------------------------------------------------------
+static void
+printTestResults(const std::vector<TestResult>& results)
+{
+  // Like TestU01, p-values too close to 1 (too uniform) are flagged as well
+  std::cout << std::scientific << std::setprecision(4);
+  for (auto& result : results)
   {
-    rand.rand_sse(results.data() + (i * RandSSE::NUM_GENERATED));
+    const double p      = std::min(result.pValue, 1.0 - result.pValue);
+    const char* verdict = (p < 1e-6) ? "FAIL" : (p < 1e-3) ? "suspicious"
+                                                           : "pass";
+    std::cout << std::left << std::setw(28) << result.name << std::right
+              << " statistic: " << std::setw(12) << result.statistic
+              << "  p-value: " << std::setw(12) << result.pValue << "  "
+              << verdict << "\n";
   }
+  std::cout << std::defaultfloat << "\n";
 }
 
 //------------------------------------------------------------------------------
-void
-generateTea(Results& results)
+template <typename Source>
+static void
+runGeneratorBattery(
+  const char* name, uint64_t numSamples, unsigned numThreads, uint64_t seed)
 {
-  constexpr size_t numSamples = NUM_FLOATS / RandTea::NUM_GENERATED;
-  static_assert(
-    (NUM_FLOATS % RandTea::NUM_GENERATED) == 0,
-    "Please ensure to use an exact multiple of the number generated per call");
+  std::cout << "\n\n" << name << "\n";
+  std::cout << std::string(strlen(name), '=') << "\n";
+
+  auto results = runBattery(
+    [seed](size_t stream) { return Source(seed + stream); },
+    numSamples,
+    numThreads);
+  printTestResults(results);
+}
+
+//------------------------------------------------------------------------------
+// Avalanche of the single aesenc round Randocha applies to its round key
+//------------------------------------------------------------------------------
+static void
+runAesAvalanche(uint64_t numTrials, unsigned numThreads, uint64_t seed)
+{
+  std::cout << "\n\nRandocha aesenc round avalanche\n";
+  std::cout << "===============================\n";
+
+  auto makeInput = [seed](uint64_t trial, uint32_t words[4]) {
+    __m128i key;
+    randocha__seed(key, seed + trial);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(words), key);
+  };
+  auto hash = [](const uint32_t in[4], uint32_t out[4]) {
+    const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(out), _mm_aesenc_si128(key, key));
+  };
+
+  AvalancheResult result
+    = avalancheTest(makeInput, hash, numTrials, numThreads);
+  std::cout << std::fixed << std::setprecision(4)
+            << "Mean output bits flipped per input bit: "
+            << result.meanFlippedBits << " (ideal 64)\n"
+            << "Per bit flip probability range: " << result.minBitProbability
+            << " -> " << result.maxBitProbability << " (ideal 0.5)\n";
+  printTestResults({result.test});
+}
+
+//------------------------------------------------------------------------------
+static void
+printUsage()
+{
+  std::cout
+    << "Usage: distribution_viz [options]\n"
+       "  (no options)        histogram, statistics and noise images\n"
+       "  --buckets <n>       histogram buckets (default 50)\n"
+       "  --stream            constant memory streaming analysis of all\n"
+       "                      generators concurrently\n"
+       "  --battery           run the statistical test battery instead\n"
+       "  --spectrum          2D power spectrum of noise images\n"
+       "  --density           pair/triple serial correlation density images\n"
+       "  --grid2d <n>        pair grid resolution (default 1024)\n"
+       "  --grid3d <n>        triple grid resolution (default 128)\n"
+       "  --width <n>         spectrum image width (default 640)\n"
+       "  --height <n>        spectrum image height (default 480)\n"
+       "  --samples <n>       values per generator\n"
+       "                      (default 1000000000 stream/density,\n"
+       "                      100000000 battery)\n"
+       "  --trials <n>        avalanche trials (default 65536)\n"
+       "  --seed <n>          base seed, streams use seed + thread\n"
+       "  --threads <n>       worker threads (default: all cores)\n";
+}
+
+//------------------------------------------------------------------------------
+// Power spectrum of a noise image
+//
+// The periodogram is normalised by the image variance, so ideal white noise
+// has a flat radially averaged power of 1. Anisotropy is the variance of the
+// power around each annulus relative to its squared mean (Ulichney); for white
+// noise the periodogram is exponentially distributed, giving 0 dB.
+//------------------------------------------------------------------------------
+struct SpectrumResult
+{
+  std::vector<double> radialPower;
+  std::vector<double> anisotropyDb;
+  std::vector<uint64_t> numSamples;
+  double flatness = 0.0;    // geometric / arithmetic mean of the radial power
+};
+
+static SpectrumResult
+analyseSpectrum(
+  const float* values,
+  size_t width,
+  size_t height,
+  unsigned numThreads,
+  const std::string& fileStem)
+{
+  const size_t numPixels = width * height;
+  OnlineMoments moments;
+  moments.add(values, numPixels);
+
+  std::vector<Complex> image(numPixels);
+  parallelFor(height, numThreads, [&](size_t y, unsigned) {
+    for (size_t x = 0; x < width; ++x)
+    {
+      const size_t i = (y * width) + x;
+      image[i]       = Complex(float(values[i] - moments.mean), 0.0f);
+    }
+  });
+  fft2D(image, width, height, numThreads);
+
+  // Radial bins up to the Nyquist frequency of the shorter side
+  const size_t numBins = std::min(width, height) / 2;
+  const double scale   = 1.0 / (double(numPixels) * moments.variance());
+  struct Bins
+  {
+    std::vector<double> sum;
+    std::vector<double> sumSq;
+    std::vector<uint64_t> count;
+  };
+  std::vector<Bins> threadBins(std::max(1u, numThreads));
+  for (auto& bins : threadBins)
+  {
+    bins.sum.resize(numBins);
+    bins.sumSq.resize(numBins);
+    bins.count.resize(numBins);
+  }
+
+  // Log power image with the DC term moved to the centre
+  std::vector<uint8_t> spectrumImage(numPixels);
+  parallelFor(height, numThreads, [&](size_t v, unsigned thread) {
+    Bins& bins        = threadBins[thread];
+    const double fv
+      = (double(v) - ((v <= height / 2) ? 0.0 : double(height))) / height;
+    const size_t outY = (v + (height / 2)) % height;
+    for (size_t u = 0; u < width; ++u)
+    {
+      const double power = std::norm(image[(v * width) + u]) * scale;
+      const double fu
+        = (double(u) - ((u <= width / 2) ? 0.0 : double(width))) / width;
+      const size_t bin
+        = size_t(std::sqrt((fu * fu) + (fv * fv)) * 2.0 * double(numBins));
+      if ((u != 0 || v != 0) && bin < numBins)
+      {
+        bins.sum[bin] += power;
+        bins.sumSq[bin] += power * power;
+        bins.count[bin]++;
+      }
+
+      // Map -20dB -> +10dB onto the 8-bit range
+      const double db   = 10.0 * std::log10(std::max(power, 1e-10));
+      const double grey = std::min(std::max((db + 20.0) / 30.0, 0.0), 1.0);
+      const size_t outX = (u + (width / 2)) % width;
+      spectrumImage[(outY * width) + outX] = uint8_t(grey * 255.0);
+    }
+  });
+
+  SpectrumResult result;
+  result.radialPower.resize(numBins);
+  result.anisotropyDb.resize(numBins);
+  result.numSamples.resize(numBins);
+  double logSum    = 0.0;
+  double linearSum = 0.0;
+  size_t numUsed   = 0;
+  for (size_t bin = 0; bin < numBins; ++bin)
+  {
+    double sum = 0.0, sumSq = 0.0;
+    uint64_t count = 0;
+    for (auto& bins : threadBins)
+    {
+      sum += bins.sum[bin];
+      sumSq += bins.sumSq[bin];
+      count += bins.count[bin];
+    }
+    if (count == 0)
+    {
+      continue;
+    }
 
-  RandTea rand;
-  for (size_t i = 0; i < numSamples; ++i)
+    const double mean        = sum / double(count);
+    const double variance    = (sumSq / double(count)) - (mean * mean);
+    result.radialPower[bin]  = mean;
+    result.anisotropyDb[bin] = 10.0 * std::log10(variance / (mean * mean));
+    result.numSamples[bin]   = count;
+    logSum += std::log(mean);
+    linearSum += mean;
+    ++numUsed;
+  }
+  result.flatness = (numUsed == 0)
+                      ? 0.0
+                      : std::exp(logSum / double(numUsed))
+                          / (linearSum / double(numUsed));
+
+  stbi_write_png_compression_level = 1;    // favour speed for large images
+  const std::string imageName      = fileStem + "_spectrum.png";
+  if (!stbi_write_png(
+        imageName.c_str(),
+        int(width),
+        int(height),
+        1,
+        spectrumImage.data(),
+        int(width)))
+  {
+    std::cerr << "Failed to write " << imageName << "\n";
+  }
+
+  const std::string csvName = fileStem + "_spectrum.csv";
+  std::ofstream csv(csvName);
+  csv << "frequency,power,anisotropy_db,samples\n";
+  for (size_t bin = 0; bin < numBins; ++bin)
+  {
+    csv << ((double(bin) + 0.5) / (2.0 * numBins)) << ","
+        << result.radialPower[bin] << "," << result.anisotropyDb[bin] << ","
+        << result.numSamples[bin] << "\n";
+  }
+  if (!csv)
   {
-    rand.generate();
-    results[(i * RandTea::NUM_GENERATED) + 0] = rand.getF(0);
-    results[(i * RandTea::NUM_GENERATED) + 1] = rand.getF(1);
+    std::cerr << "Failed to write " << csvName << "\n";
   }
+
+  return result;
 }
 
 //------------------------------------------------------------------------------
-void
-generateMT(Results& results)
+template <typename Source>
+static void
+runGeneratorSpectrum(
+  const char* name,
+  const std::string& fileStem,
+  size_t width,
+  size_t height,
+  unsigned numThreads,
+  uint64_t seed)
 {
-  constexpr size_t numSamples = NUM_FLOATS / RandMT::NUM_GENERATED;
-  static_assert(
-    (NUM_FLOATS % RandMT::NUM_GENERATED) == 0,
-    "Please ensure to use an exact multiple of the number generated per call");
+  std::cout << "\n\n" << name << "\n";
+  std::cout << std::string(strlen(name), '=') << "\n";
+
+  const size_t numPixels = width * height;
+  std::vector<float> values(Source::wholeBlocks(numPixels));
+  Source source(seed);
+  source.fill(values.data(), values.size());
+
+  const SpectrumResult result
+    = analyseSpectrum(values.data(), width, height, numThreads, fileStem);
+
+  // Deviation of the radial average from flat, ignoring the noisiest bins
+  double maxDeviation   = 0.0;
+  double meanAnisotropy = 0.0;
+  size_t numBins        = 0;
+  for (size_t bin = 0; bin < result.radialPower.size(); ++bin)
+  {
+    if (result.numSamples[bin] < 64)
+    {
+      continue;
+    }
+    maxDeviation
+      = std::max(maxDeviation, std::fabs(result.radialPower[bin] - 1.0));
+    meanAnisotropy += result.anisotropyDb[bin];
+    ++numBins;
+  }
+
+  std::cout << std::fixed << std::setprecision(4)
+            << "Spectral flatness: " << result.flatness << " (ideal 1)\n"
+            << "Max radial power deviation: " << maxDeviation
+            << " (ideal 0)\n"
+            << "Mean anisotropy: "
+            << (numBins ? meanAnisotropy / double(numBins) : 0.0)
+            << " dB (ideal 0)\n"
+            << "Written " << fileStem << "_spectrum.png/.csv\n";
+}
 
-  RandMT rand;
-  for (size_t i = 0; i < numSamples; ++i)
+//------------------------------------------------------------------------------
+static int
+runSpectrumMode(const CliArgs& args)
+{
+  const size_t width  = args.getUInt("width", IMAGE_WIDTH);
+  const size_t height = args.getUInt("height", IMAGE_HEIGHT);
+  const uint64_t seed = args.getUInt("seed", 0);
+  const unsigned numThreads
+    = unsigned(args.getUInt("threads", defaultThreadCount()));
+  if (width < 2 || height < 2 || width > (1 << 16) || height > (1 << 16))
+  {
+    args.addError("--width and --height must be between 2 and 65536");
+  }
+  if (!args.validate(std::cerr))
   {
-    results[i] = rand.generate();
+    printUsage();
+    return 1;
   }
+
+  std::cout << "Power spectrum of " << width << "x" << height
+            << " noise images\n";
+  forEachGenerator([&](auto entry) {
+    runGeneratorSpectrum<SourceOf<decltype(entry)>>(
+      entry.title, entry.fileStem, width, height, numThreads, seed);
+  });
+  return 0;
 }
 
 //------------------------------------------------------------------------------
-void
-vizDistribution(Results& results)
+// Serial correlation density grids
+//
+// Consecutive overlapping pairs (x[i], x[i+1]) and triples
+// (x[i], x[i+1], x[i+2]) are counted into 2D and 3D grids. Each thread streams
+// its own generator into its own grids, which are summed at the end, so no
+// atomics are needed and memory is independent of the number of tuples.
+// Lattice structure (e.g. from LCGs) shows up as lines/planes in the images.
+//------------------------------------------------------------------------------
+struct DensityGrids
 {
-  std::vector<int> distributionCounts(VIZ_RESOLUTION);
+  DensityGrids(size_t size2D, size_t size3D)
+      : gridSize2D(size2D)
+      , gridSize3D(size3D)
+      , pairs(size2D * size2D)
+      , triples(size3D * size3D * size3D)
+  {
+  }
+
+  size_t gridSize2D;
+  size_t gridSize3D;
+  std::vector<uint64_t> pairs;
+  std::vector<uint64_t> triples;
+  uint64_t numPairs   = 0;
+  uint64_t numTriples = 0;
+};
+
+//------------------------------------------------------------------------------
+template <typename Source>
+static void
+accumulateDensity(DensityGrids& grids, uint64_t seed, uint64_t numSamples)
+{
+  const size_t size2D = grids.gridSize2D;
+  const size_t size3D = grids.gridSize3D;
+  const float scale2D = float(size2D);
+  const float scale3D = float(size3D);
+
+  // 32-bit cells keep the per-thread grids cache friendlier, flushed into the
+  // 64-bit totals before they can overflow
+  static const uint64_t FLUSH_INTERVAL = uint64_t(1) << 31;
+  std::vector<uint32_t> pairs(grids.pairs.size());
+  std::vector<uint32_t> triples(grids.triples.size());
+  auto flush = [&]() {
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+      grids.pairs[i] += pairs[i];
+      pairs[i] = 0;
+    }
+    for (size_t i = 0; i < triples.size(); ++i)
+    {
+      grids.triples[i] += triples[i];
+      triples[i] = 0;
+    }
+  };
 
-  double total = 0.0;
-  float min    = 2.0f;
-  float max    = -2.0f;
-  for (int i = 0; i < NUM_FLOATS; ++i)
+  Source source(seed);
+  std::vector<float> chunk(STREAM_CHUNK_SIZE);
+  size_t prev2D = 0, prev3D = 0, prevPrev3D = 0;
+  uint64_t numSinceFlush = 0;
+  for (uint64_t pos = 0; pos < numSamples; pos += STREAM_CHUNK_SIZE)
   {
-    assert(results[i] >= 0.0f);
-    assert(results[i] < 1.0f);
-    total += results[i];
+    const size_t count
+      = size_t(std::min<uint64_t>(STREAM_CHUNK_SIZE, numSamples - pos));
+    source.fill(chunk.data(), source.wholeBlocks(count));
 
-    if (results[i] < min)
+    for (size_t i = 0; i < count; ++i)
     {
-      min = results[i];
+      const float x = std::min(std::max(chunk[i], 0.0f), 1.0f);
+      const size_t idx2D = std::min(size_t(x * scale2D), size2D - 1);
+      const size_t idx3D = std::min(size_t(x * scale3D), size3D - 1);
+
+      const uint64_t n = pos + i;
+      if (n >= 1)
+      {
+        pairs[(prev2D * size2D) + idx2D]++;
+      }
+      if (n >= 2)
+      {
+        triples[(((prevPrev3D * size3D) + prev3D) * size3D) + idx3D]++;
+      }
+      prev2D     = idx2D;
+      prevPrev3D = prev3D;
+      prev3D     = idx3D;
     }
-    if (results[i] > max)
+
+    numSinceFlush += count;
+    if (numSinceFlush >= FLUSH_INTERVAL - STREAM_CHUNK_SIZE)
     {
-      max = results[i];
+      flush();
+      numSinceFlush = 0;
     }
+  }
+  flush();
 
-    // Quantize the values to easier count and display
-    size_t idx = static_cast<size_t>((double)results[i] * VIZ_RESOLUTION);
-    distributionCounts[idx]++;
-  }    // for NUM_FLOATS
+  grids.numPairs += (numSamples > 1) ? numSamples - 1 : 0;
+  grids.numTriples += (numSamples > 2) ? numSamples - 2 : 0;
+}
 
-  std::cout << std::fixed << std::setw(11) << std::setprecision(8);
-  std::cout << "Mean: " << (total / NUM_FLOATS) << " Min: " << min
-            << " Max: " << max << "\n";
+//------------------------------------------------------------------------------
+// Chi-square of a grid against the uniform expectation
+//------------------------------------------------------------------------------
+static TestResult
+gridUniformity(
+  const char* name, const std::vector<uint64_t>& cells, uint64_t numTuples)
+{
+  const double expected = double(numTuples) / double(cells.size());
+  double chiSquare      = 0.0;
+  for (uint64_t count : cells)
+  {
+    const double diff = double(count) - expected;
+    chiSquare += diff * diff;
+  }
+  chiSquare /= expected;
 
-  for (size_t i = 0; i < VIZ_RESOLUTION; ++i)
+  TestResult result;
+  result.name      = name;
+  result.statistic = chiSquare;
+  result.pValue    = chiSquarePValue(chiSquare, double(cells.size() - 1));
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Maps density relative to uniform onto grey: 0 -> black, 1 -> mid grey,
+// 2 or more -> white
+//------------------------------------------------------------------------------
+static uint8_t
+densityToGrey(uint64_t count, double expected)
+{
+  const double relative = double(count) / expected;
+  return uint8_t(std::min(relative * 0.5, 1.0) * 255.0);
+}
+
+//------------------------------------------------------------------------------
+static void
+writeDensityImages(const DensityGrids& grids, const std::string& fileStem)
+{
+  // Pairs: one image, x[i] horizontally and x[i+1] vertically (up)
   {
-    constexpr int MAX_WIDTH     = 80;
-    constexpr int TARGET_OF_MAX = 2;    // 1/2 of max_width (if uniform)
-    constexpr int SCALE
-      = ((NUM_FLOATS / VIZ_RESOLUTION) * TARGET_OF_MAX) / MAX_WIDTH;
+    const size_t size     = grids.gridSize2D;
+    const double expected = double(grids.numPairs) / double(size * size);
+    std::vector<uint8_t> image(size * size);
+    for (size_t y = 0; y < size; ++y)
+    {
+      for (size_t x = 0; x < size; ++x)
+      {
+        image[(((size - 1) - y) * size) + x]
+          = densityToGrey(grids.pairs[(x * size) + y], expected);
+      }
+    }
 
-    int scaledCount = distributionCounts[i] / SCALE;
-    std::cout << i << "\t:";
-    for (int j = 0; j < scaledCount; ++j)
+    const std::string name = fileStem + "_pairs.png";
+    if (!stbi_write_png(
+          name.c_str(), int(size), int(size), 1, image.data(), int(size)))
     {
-      std::cout << "*";
+      std::cerr << "Failed to write " << name << "\n";
     }
-    std::cout << "\n";
-  }    // for VIZ_RESOLUTION
-  std::cout << "\n";
+  }
+
+  // Triples: a mosaic of (x[i+1], x[i+2]) slices, one per bucket of x[i]
+  {
+    const size_t size     = grids.gridSize3D;
+    const double expected
+      = double(grids.numTriples) / double(size * size * size);
+    size_t tilesX = 1;
+    while (tilesX * tilesX < size)
+    {
+      ++tilesX;
+    }
+    const size_t tilesY = (size + tilesX - 1) / tilesX;
+    const size_t width  = tilesX * (size + 1);    // 1 pixel border per tile
+    const size_t height = tilesY * (size + 1);
+
+    std::vector<uint8_t> image(width * height);
+    for (size_t z = 0; z < size; ++z)
+    {
+      const size_t originX = (z % tilesX) * (size + 1);
+      const size_t originY = (z / tilesX) * (size + 1);
+      for (size_t y = 0; y < size; ++y)
+      {
+        for (size_t x = 0; x < size; ++x)
+        {
+          const uint64_t count = grids.triples[(((z * size) + x) * size) + y];
+          image[((originY + (size - 1) - y) * width) + originX + x]
+            = densityToGrey(count, expected);
+        }
+      }
+    }
+
+    const std::string name = fileStem + "_triples.png";
+    if (!stbi_write_png(
+          name.c_str(), int(width), int(height), 1, image.data(), int(width)))
+    {
+      std::cerr << "Failed to write " << name << "\n";
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+template <typename Source>
+static void
+runGeneratorDensity(
+  const char* name,
+  const std::string& fileStem,
+  uint64_t numSamples,
+  size_t size2D,
+  size_t size3D,
+  unsigned numThreads,
+  uint64_t seed)
+{
+  std::cout << "\n\n" << name << "\n";
+  std::cout << std::string(strlen(name), '=') << "\n";
+
+  numThreads = std::max(1u, numThreads);
+  std::vector<DensityGrids> threadGrids(
+    numThreads, DensityGrids(size2D, size3D));
+  parallelFor(numThreads, numThreads, [&](size_t stream, unsigned) {
+    const uint64_t begin = (numSamples * stream) / numThreads;
+    const uint64_t end   = (numSamples * (stream + 1)) / numThreads;
+    accumulateDensity<Source>(threadGrids[stream], seed + stream, end - begin);
+  });
+
+  DensityGrids& total = threadGrids[0];
+  for (size_t i = 1; i < threadGrids.size(); ++i)
+  {
+    const DensityGrids& other = threadGrids[i];
+    for (size_t cell = 0; cell < total.pairs.size(); ++cell)
+    {
+      total.pairs[cell] += other.pairs[cell];
+    }
+    for (size_t cell = 0; cell < total.triples.size(); ++cell)
+    {
+      total.triples[cell] += other.triples[cell];
+    }
+    total.numPairs += other.numPairs;
+    total.numTriples += other.numTriples;
+  }
+
+  printTestResults({
+    gridUniformity("Pairs grid uniformity", total.pairs, total.numPairs),
+    gridUniformity("Triples grid uniformity", total.triples, total.numTriples),
+  });
+  writeDensityImages(total, fileStem);
+  std::cout << "Written " << fileStem << "_pairs.png and " << fileStem
+            << "_triples.png\n";
+}
+
+//------------------------------------------------------------------------------
+static int
+runDensityMode(const CliArgs& args)
+{
+  const uint64_t numSamples = args.getUInt("samples", 1'000'000'000);
+  const size_t size2D       = args.getUInt("grid2d", 1024);
+  const size_t size3D       = args.getUInt("grid3d", 128);
+  const uint64_t seed       = args.getUInt("seed", 0);
+  const unsigned numThreads
+    = unsigned(args.getUInt("threads", defaultThreadCount()));
+  if (size2D < 2 || size2D > 8192 || size3D < 2 || size3D > 512)
+  {
+    args.addError("--grid2d must be 2 -> 8192 and --grid3d 2 -> 512");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::cout << "Density of " << numSamples << " consecutive values on "
+            << size2D << "^2 and " << size3D << "^3 grids\n";
+  forEachGenerator([&](auto entry) {
+    runGeneratorDensity<SourceOf<decltype(entry)>>(
+      entry.title,
+      entry.fileStem,
+      numSamples,
+      size2D,
+      size3D,
+      numThreads,
+      seed);
+  });
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Constant memory analysis of one stream, a cache sized chunk at a time
+//------------------------------------------------------------------------------
+struct StreamStats
+{
+  OnlineMoments moments;
+  Histogram histogram;
+};
+
+template <typename Source>
+static StreamStats
+analyseStream(uint64_t seed, uint64_t numSamples, size_t numBuckets)
+{
+  Source source(seed);
+  HistogramKernel kernel(numBuckets);
+  StreamStats stats;
+
+  std::vector<float> chunk(STREAM_CHUNK_SIZE);
+  for (uint64_t pos = 0; pos < numSamples; pos += STREAM_CHUNK_SIZE)
+  {
+    const size_t count
+      = size_t(std::min<uint64_t>(STREAM_CHUNK_SIZE, numSamples - pos));
+    source.fill(chunk.data(), source.wholeBlocks(count));
+    stats.moments.add(chunk.data(), count);
+    kernel.add(chunk.data(), count);
+  }
+
+  stats.histogram = kernel.result();
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+static void
+printMoments(const OnlineMoments& moments)
+{
+  // Uniform [0 -> 1): mean 1/2, variance 1/12, skewness 0, excess kurtosis -6/5
+  // z-scores use the standard errors of the sample mean and variance
+  const double n        = double(moments.count);
+  const double meanZ    = (moments.mean - 0.5) / std::sqrt((1.0 / 12.0) / n);
+  const double varianceZ
+    = (moments.variance() - (1.0 / 12.0))
+      / std::sqrt(((1.0 / 80.0) - (1.0 / 144.0)) / n);
+
+  std::cout << std::fixed << std::setprecision(8)
+            << "Samples:         " << moments.count << "\n"
+            << "Mean:            " << moments.mean << " (z: " << meanZ
+            << ")\n"
+            << "Variance:        " << moments.variance() << " (z: "
+            << varianceZ << ", ideal 0.08333333)\n"
+            << "Skewness:        " << moments.skewness() << " (ideal 0)\n"
+            << "Excess kurtosis: " << moments.excessKurtosis()
+            << " (ideal -1.2)\n";
+}
+
+//------------------------------------------------------------------------------
+// Analyses every generator concurrently. Each generator gets at least one
+// thread; spare threads split a generator into further independent streams.
+//------------------------------------------------------------------------------
+static int
+runStreamMode(const CliArgs& args)
+{
+  const uint64_t numSamples = args.getUInt("samples", 1'000'000'000);
+  const size_t numBuckets   = args.getUInt("buckets", VIZ_RESOLUTION);
+  const uint64_t seed       = args.getUInt("seed", 0);
+  const unsigned numThreads
+    = unsigned(args.getUInt("threads", defaultThreadCount()));
+  if (numBuckets == 0 || numBuckets > (1 << 24))
+  {
+    args.addError("--buckets must be between 1 and 16777216");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
+  using AnalyseFunc = StreamStats (*)(uint64_t, uint64_t, size_t);
+  struct Generator
+  {
+    const char* name;
+    AnalyseFunc analyse;
+  };
+  std::vector<Generator> generators;
+  forEachGenerator([&generators](auto entry) {
+    generators.push_back(
+      {entry.title, &analyseStream<SourceOf<decltype(entry)>>});
+  });
+  const size_t numGenerators = generators.size();
+  const size_t numStreams
+    = std::max<size_t>(1, numThreads / numGenerators);
+
+  std::vector<StreamStats> streams(numGenerators * numStreams);
+  parallelFor(
+    streams.size(),
+    std::max<unsigned>(numThreads, unsigned(numGenerators)),
+    [&](size_t task, unsigned) {
+      const size_t generator = task % numGenerators;
+      const size_t stream    = task / numGenerators;
+      const uint64_t begin   = (numSamples * stream) / numStreams;
+      const uint64_t end     = (numSamples * (stream + 1)) / numStreams;
+      streams[task]          = generators[generator].analyse(
+        seed + stream, end - begin, numBuckets);
+    });
+
+  for (size_t generator = 0; generator < numGenerators; ++generator)
+  {
+    StreamStats total = std::move(streams[generator]);
+    for (size_t stream = 1; stream < numStreams; ++stream)
+    {
+      const StreamStats& other = streams[(stream * numGenerators) + generator];
+      total.moments.merge(other.moments);
+      total.histogram.merge(other.histogram);
+    }
+
+    const std::string name = generators[generator].name;
+    std::cout << "\n\n" << name << "\n" << std::string(name.size(), '=') << "\n";
+    printMoments(total.moments);
+    printDistribution(total.histogram);
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+static int
+runBatteryMode(const CliArgs& args)
+{
+  const uint64_t numSamples = args.getUInt("samples", 100'000'000);
+  const uint64_t numTrials  = args.getUInt("trials", 1 << 16);
+  const uint64_t seed       = args.getUInt("seed", 0);
+  const unsigned numThreads
+    = unsigned(args.getUInt("threads", defaultThreadCount()));
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
+  std::cout << "Testing " << numSamples << " values per generator on "
+            << numThreads << " threads\n";
+  forEachGenerator([&](auto entry) {
+    runGeneratorBattery<SourceOf<decltype(entry)>>(
+      entry.title, numSamples, numThreads, seed);
+  });
+  runAesAvalanche(numTrials, numThreads, seed);
+  return 0;
 }
 
 //------------------------------------------------------------------------------
 int
-main()
+main(int argc, char* argv[])
 {
   if (!randocha__isAesSupported())
   {
@@ -186,34 +891,50 @@ main()
     return 1;
   }
 
+  CliArgs args(argc, argv);
+  if (args.has("help"))
+  {
+    printUsage();
+    return 0;
+  }
+  if (args.has("battery"))
+  {
+    return runBatteryMode(args);
+  }
+  if (args.has("stream"))
+  {
+    return runStreamMode(args);
+  }
+  if (args.has("spectrum"))
+  {
+    return runSpectrumMode(args);
+  }
+  if (args.has("density"))
+  {
+    return runDensityMode(args);
+  }
+  const size_t numBuckets = args.getUInt("buckets", VIZ_RESOLUTION);
+  const unsigned numThreads
+    = unsigned(args.getUInt("threads", defaultThreadCount()));
+  if (numBuckets == 0 || numBuckets > (1 << 24))
+  {
+    args.addError("--buckets must be between 1 and 16777216");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
   Results results(NUM_FLOATS);
-  std::cout << "\n\n";
-  std::cout << "Randocha\n";
-  std::cout << "========\n";
-  generateRandocha(results);
-  vizDistribution(results);
-  saveImage(results, "randocha.bmp");
-
-  std::cout << "\n\n";
-  std::cout << "SSE\n";
-  std::cout << "========\n";
-  generateSse(results);
-  vizDistribution(results);
-  saveImage(results, "rand_sse.bmp");
-
-  std::cout << "\n\n";
-  std::cout << "TEA\n";
-  std::cout << "========\n";
-  generateTea(results);
-  vizDistribution(results);
-  saveImage(results, "rand_tea.bmp");
-
-  std::cout << "\n\n";
-  std::cout << "Mersenne Twister\n";
-  std::cout << "================\n";
-  generateMT(results);
-  vizDistribution(results);
-  saveImage(results, "rand_mt.bmp");
+  forEachGenerator([&](auto entry) {
+    std::cout << "\n\n"
+              << entry.title << "\n"
+              << std::string(strlen(entry.title), '=') << "\n";
+    generate<typename decltype(entry)::Type>(results);
+    vizDistribution(results, numBuckets, numThreads);
+    saveImage(results, std::string(entry.fileStem) + ".bmp");
+  });
 
   return 0;
 }
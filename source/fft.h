@@ -0,0 +1,264 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+//------------------------------------------------------------------------------
+// Forward FFTs of any size, and a multi-threaded 2D FFT
+//
+// Power of two sizes use an iterative radix-2 transform. Any other size is
+// computed with Bluestein's algorithm, which re-expresses the DFT as a
+// convolution evaluated with power of two FFTs. Plans are immutable after
+// construction and can be shared between threads; each thread supplies its own
+// scratch space.
+//
+// Sources:
+// Cooley & Tukey, An Algorithm for the Machine Calculation of Complex Fourier
+// Series (1965)
+// Bluestein, A linear filtering approach to the computation of the discrete
+// Fourier transform (1968)
+//------------------------------------------------------------------------------
+using Complex = std::complex<float>;
+
+// Plain complex multiply; std::complex's operator* takes a slow path to handle
+// infinities/NaNs unless fast-math is enabled
+inline Complex
+complexMul(const Complex& a, const Complex& b)
+{
+  return Complex(
+    (a.real() * b.real()) - (a.imag() * b.imag()),
+    (a.real() * b.imag()) + (a.imag() * b.real()));
+}
+
+//------------------------------------------------------------------------------
+class Radix2Fft
+{
+public:
+  explicit Radix2Fft(size_t size = 1)
+      : m_size(size)
+      , m_twiddles(size / 2)
+      , m_bitReverse(size)
+  {
+    assert(size != 0 && (size & (size - 1)) == 0);
+
+    const double PI = 3.14159265358979323846;
+    for (size_t i = 0; i < size / 2; ++i)
+    {
+      const double angle = (-2.0 * PI * double(i)) / double(size);
+      m_twiddles[i]
+        = Complex(float(std::cos(angle)), float(std::sin(angle)));
+    }
+
+    size_t numBits = 0;
+    while ((size_t(1) << numBits) < size)
+    {
+      ++numBits;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+      size_t reversed = 0;
+      for (size_t bit = 0; bit < numBits; ++bit)
+      {
+        reversed |= ((i >> bit) & 1) << (numBits - 1 - bit);
+      }
+      m_bitReverse[i] = uint32_t(reversed);
+    }
+  }
+
+  size_t size() const { return m_size; }
+
+  //----------------------------------------------------------------------------
+  // In place. The inverse is unscaled.
+  //----------------------------------------------------------------------------
+  void transform(Complex* data, bool inverse = false) const
+  {
+    for (size_t i = 0; i < m_size; ++i)
+    {
+      const size_t j = m_bitReverse[i];
+      if (i < j)
+      {
+        std::swap(data[i], data[j]);
+      }
+    }
+
+    for (size_t half = 1; half < m_size; half *= 2)
+    {
+      const size_t twiddleStep = m_size / (half * 2);
+      for (size_t start = 0; start < m_size; start += half * 2)
+      {
+        for (size_t k = 0; k < half; ++k)
+        {
+          Complex w = m_twiddles[k * twiddleStep];
+          w         = inverse ? std::conj(w) : w;
+
+          const Complex odd      = complexMul(data[start + k + half], w);
+          const Complex even     = data[start + k];
+          data[start + k]        = even + odd;
+          data[start + k + half] = even - odd;
+        }
+      }
+    }
+  }
+
+private:
+  size_t m_size;
+  std::vector<Complex> m_twiddles;
+  std::vector<uint32_t> m_bitReverse;
+};
+
+//------------------------------------------------------------------------------
+class Fft
+{
+public:
+  explicit Fft(size_t size)
+      : m_size(size)
+  {
+    m_isPowerOfTwo = (size & (size - 1)) == 0;
+    if (m_isPowerOfTwo)
+    {
+      m_radix2 = Radix2Fft(size);
+      return;
+    }
+
+    // Bluestein: X[k] = conj(w[k]) * sum(x[n] conj(w[n]) * w[k - n])
+    // with chirp w[n] = exp(i pi n^2 / N), convolved at a power of two size
+    size_t convolutionSize = 1;
+    while (convolutionSize < (2 * size) - 1)
+    {
+      convolutionSize *= 2;
+    }
+    m_radix2 = Radix2Fft(convolutionSize);
+
+    const double PI = 3.14159265358979323846;
+    m_chirp.resize(size);
+    for (size_t n = 0; n < size; ++n)
+    {
+      // n^2 mod 2N keeps the angle accurate for large n
+      const uint64_t nSq = (uint64_t(n) * n) % (2 * uint64_t(size));
+      const double angle = (PI * double(nSq)) / double(size);
+      m_chirp[n] = Complex(float(std::cos(angle)), float(std::sin(angle)));
+    }
+
+    m_filter.assign(convolutionSize, Complex(0.0f, 0.0f));
+    m_filter[0] = m_chirp[0];
+    for (size_t n = 1; n < size; ++n)
+    {
+      m_filter[n]                   = m_chirp[n];
+      m_filter[convolutionSize - n] = m_chirp[n];
+    }
+    m_radix2.transform(m_filter.data());
+  }
+
+  size_t size() const { return m_size; }
+
+  // Complex values of scratch space transform() needs
+  size_t scratchSize() const { return m_isPowerOfTwo ? 0 : m_radix2.size(); }
+
+  //----------------------------------------------------------------------------
+  // In place forward transform
+  //----------------------------------------------------------------------------
+  void transform(Complex* data, Complex* scratch) const
+  {
+    if (m_isPowerOfTwo)
+    {
+      m_radix2.transform(data);
+      return;
+    }
+
+    const size_t convolutionSize = m_radix2.size();
+    for (size_t n = 0; n < m_size; ++n)
+    {
+      scratch[n] = complexMul(data[n], std::conj(m_chirp[n]));
+    }
+    std::fill(
+      scratch + m_size, scratch + convolutionSize, Complex(0.0f, 0.0f));
+
+    m_radix2.transform(scratch);
+    for (size_t i = 0; i < convolutionSize; ++i)
+    {
+      scratch[i] = complexMul(scratch[i], m_filter[i]);
+    }
+    m_radix2.transform(scratch, true);
+
+    const float scale = 1.0f / float(convolutionSize);
+    for (size_t k = 0; k < m_size; ++k)
+    {
+      data[k] = complexMul(scratch[k], std::conj(m_chirp[k])) * scale;
+    }
+  }
+
+private:
+  size_t m_size;
+  bool m_isPowerOfTwo = true;
+  Radix2Fft m_radix2;
+  std::vector<Complex> m_chirp;
+  std::vector<Complex> m_filter;
+};
+
+//------------------------------------------------------------------------------
+// In place forward 2D FFT of a row major width x height image.
+// Rows are transformed in parallel, then blocks of columns are gathered into
+// contiguous buffers so each thread reads whole cache lines.
+//------------------------------------------------------------------------------
+inline void
+fft2D(
+  std::vector<Complex>& image,
+  size_t width,
+  size_t height,
+  unsigned numThreads)
+{
+  static const size_t COLUMN_BLOCK = 16;
+  numThreads                       = std::max(1u, numThreads);
+
+  const Fft rowFft(width);
+  std::vector<std::vector<Complex>> scratch(
+    numThreads, std::vector<Complex>(rowFft.scratchSize()));
+  parallelFor(height, numThreads, [&](size_t row, unsigned thread) {
+    rowFft.transform(image.data() + (row * width), scratch[thread].data());
+  });
+
+  const Fft columnFft(height);
+  std::vector<std::vector<Complex>> columns(
+    numThreads, std::vector<Complex>(COLUMN_BLOCK * height));
+  for (auto& buffer : scratch)
+  {
+    buffer.resize(columnFft.scratchSize());
+  }
+
+  const size_t numBlocks = (width + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+  parallelFor(numBlocks, numThreads, [&](size_t block, unsigned thread) {
+    const size_t firstColumn = block * COLUMN_BLOCK;
+    const size_t numColumns  = std::min(COLUMN_BLOCK, width - firstColumn);
+    Complex* buffer          = columns[thread].data();
+
+    for (size_t y = 0; y < height; ++y)
+    {
+      const Complex* row = image.data() + (y * width) + firstColumn;
+      for (size_t c = 0; c < numColumns; ++c)
+      {
+        buffer[(c * height) + y] = row[c];
+      }
+    }
+
+    for (size_t c = 0; c < numColumns; ++c)
+    {
+      columnFft.transform(buffer + (c * height), scratch[thread].data());
+    }
+
+    for (size_t y = 0; y < height; ++y)
+    {
+      Complex* row = image.data() + (y * width) + firstColumn;
+      for (size_t c = 0; c < numColumns; ++c)
+      {
+        row[c] = buffer[(c * height) + y];
+      }
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,313 @@
+#include "randocha.h"
+#include "rand_pcg.h"
+#include "rand_philox.h"
+#include "rand_sfmt.h"
+#include "rand_splitmix.h"
+#include "rand_sse.h"
+#include "rand_tea.h"
+#include "rand_wyrand.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+//------------------------------------------------------------------------------
+// Generator correctness checks, run by ctest (generator_correctness)
+//
+// Known answers against the reference implementations' published outputs, and
+// every discard()/jump() against stepping the generator one call at a time.
+// Build with RANDOCHA_AVX2 as well to cover both SIMD paths. Exits with 1 if
+// any check fails.
+//
+// Sources:
+// pcg32-demo and pcg64-demo (seed 42, stream 54), https://www.pcg-random.org/
+// Random123 kat_vectors (philox4x32 10, zero key and counter)
+// SFMT-19937 reference output, SFMT.19937.out.txt (init_gen_rand(1234))
+//------------------------------------------------------------------------------
+static int g_numFailures = 0;
+
+//------------------------------------------------------------------------------
+static void
+check(bool isPassing, const std::string& name)
+{
+  std::printf("%s  %s\n", isPassing ? "pass" : "FAIL", name.c_str());
+  g_numFailures += isPassing ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
+static void
+testPcg32()
+{
+  static const uint32_t EXPECTED[]
+    = {0xa15c02b7, 0x7b47f409, 0xba1d3330, 0x83d2f293, 0xbfa4784b, 0xcbed606e};
+
+  uint64_t state     = 0;
+  uint64_t increment = 0;
+  RandPcg32::seedStream(state, increment, 42, 54);
+  bool isMatching = true;
+  for (uint32_t expected : EXPECTED)
+  {
+    isMatching = isMatching && RandPcg32::next(state, increment) == expected;
+  }
+  check(isMatching, "PCG32 known answers");
+}
+
+//------------------------------------------------------------------------------
+static void
+testPcg64()
+{
+  static const uint64_t EXPECTED[]
+    = {0x86b1da1d72062b68ull, 0x1304aa46c9853d39ull, 0xa3670e9e0dd50358ull};
+
+  RandPcg64::Uint128 state;
+  RandPcg64::Uint128 increment;
+  RandPcg64::seedStream(state, increment, {42, 0}, 54);
+  bool isMatching = true;
+  for (uint64_t expected : EXPECTED)
+  {
+    isMatching = isMatching && RandPcg64::next(state, increment) == expected;
+  }
+  check(isMatching, "PCG64 known answers");
+}
+
+//------------------------------------------------------------------------------
+static void
+testPhilox()
+{
+  static const uint32_t EXPECTED[]
+    = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+
+  RandPhilox4x32 rand(0);
+  alignas(32) uint32_t out[RandPhilox4x32::NUM_GENERATED];
+  rand.generate(out);
+  bool isMatching = true;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    isMatching = isMatching && out[i] == EXPECTED[i];
+  }
+  check(isMatching, "Philox4x32-10 known answers");
+}
+
+//------------------------------------------------------------------------------
+// discard(n) then generate() gives the values of the (n + 1)th generate() call
+// Odd counts, and counts past 2^16 calls, where 32-bit counters would carry.
+//------------------------------------------------------------------------------
+template <typename Rand>
+static void
+testDiscard(const char* name, Rand jumped)
+{
+  alignas(32) float out[Rand::NUM_GENERATED];
+  alignas(32) float expected[Rand::NUM_GENERATED];
+  for (uint64_t numCalls : {1ull, 7ull, 1001ull, 65537ull})
+  {
+    Rand rand    = jumped;
+    Rand stepped = jumped;
+    rand.discard(numCalls);
+    for (uint64_t i = 0; i < numCalls; ++i)
+    {
+      stepped.generate(expected);
+    }
+    rand.generate(out);
+    stepped.generate(expected);
+    check(
+      std::equal(std::begin(out), std::end(out), std::begin(expected)),
+      fmt::format("{} discard({}) matches stepping", name, numCalls));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Randocha::discard() also drops the values buffered for next()
+//------------------------------------------------------------------------------
+static void
+testRandochaNext()
+{
+  const uint64_t NUM_CALLS = 5;
+  Randocha rand(42);
+  Randocha stepped(42);
+  alignas(16) float expected[Randocha::NUM_GENERATED];
+
+  // 3 values of the first call's block, then skip the next NUM_CALLS calls
+  for (int i = 0; i < 3; ++i)
+  {
+    rand.next();
+  }
+  rand.discard(NUM_CALLS);
+  for (uint64_t i = 0; i < NUM_CALLS + 2; ++i)
+  {
+    stepped.generate(expected);
+  }
+
+  bool isMatching = true;
+  for (float value : expected)
+  {
+    isMatching = isMatching && rand.next() == value;
+  }
+  check(isMatching, "Randocha next() resumes at a block after discard()");
+}
+
+//------------------------------------------------------------------------------
+// Counter n's words are the scalar encryption of n under the seed's key
+//------------------------------------------------------------------------------
+template <size_t COUNTERS, int ROUNDS>
+static void
+testTeaSimd()
+{
+  using Rand = RandTeaSimd<COUNTERS, ROUNDS>;
+  const uint64_t SEED = 5;
+  const uint64_t SKIP = 3;
+
+  uint64_t seed      = SEED;
+  const uint64_t k01 = splitMix64(seed);
+  const uint64_t k23 = splitMix64(seed);
+  const uint32_t key[4]
+    = {uint32_t(k01), uint32_t(k01 >> 32), uint32_t(k23), uint32_t(k23 >> 32)};
+
+  Rand rand(SEED);
+  rand.discard(SKIP);
+  alignas(32) uint32_t out[Rand::NUM_GENERATED];
+  rand.generate(out);
+
+  bool isMatching = true;
+  for (size_t i = 0; i < COUNTERS; ++i)
+  {
+    const uint64_t counter = (SKIP * COUNTERS) + i;
+    uint32_t v[2]          = {uint32_t(counter), uint32_t(counter >> 32)};
+    Rand::encrypt(v, key);
+    isMatching = isMatching && v[0] == out[i] && v[1] == out[COUNTERS + i];
+  }
+  check(
+    isMatching,
+    fmt::format(
+      "RandTeaSimd<{}, {}> matches encrypt() after discard({})",
+      COUNTERS,
+      ROUNDS,
+      SKIP));
+}
+
+//------------------------------------------------------------------------------
+// Most calls, of NUM_LANE_CALLS, on which any two lanes gave the same low or
+// high half. Two distinct 32-bit LCGs agree on a 16-bit half by chance, 1 in
+// 65536; a lane repeating another agrees on one half every call.
+//------------------------------------------------------------------------------
+static const size_t NUM_LANE_CALLS = 4096;
+
+static size_t
+mostLaneRepeats(RandSSEx8 rand)
+{
+  const size_t NUM_LANES = RandSSEx8::NUM_LANES;
+  alignas(32) float out[RandSSEx8::NUM_GENERATED];
+  size_t numMatches[NUM_LANES][NUM_LANES] = {};
+  for (size_t call = 0; call < NUM_LANE_CALLS; ++call)
+  {
+    rand.generate(out);
+    for (size_t a = 0; a < NUM_LANES; ++a)
+    {
+      for (size_t b = a + 1; b < NUM_LANES; ++b)
+      {
+        numMatches[a][b] += (out[a] == out[b]) ? 1 : 0;
+        numMatches[a][b] += (out[NUM_LANES + a] == out[NUM_LANES + b]) ? 1 : 0;
+      }
+    }
+  }
+
+  size_t mostMatches = 0;
+  for (size_t a = 0; a < NUM_LANES; ++a)
+  {
+    for (size_t b = a + 1; b < NUM_LANES; ++b)
+    {
+      mostMatches = std::max(mostMatches, numMatches[a][b]);
+    }
+  }
+  return mostMatches;
+}
+
+//------------------------------------------------------------------------------
+static void
+testSseX8()
+{
+  testDiscard("RandSSEx8", RandSSEx8(42));
+
+  check(
+    mostLaneRepeats(RandSSEx8()) < NUM_LANE_CALLS / 64,
+    "RandSSEx8() lanes don't repeat each other");
+  for (uint32_t seed : {0u, 42u, 1u << 14})
+  {
+    check(
+      mostLaneRepeats(RandSSEx8(seed)) < NUM_LANE_CALLS / 64,
+      fmt::format("RandSSEx8({}) lanes don't repeat each other", seed));
+  }
+}
+
+//------------------------------------------------------------------------------
+static void
+testSfmt()
+{
+  static const uint32_t EXPECTED[] = {3440181298,
+                                      1564997079,
+                                      1510669302,
+                                      2930277156,
+                                      1452439940,
+                                      3796268453,
+                                      423124208,
+                                      2143818589};
+
+  RandSfmt rand(1234);
+  uint32_t out[RandSfmt::NUM_GENERATED];
+  rand.fill(out, RandSfmt::NUM_GENERATED);
+  check(
+    std::equal(std::begin(out), std::end(out), std::begin(EXPECTED)),
+    "SFMT-19937 known answers");
+
+  // Within the first block, across one, and across several
+  for (uint64_t numCalls : {1ull, 77ull, 78ull, 1000ull, 12345ull})
+  {
+    RandSfmt jumped(7);
+    RandSfmt stepped(7);
+    uint32_t expected[RandSfmt::NUM_GENERATED];
+    jumped.fill(out, RandSfmt::NUM_GENERATED);
+    stepped.fill(expected, RandSfmt::NUM_GENERATED);
+
+    jumped.jump(numCalls);
+    for (uint64_t i = 0; i < numCalls; ++i)
+    {
+      stepped.fill(expected, RandSfmt::NUM_GENERATED);
+    }
+    jumped.fill(out, RandSfmt::NUM_GENERATED);
+    stepped.fill(expected, RandSfmt::NUM_GENERATED);
+    check(
+      std::equal(std::begin(out), std::end(out), std::begin(expected)),
+      fmt::format("SFMT-19937 jump({}) matches stepping", numCalls));
+  }
+}
+
+//------------------------------------------------------------------------------
+int
+main()
+{
+  testPcg32();
+  testPcg64();
+  testPhilox();
+  testDiscard("Philox4x32-10", RandPhilox4x32(7));
+  testDiscard("Randocha", Randocha(7));
+  testRandochaNext();
+  testDiscard("SplitMix64", RandSplitMix64(7));
+  testDiscard("wyrand", RandWyrand(7));
+  testTeaSimd<4, 4>();
+  testTeaSimd<8, 8>();
+  testTeaSimd<16, 8>();
+  testTeaSimd<32, 3>();
+  testDiscard("RandTeaSimd<16, 8>", RandTeaSimd<>(7));
+  testSseX8();
+  testSfmt();
+
+  if (g_numFailures > 0)
+  {
+    std::printf("%d checks failed\n", g_numFailures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
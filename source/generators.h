@@ -0,0 +1,281 @@
+#pragma once
+
+#include "randocha.h"
+#include "rand_sse.h"
+#include "rand_tea.h"
+#include "rand_mt.h"
+#include "rand_xoshiro.h"
+#include "rand_pcg.h"
+#include "rand_wyrand.h"
+#include "rand_splitmix.h"
+#include "rand_philox.h"
+#include "rand_sfmt.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+//------------------------------------------------------------------------------
+// The generator concept, and the registry of every generator the tools compare
+//
+// GeneratorTraits<Rand> describes how to drive an engine:
+//   BLOCK_SIZE           values written by one generate()
+//   Output               type of those values (floats in [0 -> 1))
+//   Seed                 the engine's seed constructor argument
+//   generate(rand, out)  fills one block
+//   HAS_DISCARD          discard(rand, numBlocks) skips ahead cheaply
+//   HAS_NEXT             next(rand) returns a single value
+//   HAS_FILL             fill(rand, out, count) fills many blocks natively
+//
+// The primary template covers engines with generate(float[NUM_GENERATED]),
+// detecting discard(), next() and fill(); the older engines are specialised
+// below.
+// BulkGenerator then fills any whole number of blocks from any engine, so the
+// tools call every generator the same batched way.
+//------------------------------------------------------------------------------
+template <typename Rand, typename = void>
+struct HasDiscard : std::false_type
+{
+};
+
+template <typename Rand>
+struct HasDiscard<
+  Rand,
+  std::void_t<decltype(std::declval<Rand&>().discard(uint64_t(0)))>>
+    : std::true_type
+{
+};
+
+template <typename Rand, typename = void>
+struct HasNext : std::false_type
+{
+};
+
+template <typename Rand>
+struct HasNext<Rand, std::void_t<decltype(std::declval<Rand&>().next())>>
+    : std::true_type
+{
+};
+
+template <typename Rand, typename = void>
+struct HasFill : std::false_type
+{
+};
+
+template <typename Rand>
+struct HasFill<
+  Rand,
+  std::void_t<decltype(std::declval<Rand&>().fill(
+    std::declval<float*>(), size_t(0)))>> : std::true_type
+{
+};
+
+//------------------------------------------------------------------------------
+template <typename Rand>
+struct GeneratorTraits
+{
+  static const size_t BLOCK_SIZE = Rand::NUM_GENERATED;
+  using Output                   = float;
+  using Seed                     = uint64_t;
+
+  static const bool HAS_DISCARD = HasDiscard<Rand>::value;
+  static const bool HAS_NEXT    = HasNext<Rand>::value;
+  static const bool HAS_FILL    = HasFill<Rand>::value;
+
+  static void generate(Rand& rand, Output* out) { rand.generate(out); }
+  static void fill(Rand& rand, Output* out, size_t count)
+  {
+    rand.fill(out, count);
+  }
+  static void discard(Rand& rand, uint64_t numBlocks)
+  {
+    rand.discard(numBlocks);
+  }
+  static Output next(Rand& rand) { return rand.next(); }
+};
+
+//------------------------------------------------------------------------------
+template <>
+struct GeneratorTraits<RandSSE>
+{
+  static const size_t BLOCK_SIZE = RandSSE::NUM_GENERATED;
+  using Output                   = float;
+  using Seed                     = uint32_t;
+
+  static const bool HAS_DISCARD = false;
+  static const bool HAS_NEXT    = false;
+  static const bool HAS_FILL    = false;
+
+  static void generate(RandSSE& rand, Output* out) { rand.rand_sse(out); }
+};
+
+//------------------------------------------------------------------------------
+template <>
+struct GeneratorTraits<RandTea>
+{
+  static const size_t BLOCK_SIZE = RandTea::NUM_GENERATED;
+  using Output                   = float;
+  using Seed                     = uint64_t;
+
+  static const bool HAS_DISCARD = false;
+  static const bool HAS_NEXT    = false;
+  static const bool HAS_FILL    = false;
+
+  static void generate(RandTea& rand, Output* out)
+  {
+    rand.generate();
+    out[0] = rand.getF(0);
+    out[1] = rand.getF(1);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <>
+struct GeneratorTraits<RandMT>
+{
+  static const size_t BLOCK_SIZE = RandMT::NUM_GENERATED;
+  using Output                   = float;
+  using Seed                     = uint32_t;
+
+  static const bool HAS_DISCARD = false;
+  static const bool HAS_NEXT    = true;
+  static const bool HAS_FILL    = false;
+
+  static void generate(RandMT& rand, Output* out) { out[0] = rand.generate(); }
+  static Output next(RandMT& rand) { return rand.generate(); }
+};
+
+//------------------------------------------------------------------------------
+// Owns an engine and fills whole blocks of its output
+//------------------------------------------------------------------------------
+template <typename Rand>
+class BulkGenerator
+{
+public:
+  using Traits = GeneratorTraits<Rand>;
+  using Output = typename Traits::Output;
+
+  static const size_t BLOCK_SIZE = Traits::BLOCK_SIZE;
+
+  BulkGenerator() = default;
+  explicit BulkGenerator(uint64_t seed)
+      : m_rand(typename Traits::Seed(seed))
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // count rounded up to a whole number of blocks, for filling partial chunks
+  //----------------------------------------------------------------------------
+  static size_t wholeBlocks(size_t count)
+  {
+    return ((count + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+  }
+
+  //----------------------------------------------------------------------------
+  // count must be a multiple of BLOCK_SIZE
+  //----------------------------------------------------------------------------
+  void fill(Output* out, size_t count)
+  {
+    assert((count % BLOCK_SIZE) == 0);
+    if constexpr (Traits::HAS_FILL)
+    {
+      Traits::fill(m_rand, out, count);
+    }
+    else
+    {
+      for (size_t i = 0; i < count; i += BLOCK_SIZE)
+      {
+        Traits::generate(m_rand, out + i);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // A fixed size fill, which the compiler unrolls into consecutive calls
+  //----------------------------------------------------------------------------
+  template <size_t COUNT>
+  void fill(Output (&out)[COUNT])
+  {
+    static_assert(
+      (COUNT % BLOCK_SIZE) == 0,
+      "Must fill an exact multiple of the number generated per call");
+    for (size_t i = 0; i < COUNT; i += BLOCK_SIZE)
+    {
+      Traits::generate(m_rand, out + i);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numBlocks blocks (generators with HAS_DISCARD only)
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numBlocks) { Traits::discard(m_rand, numBlocks); }
+
+  Output next() { return Traits::next(m_rand); }
+
+  Rand& engine() { return m_rand; }
+
+private:
+  Rand m_rand;
+};
+
+//------------------------------------------------------------------------------
+// Registry
+//
+// forEachGenerator(func) calls func(GeneratorEntry<Rand>{...}) for each engine,
+// in report order. func is usually a generic lambda, instantiated per engine
+// through decltype(entry)::Type, e.g.
+//   forEachGenerator([](auto entry) {
+//     using Generator = BulkGenerator<typename decltype(entry)::Type>;
+//     ...
+//   });
+//------------------------------------------------------------------------------
+template <typename Rand>
+struct GeneratorEntry
+{
+  using Type = Rand;
+
+  const char* id;          // command line and report key
+  const char* title;       // display name
+  const char* fileStem;    // prefix of output files
+};
+
+template <typename Func>
+void
+forEachGenerator(Func func)
+{
+  func(GeneratorEntry<Randocha>{"randocha", "Randocha", "randocha"});
+  func(GeneratorEntry<RandSSE>{"sse", "SSE", "rand_sse"});
+  func(GeneratorEntry<RandSSEx8>{"sse8", "SSE x8", "rand_sse8"});
+  func(GeneratorEntry<RandTea>{"tea", "TEA", "rand_tea"});
+  func(GeneratorEntry<RandTeaSimd<>>{"tea_simd", "TEA SIMD", "rand_tea_simd"});
+  func(GeneratorEntry<RandMT>{"mt", "Mersenne Twister", "rand_mt"});
+  func(GeneratorEntry<RandSfmt>{"sfmt", "SFMT19937", "rand_sfmt"});
+  func(GeneratorEntry<RandXoshiro256pp>{
+    "xoshiro256pp", "xoshiro256++", "rand_xoshiro256pp"});
+  func(GeneratorEntry<RandXoshiro128p>{
+    "xoshiro128p", "xoshiro128+", "rand_xoshiro128p"});
+  func(GeneratorEntry<RandPcg32>{"pcg32", "PCG32", "rand_pcg32"});
+  func(GeneratorEntry<RandPcg64>{"pcg64", "PCG64", "rand_pcg64"});
+  func(GeneratorEntry<RandWyrand>{"wyrand", "wyrand", "rand_wyrand"});
+  func(GeneratorEntry<RandSplitMix64>{
+    "splitmix64", "SplitMix64", "rand_splitmix64"});
+  func(GeneratorEntry<RandPhilox4x32>{
+    "philox", "Philox4x32-10", "rand_philox"});
+}
+
+//------------------------------------------------------------------------------
+// Buffers of a multiple of this many values can be filled by every generator
+//------------------------------------------------------------------------------
+inline size_t
+largestBlockSize()
+{
+  size_t largest = 1;
+  forEachGenerator([&largest](auto entry) {
+    using Traits = GeneratorTraits<typename decltype(entry)::Type>;
+    largest      = std::max(largest, size_t(Traits::BLOCK_SIZE));
+  });
+  return largest;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,309 @@
+#pragma once
+
+#include "parallel.h"
+
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <vector>
+//------------------------------------------------------------------------------
+// Multi-threaded histogram of floats in [0 -> 1) with any number of buckets
+//
+// Values are quantized several at a time with SIMD: 4 with SSE in the default
+// build, 8 with RANDOCHA_AVX2 and 16 with RANDOCHA_AVX512. Consecutive lanes
+// are counted into separate sub-histograms, so runs of equal buckets don't
+// stall on store forwarding from the previous increment. Each thread owns its
+// sub-histograms; they are merged once at the end.
+//
+// Values outside [0 -> 1) (and NaNs) are counted and clamped to the end
+// buckets rather than asserted on.
+//------------------------------------------------------------------------------
+struct Histogram
+{
+  explicit Histogram(size_t numBuckets = 0)
+      : counts(numBuckets)
+  {
+  }
+
+  void merge(const Histogram& other)
+  {
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+      counts[i] += other.counts[i];
+    }
+    numValues += other.numValues;
+    numOutOfRange += other.numOutOfRange;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+
+  std::vector<uint64_t> counts;
+  uint64_t numValues     = 0;
+  uint64_t numOutOfRange = 0;
+  double sum             = 0.0;
+  float min              = std::numeric_limits<float>::max();
+  float max              = std::numeric_limits<float>::lowest();
+};
+
+//------------------------------------------------------------------------------
+// Per-thread histogram accumulation
+//------------------------------------------------------------------------------
+class HistogramKernel
+{
+public:
+  static constexpr size_t NUM_SUB_HISTOGRAMS = 4;
+
+  explicit HistogramKernel(size_t numBuckets)
+      : m_numBuckets(numBuckets)
+      , m_subCounts(NUM_SUB_HISTOGRAMS * numBuckets)
+      , m_result(numBuckets)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void add(const float* values, size_t count)
+  {
+    // Keep the 32-bit sub-histogram counters from overflowing
+    static const size_t MAX_BATCH = size_t(1) << 30;
+    while (count > 0)
+    {
+      const size_t batch = std::min(count, MAX_BATCH - m_pending);
+      addBatch(values, batch);
+      values += batch;
+      count -= batch;
+      m_pending += batch;
+      if (m_pending == MAX_BATCH)
+      {
+        flush();
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Folds the sub-histograms together. Call before reading the result.
+  //----------------------------------------------------------------------------
+  const Histogram& result()
+  {
+    flush();
+    return m_result;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  void flush()
+  {
+    for (size_t sub = 0; sub < NUM_SUB_HISTOGRAMS; ++sub)
+    {
+      uint32_t* counts = m_subCounts.data() + (sub * m_numBuckets);
+      for (size_t i = 0; i < m_numBuckets; ++i)
+      {
+        m_result.counts[i] += counts[i];
+        counts[i] = 0;
+      }
+    }
+    m_pending = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  static int countBits(uint32_t mask)
+  {
+    return int(std::bitset<32>(mask).count());
+  }
+
+  //----------------------------------------------------------------------------
+  void addBatch(const float* values, size_t count)
+  {
+    uint32_t* sub0 = m_subCounts.data();
+    uint32_t* sub1 = sub0 + m_numBuckets;
+    uint32_t* sub2 = sub1 + m_numBuckets;
+    uint32_t* sub3 = sub2 + m_numBuckets;
+
+    const float scale   = float(m_numBuckets);
+    const float maxIdx  = float(m_numBuckets - 1);
+    uint64_t outOfRange = 0;
+    size_t i            = 0;
+
+#if defined(__AVX512F__)
+    static const size_t LANES = 16;
+    alignas(64) int32_t idx[LANES];
+    const __m512 vScale  = _mm512_set1_ps(scale);
+    const __m512 vMaxIdx = _mm512_set1_ps(maxIdx);
+    const __m512 vZero   = _mm512_setzero_ps();
+    const __m512 vOne    = _mm512_set1_ps(1.0f);
+    __m512 vMin          = _mm512_set1_ps(m_result.min);
+    __m512 vMax          = _mm512_set1_ps(m_result.max);
+    __m512d vSum         = _mm512_setzero_pd();
+    for (; i + LANES <= count; i += LANES)
+    {
+      const __m512 x = _mm512_loadu_ps(values + i);
+      const __mmask16 inRange
+        = _mm512_cmp_ps_mask(x, vZero, _CMP_GE_OQ)
+          & _mm512_cmp_ps_mask(x, vOne, _CMP_LT_OQ);
+      outOfRange += uint64_t(LANES - countBits(inRange));
+      vMin = _mm512_min_ps(x, vMin);
+      vMax = _mm512_max_ps(x, vMax);
+      vSum = _mm512_add_pd(
+        vSum, _mm512_cvtps_pd(_mm512_castps512_ps256(x)));
+      vSum = _mm512_add_pd(
+        vSum,
+        _mm512_cvtps_pd(_mm256_castpd_ps(
+          _mm512_extractf64x4_pd(_mm512_castps_pd(x), 1))));
+
+      const __m512 scaled = _mm512_min_ps(
+        _mm512_max_ps(_mm512_mul_ps(x, vScale), vZero), vMaxIdx);
+      _mm512_store_si512(idx, _mm512_cvttps_epi32(scaled));
+      for (size_t lane = 0; lane < LANES; lane += 4)
+      {
+        sub0[idx[lane + 0]]++;
+        sub1[idx[lane + 1]]++;
+        sub2[idx[lane + 2]]++;
+        sub3[idx[lane + 3]]++;
+      }
+    }
+    m_result.sum += _mm512_reduce_add_pd(vSum);
+    m_result.min = _mm512_reduce_min_ps(vMin);
+    m_result.max = _mm512_reduce_max_ps(vMax);
+#elif defined(__AVX2__)
+    static const size_t LANES = 8;
+    alignas(32) int32_t idx[LANES];
+    alignas(32) float lanes[LANES];
+    const __m256 vScale  = _mm256_set1_ps(scale);
+    const __m256 vMaxIdx = _mm256_set1_ps(maxIdx);
+    const __m256 vZero   = _mm256_setzero_ps();
+    const __m256 vOne    = _mm256_set1_ps(1.0f);
+    __m256 vMin          = _mm256_set1_ps(m_result.min);
+    __m256 vMax          = _mm256_set1_ps(m_result.max);
+    __m256d vSum         = _mm256_setzero_pd();
+    for (; i + LANES <= count; i += LANES)
+    {
+      const __m256 x       = _mm256_loadu_ps(values + i);
+      const __m256 inRange = _mm256_and_ps(
+        _mm256_cmp_ps(x, vZero, _CMP_GE_OQ),
+        _mm256_cmp_ps(x, vOne, _CMP_LT_OQ));
+      outOfRange += uint64_t(LANES - countBits(_mm256_movemask_ps(inRange)));
+      vMin = _mm256_min_ps(x, vMin);
+      vMax = _mm256_max_ps(x, vMax);
+      vSum = _mm256_add_pd(
+        vSum, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+      vSum = _mm256_add_pd(
+        vSum, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+
+      const __m256 scaled = _mm256_min_ps(
+        _mm256_max_ps(_mm256_mul_ps(x, vScale), vZero), vMaxIdx);
+      _mm256_store_si256(
+        reinterpret_cast<__m256i*>(idx), _mm256_cvttps_epi32(scaled));
+      sub0[idx[0]]++;
+      sub1[idx[1]]++;
+      sub2[idx[2]]++;
+      sub3[idx[3]]++;
+      sub0[idx[4]]++;
+      sub1[idx[5]]++;
+      sub2[idx[6]]++;
+      sub3[idx[7]]++;
+    }
+    alignas(32) double sums[4];
+    _mm256_store_pd(sums, vSum);
+    m_result.sum += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    _mm256_store_ps(lanes, vMin);
+    m_result.min = *std::min_element(lanes, lanes + LANES);
+    _mm256_store_ps(lanes, vMax);
+    m_result.max = *std::max_element(lanes, lanes + LANES);
+#else
+    static const size_t LANES = 4;
+    alignas(16) int32_t idx[LANES];
+    alignas(16) float lanes[LANES];
+    const __m128 vScale  = _mm_set1_ps(scale);
+    const __m128 vMaxIdx = _mm_set1_ps(maxIdx);
+    const __m128 vZero   = _mm_setzero_ps();
+    const __m128 vOne    = _mm_set1_ps(1.0f);
+    __m128 vMin          = _mm_set1_ps(m_result.min);
+    __m128 vMax          = _mm_set1_ps(m_result.max);
+    __m128d vSum         = _mm_setzero_pd();
+    for (; i + LANES <= count; i += LANES)
+    {
+      const __m128 x = _mm_loadu_ps(values + i);
+      const __m128 inRange
+        = _mm_and_ps(_mm_cmpge_ps(x, vZero), _mm_cmplt_ps(x, vOne));
+      outOfRange += uint64_t(LANES - countBits(_mm_movemask_ps(inRange)));
+      vMin = _mm_min_ps(x, vMin);
+      vMax = _mm_max_ps(x, vMax);
+      vSum = _mm_add_pd(vSum, _mm_cvtps_pd(x));
+      vSum = _mm_add_pd(vSum, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+
+      const __m128 scaled
+        = _mm_min_ps(_mm_max_ps(_mm_mul_ps(x, vScale), vZero), vMaxIdx);
+      _mm_store_si128(reinterpret_cast<__m128i*>(idx), _mm_cvttps_epi32(scaled));
+      sub0[idx[0]]++;
+      sub1[idx[1]]++;
+      sub2[idx[2]]++;
+      sub3[idx[3]]++;
+    }
+    alignas(16) double sums[2];
+    _mm_store_pd(sums, vSum);
+    m_result.sum += sums[0] + sums[1];
+    _mm_store_ps(lanes, vMin);
+    m_result.min = *std::min_element(lanes, lanes + LANES);
+    _mm_store_ps(lanes, vMax);
+    m_result.max = *std::max_element(lanes, lanes + LANES);
+#endif
+
+    // Remainder
+    for (; i < count; ++i)
+    {
+      const float x = values[i];
+      outOfRange += uint64_t(!(x >= 0.0f && x < 1.0f));
+      m_result.min = std::min(m_result.min, x);
+      m_result.max = std::max(m_result.max, x);
+      m_result.sum += double(x);
+      // NaN fails the comparison, so lands in bucket 0 as with _mm_max_ps
+      const float scaledX = x * scale;
+      const float scaled
+        = (scaledX >= 0.0f) ? std::min(scaledX, maxIdx) : 0.0f;
+      sub0[size_t(scaled)]++;
+    }
+
+    m_result.numValues += count;
+    m_result.numOutOfRange += outOfRange;
+  }
+
+  size_t m_numBuckets;
+  size_t m_pending = 0;
+  std::vector<uint32_t> m_subCounts;
+  Histogram m_result;
+};
+
+//------------------------------------------------------------------------------
+// Histograms count values on numThreads threads
+//------------------------------------------------------------------------------
+inline Histogram
+parallelHistogram(
+  const float* values, size_t count, size_t numBuckets, unsigned numThreads)
+{
+  static const size_t CHUNK_SIZE = 1 << 16;
+  numThreads = std::max(1u, numThreads);
+
+  std::vector<HistogramKernel> kernels(numThreads, HistogramKernel(numBuckets));
+  const size_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  parallelFor(numChunks, numThreads, [&](size_t chunk, unsigned thread) {
+    const size_t begin = chunk * CHUNK_SIZE;
+    kernels[thread].add(
+      values + begin, std::min(CHUNK_SIZE, count - begin));
+  });
+
+  Histogram result(numBuckets);
+  for (auto& kernel : kernels)
+  {
+    result.merge(kernel.result());
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+#include "histogram.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Histogram kernel checks, run by ctest (histogram_correctness)
+//
+// Out of range values (NaN, infinities, 1.0) must be counted and clamped to
+// the end buckets both in the SIMD loop and in the scalar remainder. Build
+// with RANDOCHA_AVX2 and RANDOCHA_AVX512 as well to cover every kernel. Exits
+// with 1 if any check fails.
+//------------------------------------------------------------------------------
+static int g_numFailures = 0;
+
+//------------------------------------------------------------------------------
+static void
+check(bool isPassing, const std::string& name)
+{
+  std::printf("%s  %s\n", isPassing ? "pass" : "FAIL", name.c_str());
+  g_numFailures += isPassing ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
+// Each call adds 16 values (one AVX-512 register, several narrower ones) then
+// 3 more, which are left over for the scalar remainder at every lane width
+//------------------------------------------------------------------------------
+static void
+testOutOfRange()
+{
+  const size_t NUM_BUCKETS = 10;
+  const size_t NUM_SIMD    = 16;
+  const float NaN          = std::numeric_limits<float>::quiet_NaN();
+  const float INF          = std::numeric_limits<float>::infinity();
+
+  // The remainder of each call
+  const std::vector<std::vector<float>> TAILS = {
+    {NaN, INF, -INF},
+    {1.0f, NaN, 0.55f},
+    {-0.25f, 2.0f, 0.0f},
+  };
+  const std::vector<float> SIMD_SPECIALS = {NaN, INF, -INF, 1.0f};
+
+  HistogramKernel kernel(NUM_BUCKETS);
+  std::vector<uint64_t> expected(NUM_BUCKETS);
+  uint64_t expectedOutOfRange = 0;
+  uint64_t numValues          = 0;
+  auto expect = [&](float x) {
+    const bool isInRange = x >= 0.0f && x < 1.0f;
+    size_t bucket        = 0;    // negative or NaN
+    if (isInRange)
+    {
+      bucket = size_t(x * float(NUM_BUCKETS));
+    }
+    else if (x >= 1.0f)
+    {
+      bucket = NUM_BUCKETS - 1;
+    }
+    expected[bucket]++;
+    expectedOutOfRange += isInRange ? 0 : 1;
+    ++numValues;
+  };
+
+  for (size_t call = 0; call < TAILS.size(); ++call)
+  {
+    std::vector<float> values;
+    for (size_t i = 0; i < NUM_SIMD; ++i)
+    {
+      values.push_back(float(i) / float(NUM_SIMD));
+    }
+    // Specials in the SIMD part too, on the second call
+    if (call == 1)
+    {
+      std::copy(SIMD_SPECIALS.begin(), SIMD_SPECIALS.end(), values.begin());
+    }
+    values.insert(values.end(), TAILS[call].begin(), TAILS[call].end());
+
+    for (float x : values)
+    {
+      expect(x);
+    }
+    kernel.add(values.data(), values.size());
+  }
+
+  const Histogram& result = kernel.result();
+  check(result.counts == expected, "bucket counts, NaN and infinities clamped");
+  check(
+    result.numOutOfRange == expectedOutOfRange,
+    fmt::format(
+      "{} values out of range (expected {})",
+      result.numOutOfRange,
+      expectedOutOfRange));
+  check(result.numValues == numValues, "every value counted");
+}
+
+//------------------------------------------------------------------------------
+int
+main()
+{
+  testOutOfRange();
+
+  if (g_numFailures > 0)
+  {
+    std::printf("%d checks failed\n", g_numFailures);
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+//------------------------------------------------------------------------------
+// Log bucketed latency histogram in the style of HdrHistogram
+//
+// Values below 2^(SUB_BUCKET_BITS + 1) get a bucket each. Above that, every
+// power of two range is split into 2^SUB_BUCKET_BITS equal buckets, so any
+// value is recorded to within 1/128 (< 0.8%) of its magnitude, across the whole
+// 64-bit range, in a fixed 58KB of counters. Recording is a few instructions
+// and never allocates, and nothing is discarded: the slowest samples are kept
+// along with the rest.
+//
+// Sources:
+// Gil Tene, HdrHistogram: http://hdrhistogram.org/
+//------------------------------------------------------------------------------
+class LatencyHistogram
+{
+public:
+  static constexpr unsigned SUB_BUCKET_BITS = 7;
+  static constexpr size_t NUM_BUCKETS
+    = (size_t(64 - SUB_BUCKET_BITS - 1) << SUB_BUCKET_BITS)
+      + (size_t(1) << (SUB_BUCKET_BITS + 1));
+
+  LatencyHistogram()
+      : m_counts(NUM_BUCKETS, 0)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void record(uint64_t value)
+  {
+    m_counts[bucketIndex(value)]++;
+    m_count++;
+    m_sum += double(value);
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+  }
+
+  //----------------------------------------------------------------------------
+  void merge(const LatencyHistogram& other)
+  {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  uint64_t count() const { return m_count; }
+  uint64_t min() const { return (m_count > 0) ? m_min : 0; }
+  uint64_t max() const { return m_max; }
+  double mean() const { return (m_count > 0) ? m_sum / double(m_count) : 0.0; }
+
+  //----------------------------------------------------------------------------
+  // Smallest recorded value v such that percentile% of the samples are <= v,
+  // as the highest value of its bucket (HdrHistogram's convention), clamped to
+  // the exact min/max
+  //----------------------------------------------------------------------------
+  uint64_t percentile(double percentile) const
+  {
+    if (m_count == 0)
+    {
+      return 0;
+    }
+
+    const double fraction = std::min(std::max(percentile, 0.0), 100.0) / 100.0;
+    const uint64_t target
+      = std::max<uint64_t>(1, uint64_t(fraction * double(m_count) + 0.5));
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      cumulative += m_counts[i];
+      if (cumulative >= target)
+      {
+        return std::min(std::max(bucketUpper(i), m_min), m_max);
+      }
+    }
+    return m_max;
+  }
+
+  //----------------------------------------------------------------------------
+  // Number of samples greater than value
+  //----------------------------------------------------------------------------
+  uint64_t countAbove(uint64_t value) const
+  {
+    uint64_t total = 0;
+    for (size_t i = bucketIndex(value) + 1; i < NUM_BUCKETS; ++i)
+    {
+      total += m_counts[i];
+    }
+    return total;
+  }
+
+  //----------------------------------------------------------------------------
+  // CSV of the non-empty buckets: lower, upper, count, cumulative percentile
+  //----------------------------------------------------------------------------
+  bool writeCsv(const char* fileName) const
+  {
+    FILE* file = std::fopen(fileName, "wb");
+    if (!file)
+    {
+      return false;
+    }
+
+    std::fprintf(file, "lower,upper,count,percentile\n");
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      if (m_counts[i] == 0)
+      {
+        continue;
+      }
+      cumulative += m_counts[i];
+      std::fprintf(
+        file,
+        "%llu,%llu,%llu,%.6f\n",
+        static_cast<unsigned long long>(bucketLower(i)),
+        static_cast<unsigned long long>(bucketUpper(i)),
+        static_cast<unsigned long long>(m_counts[i]),
+        (100.0 * double(cumulative)) / double(m_count));
+    }
+
+    const bool success = !std::ferror(file);
+    return (std::fclose(file) == 0) && success;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  static size_t bucketIndex(uint64_t value)
+  {
+    if (value < (uint64_t(1) << (SUB_BUCKET_BITS + 1)))
+    {
+      return size_t(value);
+    }
+
+    unsigned msb = 63;
+    while (!(value >> msb))
+    {
+      --msb;
+    }
+    const unsigned shift = msb - SUB_BUCKET_BITS;
+    return (size_t(shift) << SUB_BUCKET_BITS) + size_t(value >> shift);
+  }
+
+  static uint64_t bucketLower(size_t index)
+  {
+    if (index < (size_t(1) << (SUB_BUCKET_BITS + 1)))
+    {
+      return index;
+    }
+    const unsigned shift     = unsigned(index >> SUB_BUCKET_BITS) - 1;
+    const uint64_t subBucket = index - (size_t(shift) << SUB_BUCKET_BITS);
+    return subBucket << shift;
+  }
+
+  static uint64_t bucketUpper(size_t index)
+  {
+    return (index + 1 < NUM_BUCKETS) ? bucketLower(index + 1) - 1
+                                     : std::numeric_limits<uint64_t>::max();
+  }
+
+  std::vector<uint64_t> m_counts;
+  uint64_t m_count = 0;
+  double m_sum     = 0.0;
+  uint64_t m_min   = std::numeric_limits<uint64_t>::max();
+  uint64_t m_max   = 0;
+};
+
+//------------------------------------------------------------------------------
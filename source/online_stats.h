@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+//------------------------------------------------------------------------------
+// Online (streaming) moments up to the 4th, in constant memory
+//
+// Values are added a cache sized chunk at a time: the chunk's central moments
+// are computed with a two pass over the (hot) chunk and then combined into the
+// running totals with the pairwise update formulas. This is as accurate as
+// Welford's per value update, but vectorizes and merges across threads.
+//
+// Sources:
+// Welford, Note on a method for calculating corrected sums of squares (1962)
+// Pebay, Formulas for Robust, One-Pass Parallel Computation of Covariances and
+// Arbitrary-Order Statistical Moments (Sandia report SAND2008-6212)
+//------------------------------------------------------------------------------
+struct OnlineMoments
+{
+  uint64_t count = 0;
+  double mean    = 0.0;
+  double m2      = 0.0;    // sum of (x - mean)^2
+  double m3      = 0.0;    // sum of (x - mean)^3
+  double m4      = 0.0;    // sum of (x - mean)^4
+  float min      = std::numeric_limits<float>::max();
+  float max      = std::numeric_limits<float>::lowest();
+
+  //----------------------------------------------------------------------------
+  void add(const float* values, size_t numValues)
+  {
+    if (numValues == 0)
+    {
+      return;
+    }
+
+    OnlineMoments chunk;
+    chunk.count = numValues;
+
+    double sum  = 0.0;
+    float lower = values[0];
+    float upper = values[0];
+    for (size_t i = 0; i < numValues; ++i)
+    {
+      sum += values[i];
+      lower = std::min(lower, values[i]);
+      upper = std::max(upper, values[i]);
+    }
+    chunk.mean = sum / double(numValues);
+    chunk.min  = lower;
+    chunk.max  = upper;
+
+    for (size_t i = 0; i < numValues; ++i)
+    {
+      const double d  = double(values[i]) - chunk.mean;
+      const double d2 = d * d;
+      chunk.m2 += d2;
+      chunk.m3 += d2 * d;
+      chunk.m4 += d2 * d2;
+    }
+
+    merge(chunk);
+  }
+
+  //----------------------------------------------------------------------------
+  void merge(const OnlineMoments& other)
+  {
+    if (other.count == 0)
+    {
+      return;
+    }
+    if (count == 0)
+    {
+      *this = other;
+      return;
+    }
+
+    const double nA    = double(count);
+    const double nB    = double(other.count);
+    const double n     = nA + nB;
+    const double delta = other.mean - mean;
+    const double d2    = delta * delta;
+
+    const double nSq   = (nA * nA) - (nA * nB) + (nB * nB);
+    const double newM4 = m4 + other.m4
+                         + (d2 * d2 * nA * nB * nSq) / (n * n * n)
+                         + (6.0 * d2 * ((nA * nA * other.m2) + (nB * nB * m2)))
+                             / (n * n)
+                         + (4.0 * delta * ((nA * other.m3) - (nB * m3))) / n;
+    const double newM3 = m3 + other.m3
+                         + (d2 * delta * nA * nB * (nA - nB)) / (n * n)
+                         + (3.0 * delta * ((nA * other.m2) - (nB * m2))) / n;
+    const double newM2 = m2 + other.m2 + (d2 * nA * nB) / n;
+
+    mean += delta * (nB / n);
+    m2    = newM2;
+    m3    = newM3;
+    m4    = newM4;
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+
+  //----------------------------------------------------------------------------
+  double variance() const
+  {
+    return (count > 1) ? m2 / double(count - 1) : 0.0;
+  }
+
+  double skewness() const
+  {
+    return (m2 > 0.0) ? std::sqrt(double(count)) * m3 / std::pow(m2, 1.5)
+                      : 0.0;
+  }
+
+  double excessKurtosis() const
+  {
+    return (m2 > 0.0) ? (double(count) * m4) / (m2 * m2) - 3.0 : 0.0;
+  }
+};
+
+//------------------------------------------------------------------------------
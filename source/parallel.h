@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+//------------------------------------------------------------------------------
+// Small threading helpers shared by the executables
+//------------------------------------------------------------------------------
+inline unsigned
+defaultThreadCount()
+{
+  const unsigned numThreads = std::thread::hardware_concurrency();
+  return (numThreads == 0) ? 1 : numThreads;
+}
+
+//------------------------------------------------------------------------------
+// Runs func(taskIndex, threadIndex) for every task in [0 -> numTasks)
+// Tasks are handed out dynamically, so uneven task costs are balanced.
+//------------------------------------------------------------------------------
+template <typename Func>
+void
+parallelFor(size_t numTasks, unsigned numThreads, Func func)
+{
+  numThreads = std::max(1u, numThreads);
+  if (numThreads == 1 || numTasks <= 1)
+  {
+    for (size_t task = 0; task < numTasks; ++task)
+    {
+      func(task, 0u);
+    }
+    return;
+  }
+
+  std::atomic<size_t> nextTask(0);
+  auto worker = [&](unsigned threadIdx) {
+    for (size_t task = nextTask++; task < numTasks; task = nextTask++)
+    {
+      func(task, threadIdx);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (unsigned t = 1; t < numThreads; ++t)
+  {
+    threads.emplace_back(worker, t);
+  }
+  worker(0);
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Produces chunks in parallel and consumes them strictly in order.
+//
+// produce(chunkIndex, slotIndex) runs on worker threads and fills slot storage.
+// consume(chunkIndex, slotIndex) runs on the calling thread in chunk order.
+// consume() returns false to stop early (e.g. the output was closed).
+//
+// numSlots bounds the amount of chunk storage in flight, so memory use is
+// constant regardless of numChunks. Storage is owned by the caller and indexed
+// by slotIndex (which is always < numSlots).
+//
+// slotReuseDelay holds a slot back until that many further chunks have been
+// consumed, for outputs that still reference memory after consume() returns
+// (e.g. vmsplice into a pipe).
+//------------------------------------------------------------------------------
+template <typename ProduceFunc, typename ConsumeFunc>
+bool
+orderedPipeline(
+  size_t numChunks,
+  unsigned numThreads,
+  size_t numSlots,
+  ProduceFunc produce,
+  ConsumeFunc consume,
+  size_t slotReuseDelay = 0)
+{
+  numThreads = std::max(1u, numThreads);
+  numSlots   = std::max<size_t>(slotReuseDelay + 1, numSlots);
+
+  std::mutex mutex;
+  std::condition_variable slotFreed;
+  std::condition_variable chunkReady;
+  std::vector<bool> ready(numSlots, false);
+  size_t nextChunk   = 0;    // next chunk for a worker to claim
+  size_t numConsumed = 0;    // chunks fully consumed by the caller
+  bool stop          = false;
+
+  auto worker = [&]() {
+    for (;;)
+    {
+      size_t chunk = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stop || nextChunk >= numChunks)
+        {
+          return;
+        }
+        chunk = nextChunk++;
+
+        // Wait until the previous occupant of the slot has been consumed
+        slotFreed.wait(lock, [&]() {
+          return stop || chunk + slotReuseDelay < numConsumed + numSlots;
+        });
+        if (stop)
+        {
+          return;
+        }
+      }
+
+      produce(chunk, chunk % numSlots);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready[chunk % numSlots] = true;
+      }
+      chunkReady.notify_one();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads);
+  for (unsigned t = 0; t < numThreads; ++t)
+  {
+    threads.emplace_back(worker);
+  }
+
+  bool completed = true;
+  for (size_t chunk = 0; chunk < numChunks; ++chunk)
+  {
+    const size_t slot = chunk % numSlots;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunkReady.wait(lock, [&]() { return ready[slot]; });
+    }
+
+    const bool keepGoing = consume(chunk, slot);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ready[slot] = false;
+      ++numConsumed;
+      if (!keepGoing)
+      {
+        stop = true;
+      }
+    }
+    slotFreed.notify_all();
+
+    if (!keepGoing)
+    {
+      completed = false;
+      break;
+    }
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  return completed;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,208 @@
+#pragma once
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Hardware performance counters via Linux perf_event_open
+//
+// The events are opened as one group on the calling thread (user space only),
+// so they are scheduled onto the PMU together and read in a single syscall.
+// Events the CPU or hypervisor doesn't support are skipped; if none can be
+// opened (no PMU in a VM, perf_event_paranoid, seccomp in containers, or not
+// Linux) isAvailable() is false and why() says why.
+//
+// Counts are scaled up if the kernel had to multiplex the group.
+//
+// Sources:
+// perf_event_open(2) man page
+//------------------------------------------------------------------------------
+struct PerfEventSpec
+{
+  std::string name;
+  uint32_t type;
+  uint64_t config;
+};
+
+//------------------------------------------------------------------------------
+class PerfCounters
+{
+public:
+  //----------------------------------------------------------------------------
+  // Cycles, instructions, branches and branch misses, L1D and LLC read misses
+  //----------------------------------------------------------------------------
+  static std::vector<PerfEventSpec> defaultEvents()
+  {
+#if defined(__linux__)
+    auto cacheMiss = [](uint64_t cache) {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+             | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    return {
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+      {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"l1d_misses", PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+      {"llc_misses", PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL)},
+    };
+#else
+    return {};
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Model specific raw events, e.g. on Skylake the uops dispatched to port 0
+  // and port 5 are "port0=0x01a1,port5=0x20a1" (umask << 8 | event)
+  //----------------------------------------------------------------------------
+  static bool parseRawEvents(
+    const std::vector<std::string>& list, std::vector<PerfEventSpec>& events)
+  {
+    for (auto& item : list)
+    {
+      const size_t equals = item.find('=');
+      if (equals == std::string::npos || equals == 0)
+      {
+        return false;
+      }
+
+      const std::string value = item.substr(equals + 1);
+      char* end               = nullptr;
+      const uint64_t config   = std::strtoull(value.c_str(), &end, 0);
+      if (value.empty() || *end != '\0')
+      {
+        return false;
+      }
+#if defined(__linux__)
+      events.push_back({item.substr(0, equals), PERF_TYPE_RAW, config});
+#else
+      (void)config;
+#endif
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  explicit PerfCounters(const std::vector<PerfEventSpec>& events)
+  {
+#if defined(__linux__)
+    std::string firstError;
+    for (auto& event : events)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = event.type;
+      attr.config         = event.config;
+      attr.disabled       = (m_leader < 0) ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                         | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      const int fd = int(syscall(
+        __NR_perf_event_open, &attr, 0 /* this thread */, -1, m_leader, 0));
+      if (fd < 0)
+      {
+        if (firstError.empty())
+        {
+          firstError = event.name + ": " + std::strerror(errno);
+        }
+        continue;
+      }
+
+      m_leader = (m_leader < 0) ? fd : m_leader;
+      m_fds.push_back(fd);
+      m_names.push_back(event.name);
+    }
+
+    if (m_fds.empty())
+    {
+      m_reason = events.empty() ? "no events requested"
+                                : "perf_event_open failed (" + firstError + ")";
+    }
+#else
+    (void)events;
+    m_reason = "perf_event_open is only available on Linux";
+#endif
+  }
+
+  ~PerfCounters()
+  {
+#if defined(__linux__)
+    for (int fd : m_fds)
+    {
+      close(fd);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool isAvailable() const { return !m_fds.empty(); }
+  const std::string& why() const { return m_reason; }
+
+  // Names of the events that opened, in the order of stop()'s counts
+  const std::vector<std::string>& names() const { return m_names; }
+
+  //----------------------------------------------------------------------------
+  void start()
+  {
+#if defined(__linux__)
+    if (isAvailable())
+    {
+      ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Stops counting, returning one count per names() entry (empty on failure)
+  //----------------------------------------------------------------------------
+  std::vector<double> stop()
+  {
+    std::vector<double> counts;
+#if defined(__linux__)
+    if (!isAvailable())
+    {
+      return counts;
+    }
+    ioctl(m_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // {nr, time_enabled, time_running, values[nr]}
+    std::vector<uint64_t> data(3 + m_fds.size());
+    const ssize_t size = ssize_t(data.size() * sizeof(uint64_t));
+    if (read(m_leader, data.data(), size) != size || data[2] == 0)
+    {
+      return counts;
+    }
+
+    const double scale = double(data[1]) / double(data[2]);
+    for (size_t i = 0; i < m_fds.size(); ++i)
+    {
+      counts.push_back(double(data[3 + i]) * scale);
+    }
+#endif
+    return counts;
+  }
+
+private:
+  int m_leader = -1;
+  std::vector<int> m_fds;
+  std::vector<std::string> m_names;
+  std::string m_reason;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+//------------------------------------------------------------------------------
+// Minimal streaming PNG writer for 8 and 16-bit images with 1 -> 4 channels
+//
+// stb_image_write only writes 8-bit PNGs and spends most of its time trying to
+// compress, which is wasted on noise. This writer stores the image data in
+// uncompressed deflate blocks instead, so writing is close to memcpy speed and
+// memory use is a single row.
+//
+// Sources:
+// PNG specification: https://www.w3.org/TR/png/
+// Deflate stored blocks: RFC 1951 section 3.2.4, zlib wrapper: RFC 1950
+//------------------------------------------------------------------------------
+class PngWriter
+{
+public:
+  //----------------------------------------------------------------------------
+  // 16-bit samples are given in native (little endian) order.
+  // rowStride is in bytes.
+  //----------------------------------------------------------------------------
+  static bool write(
+    const char* fileName,
+    uint32_t width,
+    uint32_t height,
+    uint32_t numChannels,
+    uint32_t bitDepth,
+    const uint8_t* pixels,
+    size_t rowStride)
+  {
+    // Grey, grey + alpha, RGB, RGBA
+    static const uint8_t COLOUR_TYPES[] = {0, 4, 2, 6};
+    if (
+      numChannels < 1 || numChannels > 4 || (bitDepth != 8 && bitDepth != 16)
+      || width == 0 || height == 0)
+    {
+      return false;
+    }
+
+    FILE* file = std::fopen(fileName, "wb");
+    if (!file)
+    {
+      return false;
+    }
+
+    PngWriter writer(file);
+    static const uint8_t SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    writer.writeBytes(SIGNATURE, sizeof(SIGNATURE));
+
+    uint8_t header[13];
+    storeBigEndian(header + 0, width);
+    storeBigEndian(header + 4, height);
+    header[8]  = uint8_t(bitDepth);
+    header[9]  = COLOUR_TYPES[numChannels - 1];
+    header[10] = 0;    // deflate
+    header[11] = 0;    // adaptive filtering
+    header[12] = 0;    // no interlace
+    writer.writeChunk("IHDR", header, sizeof(header));
+
+    // Each scanline is a filter byte (0 = none) followed by the samples
+    const size_t rowBytes = size_t(width) * numChannels * (bitDepth / 8);
+    std::vector<uint8_t> row(rowBytes + 1);
+    static const uint8_t ZLIB_HEADER[2] = {0x78, 0x01};
+    writer.addImageData(ZLIB_HEADER, sizeof(ZLIB_HEADER), false);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+      const uint8_t* src = pixels + (size_t(y) * rowStride);
+      row[0]             = 0;
+      if (bitDepth == 16)
+      {
+        for (size_t i = 0; i < rowBytes; i += 2)
+        {
+          row[1 + i] = src[i + 1];
+          row[2 + i] = src[i];
+        }
+      }
+      else
+      {
+        std::copy(src, src + rowBytes, row.begin() + 1);
+      }
+      writer.addImageData(row.data(), row.size(), true);
+    }
+    writer.finishImageData();
+    writer.writeChunk("IEND", nullptr, 0);
+
+    const bool success = !std::ferror(file);
+    return (std::fclose(file) == 0) && success;
+  }
+
+private:
+  static const size_t MAX_STORED_BLOCK = 65535;
+
+  explicit PngWriter(FILE* file)
+      : m_file(file)
+  {
+    m_block.reserve(MAX_STORED_BLOCK);
+  }
+
+  //----------------------------------------------------------------------------
+  static void storeBigEndian(uint8_t* out, uint32_t value)
+  {
+    out[0] = uint8_t(value >> 24);
+    out[1] = uint8_t(value >> 16);
+    out[2] = uint8_t(value >> 8);
+    out[3] = uint8_t(value);
+  }
+
+  //----------------------------------------------------------------------------
+  // CRC-32, 8 bytes at a time with slicing-by-8 tables
+  //----------------------------------------------------------------------------
+  static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+  {
+    static const std::vector<uint32_t> TABLES = []() {
+      std::vector<uint32_t> tables(8 * 256);
+      for (uint32_t n = 0; n < 256; ++n)
+      {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+        {
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        tables[n] = c;
+      }
+      for (uint32_t n = 0; n < 256; ++n)
+      {
+        for (size_t slice = 1; slice < 8; ++slice)
+        {
+          const uint32_t prev = tables[((slice - 1) * 256) + n];
+          tables[(slice * 256) + n] = tables[prev & 0xFF] ^ (prev >> 8);
+        }
+      }
+      return tables;
+    }();
+    const uint32_t* t = TABLES.data();
+
+    for (; size >= 8; data += 8, size -= 8)
+    {
+      const uint32_t lo = crc
+                          ^ (uint32_t(data[0]) | (uint32_t(data[1]) << 8)
+                             | (uint32_t(data[2]) << 16)
+                             | (uint32_t(data[3]) << 24));
+      crc = t[(7 * 256) + (lo & 0xFF)] ^ t[(6 * 256) + ((lo >> 8) & 0xFF)]
+            ^ t[(5 * 256) + ((lo >> 16) & 0xFF)] ^ t[(4 * 256) + (lo >> 24)]
+            ^ t[(3 * 256) + data[4]] ^ t[(2 * 256) + data[5]]
+            ^ t[(1 * 256) + data[6]] ^ t[data[7]];
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+      crc = t[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+  }
+
+  //----------------------------------------------------------------------------
+  void writeBytes(const uint8_t* data, size_t size)
+  {
+    if (size > 0)
+    {
+      std::fwrite(data, 1, size, m_file);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void writeChunk(const char* type, const uint8_t* data, size_t size)
+  {
+    uint8_t length[4];
+    storeBigEndian(length, uint32_t(size));
+    writeBytes(length, 4);
+
+    const uint8_t* typeBytes = reinterpret_cast<const uint8_t*>(type);
+    writeBytes(typeBytes, 4);
+    writeBytes(data, size);
+
+    uint32_t crc = updateCrc(0xFFFFFFFFu, typeBytes, 4);
+    crc          = updateCrc(crc, data, size) ^ 0xFFFFFFFFu;
+    uint8_t crcBytes[4];
+    storeBigEndian(crcBytes, crc);
+    writeBytes(crcBytes, 4);
+  }
+
+  //----------------------------------------------------------------------------
+  // Appends to the zlib stream, which is emitted as one IDAT chunk per stored
+  // deflate block. Only the deflate payload counts towards the Adler-32.
+  //----------------------------------------------------------------------------
+  void addImageData(const uint8_t* data, size_t size, bool isPayload)
+  {
+    if (!isPayload)
+    {
+      m_prefix.insert(m_prefix.end(), data, data + size);
+      return;
+    }
+
+    while (size > 0)
+    {
+      const size_t count = std::min(size, MAX_STORED_BLOCK - m_block.size());
+      m_block.insert(m_block.end(), data, data + count);
+      updateAdler(data, count);
+      data += count;
+      size -= count;
+      if (m_block.size() == MAX_STORED_BLOCK)
+      {
+        flushBlock(false);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void finishImageData()
+  {
+    flushBlock(true);
+    uint8_t adler[4];
+    storeBigEndian(adler, (m_adlerB << 16) | m_adlerA);
+    writeChunk("IDAT", adler, 4);
+  }
+
+  //----------------------------------------------------------------------------
+  void flushBlock(bool isFinal)
+  {
+    const uint16_t length = uint16_t(m_block.size());
+    std::vector<uint8_t>& chunk = m_prefix;
+    chunk.push_back(isFinal ? 1 : 0);    // BFINAL, BTYPE = stored
+    chunk.push_back(uint8_t(length));
+    chunk.push_back(uint8_t(length >> 8));
+    chunk.push_back(uint8_t(~length));
+    chunk.push_back(uint8_t(uint16_t(~length) >> 8));
+    chunk.insert(chunk.end(), m_block.begin(), m_block.end());
+    writeChunk("IDAT", chunk.data(), chunk.size());
+
+    chunk.clear();
+    m_block.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  void updateAdler(const uint8_t* data, size_t size)
+  {
+    static const uint32_t MOD_ADLER = 65521;
+    static const size_t NMAX        = 5552;    // largest run without overflow
+    while (size > 0)
+    {
+      const size_t count = std::min(size, NMAX);
+      for (size_t i = 0; i < count; ++i)
+      {
+        m_adlerA += data[i];
+        m_adlerB += m_adlerA;
+      }
+      m_adlerA %= MOD_ADLER;
+      m_adlerB %= MOD_ADLER;
+      data += count;
+      size -= count;
+    }
+  }
+
+  FILE* m_file;
+  std::vector<uint8_t> m_prefix;    // zlib header / block header bytes
+  std::vector<uint8_t> m_block;
+  uint32_t m_adlerA = 1;
+  uint32_t m_adlerB = 0;
+};
+
+//------------------------------------------------------------------------------
@@ -16,6 +16,12 @@ struct RandMT
   {
   }
 
+  explicit RandMT(uint32_t seed)
+      : m_engine(seed)
+      , m_distr(std::uniform_real_distribution<float>(0.0, 1.0f))
+  {
+  }
+
   float generate() { return m_distr(m_engine); }
 };
 
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <cstdint>
+//------------------------------------------------------------------------------
+// PCG32 (XSH-RR 64/32) and PCG64 (XSL-RR 128/64), several streams per call
+//
+// Every stream is the reference generator seeded with pcg_srandom(initstate,
+// stream), so stream i uses increment 2i + 1.
+//
+// PCG32 steps its 8 streams together. With AVX2 the 64-bit LCG multiply is
+// emulated in SIMD lanes and the per-lane random rotation is a variable shift
+// (vpsrlvq) of the output doubled up; SSE2 has no variable shift per lane, so
+// it steps the streams as scalars. PCG64's 128-bit LCG has no SIMD form at
+// all: its 4 streams are independent scalar chains.
+//
+// Sources:
+// O'Neill, PCG: A Family of Simple Fast Space-Efficient Statistically Good
+// Algorithms for Random Number Generation (2014)
+// https://www.pcg-random.org/
+//------------------------------------------------------------------------------
+struct RandPcg32
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_STREAMS   = 8;
+
+  static const uint64_t MULTIPLIER = 6364136223846793005ull;
+
+  RandPcg32()
+      : RandPcg32(0)
+  {
+  }
+
+  explicit RandPcg32(uint64_t seed)
+  {
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      seedStream(
+        m_state[stream], m_increment[stream], splitMix64(seed), stream);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // pcg32_srandom_r
+  //----------------------------------------------------------------------------
+  static void seedStream(
+    uint64_t& state, uint64_t& increment, uint64_t initState, uint64_t stream)
+  {
+    state     = 0;
+    increment = (stream << 1) | 1;
+    next(state, increment);
+    state += initState;
+    next(state, increment);
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar reference step, returning the next 32-bit output
+  //----------------------------------------------------------------------------
+  static uint32_t next(uint64_t& state, uint64_t increment)
+  {
+    const uint64_t old    = state;
+    state                 = (old * MULTIPLIER) + increment;
+    const uint32_t value  = uint32_t(((old >> 18) ^ old) >> 27);
+    const uint32_t rotate = uint32_t(old >> 59);
+    return (value >> rotate) | (value << ((32 - rotate) & 31));
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+#if defined(__AVX2__)
+    const __m256i MULT = _mm256_set1_epi64x((long long)MULTIPLIER);
+    const __m256i LOW  = _mm256_set1_epi64x(0xFFFFFFFF);
+    __m256i rotated[2];
+    for (size_t half = 0; half < 2; ++half)
+    {
+      const __m256i old       = Simd::load(&m_state[half * 4]);
+      const __m256i increment = Simd::load(&m_increment[half * 4]);
+      Simd::store(
+        &m_state[half * 4], Simd::add64(Simd::mulLo64(old, MULT), increment));
+
+      const __m256i shifted
+        = _mm256_xor_si256(_mm256_srli_epi64(old, 18), old);
+      const __m256i value
+        = _mm256_and_si256(_mm256_srli_epi64(shifted, 27), LOW);
+      const __m256i doubled
+        = _mm256_or_si256(value, _mm256_slli_epi64(value, 32));
+      rotated[half]
+        = _mm256_srlv_epi64(doubled, _mm256_srli_epi64(old, 59));
+    }
+
+    // Low halves of the 64-bit lanes, streams 0 -> 7 in order
+    const __m256i packed = _mm256_blend_epi32(
+      _mm256_shuffle_epi32(rotated[0], _MM_SHUFFLE(2, 0, 2, 0)),
+      _mm256_shuffle_epi32(rotated[1], _MM_SHUFFLE(2, 0, 2, 0)),
+      0xCC);
+    Simd::storeUnitFloats(
+      result, _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+#else
+    uint32_t outputs[NUM_STREAMS];
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      outputs[stream] = next(m_state[stream], m_increment[stream]);
+    }
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      const SimdInt bits = Simd::load(&outputs[reg * SIMD_LANES32]);
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), bits);
+    }
+#endif
+  }
+
+private:
+  alignas(32) uint64_t m_state[NUM_STREAMS];
+  alignas(32) uint64_t m_increment[NUM_STREAMS];
+};
+
+//------------------------------------------------------------------------------
+struct RandPcg64
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_STREAMS   = 4;
+
+  struct Uint128
+  {
+    uint64_t lo;
+    uint64_t hi;
+  };
+
+  RandPcg64()
+      : RandPcg64(0)
+  {
+  }
+
+  explicit RandPcg64(uint64_t seed)
+  {
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      const Uint128 initState = {splitMix64(seed), splitMix64(seed)};
+      seedStream(m_state[stream], m_increment[stream], initState, stream);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // pcg_setseq_128_srandom_r (stream is the low 64 bits of initseq)
+  //----------------------------------------------------------------------------
+  static void seedStream(
+    Uint128& state, Uint128& increment, Uint128 initState, uint64_t stream)
+  {
+    state     = {0, 0};
+    increment = {(stream << 1) | 1, stream >> 63};
+    step(state, increment);
+    state = add(state, initState);
+    step(state, increment);
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar reference step, returning the next 64-bit output
+  //----------------------------------------------------------------------------
+  static uint64_t next(Uint128& state, const Uint128& increment)
+  {
+    step(state, increment);
+    const unsigned rotate = unsigned(state.hi >> 58);
+    const uint64_t value  = state.hi ^ state.lo;
+    return (value >> rotate) | (value << ((64 - rotate) & 63));
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    uint64_t outputs[NUM_STREAMS];
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      outputs[stream] = next(m_state[stream], m_increment[stream]);
+    }
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      const SimdInt bits = Simd::load(&outputs[reg * SIMD_LANES64]);
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), bits);
+    }
+  }
+
+private:
+  static Uint128 add(const Uint128& a, const Uint128& b)
+  {
+    const uint64_t lo = a.lo + b.lo;
+    return {lo, a.hi + b.hi + ((lo < a.lo) ? 1 : 0)};
+  }
+
+  static void step(Uint128& state, const Uint128& increment)
+  {
+    static const Uint128 MULTIPLIER
+      = {0x4385DF649FCCF645ull, 0x2360ED051FC65DA4ull};
+    uint64_t hi;
+    const uint64_t lo = mulHiLo64(state.lo, MULTIPLIER.lo, hi);
+    hi += (state.lo * MULTIPLIER.hi) + (state.hi * MULTIPLIER.lo);
+    state = add({lo, hi}, increment);
+  }
+
+  Uint128 m_state[NUM_STREAMS];
+  Uint128 m_increment[NUM_STREAMS];
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <cstdint>
+//------------------------------------------------------------------------------
+// Philox4x32-10 counter-based generator, two counters per call
+//
+// Each 128-bit counter is kept whole in one 128-bit lane, as 4 x 32-bit words
+// {c0, c1, c2, c3}. The round's two 32x32 -> 64 bit products M0*c0 and M1*c2
+// are then exactly the even lane multiply (pmuludq), and the rest of the round
+// is a shuffle and two xors. With AVX2 both counters of a call share one
+// register.
+//
+// The key is the seed and the counter is the call number, so discard() is
+// O(1) and any block can be generated in any order.
+//
+// Sources:
+// Salmon, Moraes, Dror & Shaw, Parallel Random Numbers: As Easy as 1, 2, 3
+// (SC11), and the Random123 library
+//------------------------------------------------------------------------------
+struct RandPhilox4x32
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_ROUNDS    = 10;
+
+  static const uint32_t M0 = 0xD2511F53;
+  static const uint32_t M1 = 0xCD9E8D57;
+  static const uint32_t W0 = 0x9E3779B9;    // key schedule (Weyl) constants
+  static const uint32_t W1 = 0xBB67AE85;
+
+  RandPhilox4x32()
+      : RandPhilox4x32(0)
+  {
+  }
+
+  explicit RandPhilox4x32(uint64_t seed)
+  {
+    const uint32_t k0 = uint32_t(seed);
+    const uint32_t k1 = uint32_t(seed >> 32);
+    for (size_t round = 0; round < NUM_ROUNDS; ++round)
+    {
+      const uint32_t roundK0 = k0 + uint32_t(round) * W0;
+      const uint32_t roundK1 = k1 + uint32_t(round) * W1;
+      const uint32_t key[8]  = {roundK0, 0, roundK1, 0, roundK0, 0, roundK1, 0};
+      m_roundKeys[round]     = Simd::load(key);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate()
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numCalls) { m_counter += numCalls * 2; }
+
+  //----------------------------------------------------------------------------
+  // Raw 32-bit output: counter n's 4 words, then counter n + 1's
+  //----------------------------------------------------------------------------
+  void generate(uint32_t result[NUM_GENERATED])
+  {
+    const uint32_t counters[8] = {uint32_t(m_counter),
+                                  uint32_t(m_counter >> 32),
+                                  0,
+                                  0,
+                                  uint32_t(m_counter + 1),
+                                  uint32_t((m_counter + 1) >> 32),
+                                  0,
+                                  0};
+    m_counter += 2;
+
+    static const uint32_t MULTIPLIERS[8] = {M0, 0, M1, 0, M0, 0, M1, 0};
+    static const uint32_t EVEN_WORDS[8]
+      = {0xFFFFFFFF, 0, 0xFFFFFFFF, 0, 0xFFFFFFFF, 0, 0xFFFFFFFF, 0};
+    const SimdInt multipliers = Simd::load(MULTIPLIERS);
+    const SimdInt evenWords   = Simd::load(EVEN_WORDS);
+
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      SimdInt counter = Simd::load(&counters[reg * SIMD_LANES32]);
+      for (size_t round = 0; round < NUM_ROUNDS; ++round)
+      {
+        // {lo0, hi0, lo1, hi1} -> {hi1, lo1, hi0, lo0}
+        const SimdInt products = Simd::mulEven32(counter, multipliers);
+        const SimdInt swapped
+          = Simd::shuffle32<_MM_SHUFFLE(0, 1, 2, 3)>(products);
+        // {c1 ^ k0, 0, c3 ^ k1, 0}
+        const SimdInt odd = Simd::and_(
+          Simd::shuffle32<_MM_SHUFFLE(2, 3, 0, 1)>(counter), evenWords);
+        counter = Simd::xor_(swapped, Simd::xor_(odd, m_roundKeys[round]));
+      }
+      Simd::store(&result[reg * SIMD_LANES32], counter);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    alignas(32) uint32_t bits[NUM_GENERATED];
+    generate(bits);
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      Simd::storeUnitFloats(
+        result + (reg * SIMD_LANES32), Simd::load(&bits[reg * SIMD_LANES32]));
+    }
+  }
+
+private:
+  SimdInt m_roundKeys[NUM_ROUNDS];
+  uint64_t m_counter = 0;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,489 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+//------------------------------------------------------------------------------
+// Polynomials over GF(2), for the SFMT jump
+// The coefficient of x^i is bit i of words.
+//------------------------------------------------------------------------------
+struct Gf2Polynomial
+{
+  std::vector<uint64_t> words;
+
+  bool coefficient(size_t i) const
+  {
+    return ((i / 64) < words.size()) && ((words[i / 64] >> (i % 64)) & 1);
+  }
+
+  void flip(size_t i)
+  {
+    if ((i / 64) >= words.size())
+    {
+      words.resize((i / 64) + 1, 0);
+    }
+    words[i / 64] ^= uint64_t(1) << (i % 64);
+  }
+
+  // -1 for the zero polynomial
+  int degree() const
+  {
+    for (size_t i = words.size(); i-- > 0;)
+    {
+      if (words[i] != 0)
+      {
+        int bit = 63;
+        while (((words[i] >> bit) & 1) == 0)
+        {
+          --bit;
+        }
+        return int(i * 64) + bit;
+      }
+    }
+    return -1;
+  }
+
+  //----------------------------------------------------------------------------
+  // this += other * x^shift
+  //----------------------------------------------------------------------------
+  void addShifted(const Gf2Polynomial& other, size_t shift)
+  {
+    const size_t wordShift  = shift / 64;
+    const unsigned bitShift = unsigned(shift % 64);
+    words.resize(std::max(words.size(), other.words.size() + wordShift + 1), 0);
+    for (size_t i = 0; i < other.words.size(); ++i)
+    {
+      words[i + wordShift] ^= other.words[i] << bitShift;
+      if (bitShift != 0)
+      {
+        words[i + wordShift + 1] ^= other.words[i] >> (64 - bitShift);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Squaring over GF(2) just spreads the bits: (sum a_i x^i)^2 = sum a_i x^2i
+  //----------------------------------------------------------------------------
+  Gf2Polynomial squared() const
+  {
+    Gf2Polynomial result;
+    result.words.resize(words.size() * 2, 0);
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+      for (unsigned bit = 0; bit < 64; ++bit)
+      {
+        const uint64_t b = (words[i] >> bit) & 1;
+        result.words[(2 * i) + (bit / 32)] |= b << ((2 * bit) % 64);
+      }
+    }
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  // this = this mod modulus
+  //----------------------------------------------------------------------------
+  void reduce(const Gf2Polynomial& modulus, int modulusDegree)
+  {
+    for (int i = degree(); i >= modulusDegree; --i)
+    {
+      if (coefficient(size_t(i)))
+      {
+        addShifted(modulus, size_t(i - modulusDegree));
+      }
+    }
+    words.resize((size_t(modulusDegree) / 64) + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  // x^exponent mod modulus, by squaring
+  //----------------------------------------------------------------------------
+  static Gf2Polynomial
+  xPowerMod(uint64_t exponent, const Gf2Polynomial& modulus)
+  {
+    const int modulusDegree = modulus.degree();
+    Gf2Polynomial result;
+    result.flip(0);
+    for (int bit = 63; bit >= 0; --bit)
+    {
+      result = result.squared();
+      if ((exponent >> bit) & 1)
+      {
+        Gf2Polynomial shifted;
+        shifted.addShifted(result, 1);
+        result = shifted;
+      }
+      result.reduce(modulus, modulusDegree);
+    }
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  // Minimal polynomial of a linearly recurrent bit sequence (Berlekamp-Massey).
+  // The sequence must be at least twice the polynomial's degree long.
+  //----------------------------------------------------------------------------
+  static Gf2Polynomial minimalPolynomial(const std::vector<uint8_t>& sequence)
+  {
+    // Bits in reverse order, so the window sequence[n - L] -> sequence[n] is
+    // contiguous, lowest bit last, for the discrepancy
+    const size_t length = sequence.size();
+    std::vector<uint64_t> reversed((length / 64) + 3, 0);
+    for (size_t i = 0; i < length; ++i)
+    {
+      const size_t j = length - 1 - i;
+      reversed[j / 64] |= uint64_t(sequence[i] & 1) << (j % 64);
+    }
+    auto window = [&reversed](size_t pos) {
+      const size_t word  = pos / 64;
+      const unsigned bit = unsigned(pos % 64);
+      return (bit == 0) ? reversed[word]
+                        : (reversed[word] >> bit)
+                            | (reversed[word + 1] << (64 - bit));
+    };
+
+    Gf2Polynomial connection;    // C(x), with s[n] = sum c_i s[n - i]
+    Gf2Polynomial previous;
+    connection.flip(0);
+    previous.flip(0);
+    size_t numRecurrent = 0;    // L
+    size_t gap          = 1;
+    for (size_t n = 0; n < length; ++n)
+    {
+      const size_t origin = length - 1 - n;
+      uint64_t parity     = 0;
+      for (size_t i = 0; (i * 64) <= numRecurrent; ++i)
+      {
+        parity ^= connection.words[i] & window(origin + (i * 64));
+      }
+      for (int shift = 32; shift > 0; shift >>= 1)
+      {
+        parity ^= parity >> shift;
+      }
+      if ((parity & 1) == 0)
+      {
+        ++gap;
+      }
+      else if ((2 * numRecurrent) <= n)
+      {
+        const Gf2Polynomial before = connection;
+        connection.addShifted(previous, gap);
+        numRecurrent = n + 1 - numRecurrent;
+        previous     = before;
+        gap          = 1;
+      }
+      else
+      {
+        connection.addShifted(previous, gap);
+        ++gap;
+      }
+      connection.words.resize((numRecurrent / 64) + 1);
+    }
+
+    // The minimal polynomial is the reverse: x^L C(1/x)
+    Gf2Polynomial minimal;
+    for (size_t i = 0; i <= numRecurrent; ++i)
+    {
+      if (connection.coefficient(numRecurrent - i))
+      {
+        minimal.flip(i);
+      }
+    }
+    return minimal;
+  }
+};
+
+//------------------------------------------------------------------------------
+// SFMT19937, the SIMD-oriented Fast Mersenne Twister
+//
+// Its recursion works on 128-bit words, so the whole 19937-bit state block is
+// regenerated 128 bits per step in SSE2 registers, and then converted to
+// floats in bulk. Each step depends on the one before it (the d << SL1 term),
+// so AVX2 can't run two steps side by side; AVX2 builds widen only the float
+// conversion.
+//
+// generate() hands out 8 values at a time from the current block. fill()
+// converts straight from the state block, so bulk fills avoid any copy.
+//
+// jump() skips ahead with the jump polynomial: x^n reduced mod the
+// recursion's minimal polynomial, applied to the state by Horner's method.
+// The minimal polynomial is found from the engine's own output with
+// Berlekamp-Massey. A jump takes a fraction of a second, whatever its length,
+// so it's meant for spacing out parallel streams, not for skipping between
+// chunks.
+//
+// Sources:
+// Saito & Matsumoto, SIMD-oriented Fast Mersenne Twister: a 128-bit
+// Pseudorandom Number Generator (2008), and the SFMT library
+// http://www.math.sci.hiroshima-u.ac.jp/m-mat/MT/SFMT/
+// Haramoto, Matsumoto, Nishimura, Panneton & L'Ecuyer, Efficient Jump Ahead
+// for F2-Linear Random Number Generators (2008)
+//------------------------------------------------------------------------------
+struct RandSfmt
+{
+  static const size_t NUM_GENERATED = 8;
+
+  static const size_t MEXP = 19937;
+  static const size_t N    = (MEXP / 128) + 1;    // 128-bit words of state
+  static const size_t N32  = N * 4;
+
+  static const size_t POS1 = 122;
+  static const int SL1     = 18;
+  static const int SL2     = 1;    // bytes
+  static const int SR1     = 11;
+  static const int SR2     = 1;    // bytes
+
+  static constexpr uint32_t MASK[4]
+    = {0xDFFFFFEFU, 0xDDFECB7FU, 0xBFFAFFFFU, 0xBFFFFFF6U};
+  static constexpr uint32_t PARITY[4] = {0x00000001U, 0, 0, 0x13C9E684U};
+
+  RandSfmt()
+      : RandSfmt(5489)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // sfmt_init_gen_rand
+  //----------------------------------------------------------------------------
+  explicit RandSfmt(uint32_t seed)
+  {
+    m_state[0] = seed;
+    for (size_t i = 1; i < N32; ++i)
+    {
+      const uint32_t prev = m_state[i - 1];
+      m_state[i]          = (1812433253U * (prev ^ (prev >> 30))) + uint32_t(i);
+    }
+    certifyPeriod();
+  }
+
+  //----------------------------------------------------------------------------
+  // count must be a multiple of NUM_GENERATED
+  //----------------------------------------------------------------------------
+  void fill(float* out, size_t count)
+  {
+    assert((count % NUM_GENERATED) == 0);
+    while (count != 0)
+    {
+      size_t numValues;
+      const uint32_t* values = take(count, numValues);
+      for (size_t i = 0; i < numValues; i += SIMD_LANES32)
+      {
+        Simd::storeUnitFloats(out + i, Simd::load(&values[i]));
+      }
+      out += numValues;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Raw 32-bit output (sfmt_genrand_uint32 order)
+  //----------------------------------------------------------------------------
+  void fill(uint32_t* out, size_t count)
+  {
+    assert((count % NUM_GENERATED) == 0);
+    while (count != 0)
+    {
+      size_t numValues;
+      const uint32_t* values = take(count, numValues);
+      std::copy(values, values + numValues, out);
+      out += numValues;
+    }
+  }
+
+  void generate(float result[NUM_GENERATED]) { fill(result, NUM_GENERATED); }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate(), in O(log numCalls) state
+  // steps (see above)
+  //----------------------------------------------------------------------------
+  void jump(uint64_t numCalls)
+  {
+    // The state holds the block last generated, and m_index values of it have
+    // been used. Jump the block itself, then regenerate lazily from the index.
+    const uint64_t position  = m_index + (numCalls * NUM_GENERATED);
+    const uint64_t numBlocks = position / N32;
+    m_index                  = size_t(position % N32);
+    if (numBlocks == 0)
+    {
+      return;
+    }
+
+    const Gf2Polynomial minimal = Gf2Polynomial::minimalPolynomial(
+      outputBits(2 * (N * 128)));
+    const Gf2Polynomial jumpPolynomial
+      = Gf2Polynomial::xPowerMod(numBlocks * N, minimal);
+
+    // Horner: the jumped state is sum p_i T^i(state), for the step T
+    alignas(16) uint32_t work[N32] = {};
+    size_t start                   = 0;
+    for (int i = jumpPolynomial.degree(); i >= 0; --i)
+    {
+      step(work, start);
+      if (jumpPolynomial.coefficient(size_t(i)))
+      {
+        for (size_t word = 0; word < N; ++word)
+        {
+          const size_t dest = ((start + word) % N) * 4;
+          for (size_t lane = 0; lane < 4; ++lane)
+          {
+            work[dest + lane] ^= m_state[(word * 4) + lane];
+          }
+        }
+      }
+    }
+    for (size_t word = 0; word < N; ++word)
+    {
+      std::memcpy(
+        &m_state[word * 4],
+        &work[((start + word) % N) * 4],
+        4 * sizeof(uint32_t));
+    }
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  // sfmt_gen_rand_all: the next N 128-bit words
+  //----------------------------------------------------------------------------
+  void regenerate()
+  {
+    const __m128i mask = maskRegister();
+    __m128i r1         = load(m_state, N - 2);
+    __m128i r2         = load(m_state, N - 1);
+    size_t i           = 0;
+    for (; i < N - POS1; ++i)
+    {
+      const __m128i r
+        = recursion(load(m_state, i), load(m_state, i + POS1), r1, r2, mask);
+      store(m_state, i, r);
+      r1 = r2;
+      r2 = r;
+    }
+    for (; i < N; ++i)
+    {
+      const __m128i r = recursion(
+        load(m_state, i), load(m_state, i + POS1 - N), r1, r2, mask);
+      store(m_state, i, r);
+      r1 = r2;
+      r2 = r;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // do_recursion: a ^ (a << SL2 bytes) ^ ((b >> SR1) & MASK) ^ (c >> SR2 bytes)
+  // ^ (d << SL1)
+  //----------------------------------------------------------------------------
+  static __m128i
+  recursion(__m128i a, __m128i b, __m128i c, __m128i d, __m128i mask)
+  {
+    const __m128i y = _mm_and_si128(_mm_srli_epi32(b, SR1), mask);
+    const __m128i z = _mm_xor_si128(
+      _mm_xor_si128(a, _mm_slli_si128(a, SL2)),
+      _mm_xor_si128(_mm_srli_si128(c, SR2), _mm_slli_epi32(d, SL1)));
+    return _mm_xor_si128(z, y);
+  }
+
+  static __m128i maskRegister()
+  {
+    return _mm_setr_epi32(
+      int(MASK[0]), int(MASK[1]), int(MASK[2]), int(MASK[3]));
+  }
+
+  static __m128i load(const uint32_t* state, size_t word)
+  {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(&state[word * 4]));
+  }
+
+  static void store(uint32_t* state, size_t word, __m128i x)
+  {
+    _mm_store_si128(reinterpret_cast<__m128i*>(&state[word * 4]), x);
+  }
+
+  //----------------------------------------------------------------------------
+  // One 128-bit step of a state held as a ring starting at word start
+  //----------------------------------------------------------------------------
+  static void step(uint32_t* state, size_t& start)
+  {
+    const __m128i r = recursion(
+      load(state, start),
+      load(state, (start + POS1) % N),
+      load(state, (start + N - 2) % N),
+      load(state, (start + N - 1) % N),
+      maskRegister());
+    store(state, start, r);
+    start = (start + 1) % N;
+  }
+
+  //----------------------------------------------------------------------------
+  // The next min(count, rest of the block) values, regenerating the block
+  // when it's used up
+  //----------------------------------------------------------------------------
+  const uint32_t* take(size_t& count, size_t& numValues)
+  {
+    if (m_index == N32)
+    {
+      regenerate();
+      m_index = 0;
+    }
+    numValues              = std::min(count, N32 - m_index);
+    const uint32_t* values = &m_state[m_index];
+    m_index += numValues;
+    count -= numValues;
+    return values;
+  }
+
+  //----------------------------------------------------------------------------
+  // Bit 0 of each of the next numBits 128-bit words, from a copy of the state
+  //----------------------------------------------------------------------------
+  std::vector<uint8_t> outputBits(size_t numBits) const
+  {
+    RandSfmt copy(*this);
+    std::vector<uint8_t> bits(numBits);
+    for (size_t i = 0; i < numBits; ++i)
+    {
+      if ((i % N) == 0)
+      {
+        copy.regenerate();
+      }
+      bits[i] = uint8_t(copy.m_state[(i % N) * 4] & 1);
+    }
+    return bits;
+  }
+
+  //----------------------------------------------------------------------------
+  // period_certification: the state must have a component along the
+  // 19937-degree factor of the characteristic polynomial
+  //----------------------------------------------------------------------------
+  void certifyPeriod()
+  {
+    uint32_t inner = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+      inner ^= m_state[i] & PARITY[i];
+    }
+    for (int shift = 16; shift > 0; shift >>= 1)
+    {
+      inner ^= inner >> shift;
+    }
+    if ((inner & 1) == 1)
+    {
+      return;
+    }
+    for (size_t i = 0; i < 4; ++i)
+    {
+      for (uint32_t bit = 1; bit != 0; bit <<= 1)
+      {
+        if ((bit & PARITY[i]) != 0)
+        {
+          m_state[i] ^= bit;
+          return;
+        }
+      }
+    }
+  }
+
+  alignas(32) uint32_t m_state[N32];
+  size_t m_index = N32;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,237 @@
+#pragma once
+
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+//------------------------------------------------------------------------------
+// Integer vector helpers shared by the comparison generators (rand_*.h)
+//
+// SimdInt is a 256-bit register when built with AVX2 (RANDOCHA_AVX2), and a
+// 128-bit SSE2 register otherwise. The generators keep their lanes in 32 byte
+// blocks of SIMD_REGS_PER_BLOCK registers, so both builds lay the lanes out
+// identically in memory and produce the same numbers.
+//------------------------------------------------------------------------------
+#if defined(__AVX2__)
+using SimdInt = __m256i;
+#else
+using SimdInt = __m128i;
+#endif
+
+constexpr size_t SIMD_BYTES          = sizeof(SimdInt);
+constexpr size_t SIMD_LANES32        = SIMD_BYTES / sizeof(uint32_t);
+constexpr size_t SIMD_LANES64        = SIMD_BYTES / sizeof(uint64_t);
+constexpr size_t SIMD_REGS_PER_BLOCK = 32 / SIMD_BYTES;
+
+//------------------------------------------------------------------------------
+struct Simd
+{
+#if defined(__AVX2__)
+  static SimdInt load(const void* source)
+  {
+    return _mm256_loadu_si256(static_cast<const __m256i*>(source));
+  }
+  static void store(void* destination, SimdInt x)
+  {
+    _mm256_storeu_si256(static_cast<__m256i*>(destination), x);
+  }
+  static SimdInt set32(uint32_t x) { return _mm256_set1_epi32(int(x)); }
+  static SimdInt set64(uint64_t x) { return _mm256_set1_epi64x((long long)x); }
+  static SimdInt add32(SimdInt a, SimdInt b) { return _mm256_add_epi32(a, b); }
+  static SimdInt add64(SimdInt a, SimdInt b) { return _mm256_add_epi64(a, b); }
+  static SimdInt xor_(SimdInt a, SimdInt b) { return _mm256_xor_si256(a, b); }
+  static SimdInt or_(SimdInt a, SimdInt b) { return _mm256_or_si256(a, b); }
+  static SimdInt and_(SimdInt a, SimdInt b) { return _mm256_and_si256(a, b); }
+
+  // Unsigned 32x32 -> 64 bit products of the even 32-bit lanes
+  static SimdInt mulEven32(SimdInt a, SimdInt b)
+  {
+    return _mm256_mul_epu32(a, b);
+  }
+
+  template <int N>
+  static SimdInt shl32(SimdInt x)
+  {
+    return _mm256_slli_epi32(x, N);
+  }
+  template <int N>
+  static SimdInt shr32(SimdInt x)
+  {
+    return _mm256_srli_epi32(x, N);
+  }
+  template <int N>
+  static SimdInt shl64(SimdInt x)
+  {
+    return _mm256_slli_epi64(x, N);
+  }
+  template <int N>
+  static SimdInt shr64(SimdInt x)
+  {
+    return _mm256_srli_epi64(x, N);
+  }
+
+  // Shuffles the 32-bit lanes within each 128-bit half
+  template <int IMM>
+  static SimdInt shuffle32(SimdInt x)
+  {
+    return _mm256_shuffle_epi32(x, IMM);
+  }
+
+  // Signed 32-bit lanes converted to floats and multiplied by scale
+  static void storeScaledFloats(float* out, SimdInt x, float scale)
+  {
+    const __m256 converted = _mm256_cvtepi32_ps(x);
+    _mm256_storeu_ps(out, _mm256_mul_ps(converted, _mm256_set1_ps(scale)));
+  }
+#else
+  static SimdInt load(const void* source)
+  {
+    return _mm_loadu_si128(static_cast<const __m128i*>(source));
+  }
+  static void store(void* destination, SimdInt x)
+  {
+    _mm_storeu_si128(static_cast<__m128i*>(destination), x);
+  }
+  static SimdInt set32(uint32_t x) { return _mm_set1_epi32(int(x)); }
+  static SimdInt set64(uint64_t x) { return _mm_set1_epi64x((long long)x); }
+  static SimdInt add32(SimdInt a, SimdInt b) { return _mm_add_epi32(a, b); }
+  static SimdInt add64(SimdInt a, SimdInt b) { return _mm_add_epi64(a, b); }
+  static SimdInt xor_(SimdInt a, SimdInt b) { return _mm_xor_si128(a, b); }
+  static SimdInt or_(SimdInt a, SimdInt b) { return _mm_or_si128(a, b); }
+  static SimdInt and_(SimdInt a, SimdInt b) { return _mm_and_si128(a, b); }
+
+  // Unsigned 32x32 -> 64 bit products of the even 32-bit lanes
+  static SimdInt mulEven32(SimdInt a, SimdInt b) { return _mm_mul_epu32(a, b); }
+
+  template <int N>
+  static SimdInt shl32(SimdInt x)
+  {
+    return _mm_slli_epi32(x, N);
+  }
+  template <int N>
+  static SimdInt shr32(SimdInt x)
+  {
+    return _mm_srli_epi32(x, N);
+  }
+  template <int N>
+  static SimdInt shl64(SimdInt x)
+  {
+    return _mm_slli_epi64(x, N);
+  }
+  template <int N>
+  static SimdInt shr64(SimdInt x)
+  {
+    return _mm_srli_epi64(x, N);
+  }
+
+  // Shuffles the 32-bit lanes within each 128-bit half
+  template <int IMM>
+  static SimdInt shuffle32(SimdInt x)
+  {
+    return _mm_shuffle_epi32(x, IMM);
+  }
+
+  // Signed 32-bit lanes converted to floats and multiplied by scale
+  static void storeScaledFloats(float* out, SimdInt x, float scale)
+  {
+    const __m128 converted = _mm_cvtepi32_ps(x);
+    _mm_storeu_ps(out, _mm_mul_ps(converted, _mm_set1_ps(scale)));
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Top 24 bits of each 32-bit lane as floats in [0 -> 1)
+  //----------------------------------------------------------------------------
+  static void storeUnitFloats(float* out, SimdInt x)
+  {
+    storeScaledFloats(out, shr32<8>(x), 1.0f / 16777216.0f);
+  }
+
+  //----------------------------------------------------------------------------
+  template <int N>
+  static SimdInt rotl32(SimdInt x)
+  {
+    return or_(shl32<N>(x), shr32<32 - N>(x));
+  }
+
+  template <int N>
+  static SimdInt rotl64(SimdInt x)
+  {
+    return or_(shl64<N>(x), shr64<64 - N>(x));
+  }
+
+  //----------------------------------------------------------------------------
+  // Low 32 bits of the 32-bit lane products, from the even and odd lane
+  // multiplies (pmulld is SSE4.1, and has 10 cycle latency on Intel cores)
+  //----------------------------------------------------------------------------
+  static SimdInt mulLo32(SimdInt a, SimdInt b)
+  {
+    const SimdInt even = mulEven32(a, b);
+    const SimdInt odd  = mulEven32(shr64<32>(a), shr64<32>(b));
+    return or_(and_(even, set64(0xFFFFFFFF)), shl64<32>(odd));
+  }
+
+  //----------------------------------------------------------------------------
+  // Low 64 bits of the 64-bit lane products (there is no 64-bit multiply
+  // before AVX-512DQ): lo*lo + ((hi*lo + lo*hi) << 32)
+  //----------------------------------------------------------------------------
+  static SimdInt mulLo64(SimdInt a, SimdInt b)
+  {
+    const SimdInt cross = add64(
+      mulEven32(shr64<32>(a), b), mulEven32(a, shr64<32>(b)));
+    return add64(mulEven32(a, b), shl64<32>(cross));
+  }
+};
+
+//------------------------------------------------------------------------------
+// Scalar helpers
+//------------------------------------------------------------------------------
+inline uint64_t
+rotl64(uint64_t x, int n)
+{
+  return (x << n) | (x >> ((64 - n) & 63));
+}
+
+//------------------------------------------------------------------------------
+// Full 64x64 -> 128 bit product, returning the low half
+//------------------------------------------------------------------------------
+inline uint64_t
+mulHiLo64(uint64_t a, uint64_t b, uint64_t& hi)
+{
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 product = (unsigned __int128)a * b;
+  hi                              = uint64_t(product >> 64);
+  return uint64_t(product);
+#else
+  unsigned long long high;
+  const uint64_t low = _umul128(a, b, &high);
+  hi                 = high;
+  return low;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// SplitMix64, used to expand seeds into generator state
+//------------------------------------------------------------------------------
+constexpr uint64_t SPLITMIX64_GAMMA = 0x9E3779B97F4A7C15ull;
+
+inline uint64_t
+splitMix64Mix(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+inline uint64_t
+splitMix64(uint64_t& state)
+{
+  state += SPLITMIX64_GAMMA;
+  return splitMix64Mix(state);
+}
+
+//------------------------------------------------------------------------------
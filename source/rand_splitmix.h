@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <cstdint>
+//------------------------------------------------------------------------------
+// SplitMix64, four consecutive outputs per call computed in SIMD lanes
+//
+// SplitMix64 is a counter (a Weyl sequence) run through a mixing function, so
+// lane i simply starts i + 1 increments ahead and every lane advances by 4
+// increments per call. The output is therefore identical to the sequential
+// generator, and discard() is O(1). The 64-bit multiplies are emulated with
+// 32-bit ones.
+//
+// Sources:
+// Steele, Lea & Flood, Fast Splittable Pseudorandom Number Generators (2014)
+//------------------------------------------------------------------------------
+struct RandSplitMix64
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_LANES     = 4;    // 64-bit outputs per call
+
+  RandSplitMix64()
+      : RandSplitMix64(0)
+  {
+  }
+
+  explicit RandSplitMix64(uint64_t seed)
+  {
+    uint64_t lanes[NUM_LANES];
+    for (size_t lane = 0; lane < NUM_LANES; ++lane)
+    {
+      lanes[lane] = seed + (lane + 1) * SPLITMIX64_GAMMA;
+    }
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      m_counter[reg] = Simd::load(&lanes[reg * SIMD_LANES64]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate()
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numCalls)
+  {
+    const SimdInt step = Simd::set64(numCalls * NUM_LANES * SPLITMIX64_GAMMA);
+    for (auto& counter : m_counter)
+    {
+      counter = Simd::add64(counter, step);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    const SimdInt STEP = Simd::set64(NUM_LANES * SPLITMIX64_GAMMA);
+    const SimdInt M1   = Simd::set64(0xBF58476D1CE4E5B9ull);
+    const SimdInt M2   = Simd::set64(0x94D049BB133111EBull);
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      SimdInt z      = m_counter[reg];
+      m_counter[reg] = Simd::add64(z, STEP);
+
+      z = Simd::mulLo64(Simd::xor_(z, Simd::shr64<30>(z)), M1);
+      z = Simd::mulLo64(Simd::xor_(z, Simd::shr64<27>(z)), M2);
+      z = Simd::xor_(z, Simd::shr64<31>(z));
+
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), z);
+    }
+  }
+
+private:
+  SimdInt m_counter[SIMD_REGS_PER_BLOCK];
+};
+
+//------------------------------------------------------------------------------
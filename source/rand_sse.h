@@ -6,6 +6,10 @@
 #include <x86intrin.h>
 #endif
 
+#include "rand_simd.h"
+
+#include <cstdint>
+
 //------------------------------------------------------------------------------
 // Modified from:
 // https://software.intel.com/en-us/articles/fast-random-number-generator-on-the-intel-pentiumr-4-processor/
@@ -15,6 +19,18 @@ struct RandSSE
   static const size_t NUM_GENERATED = 8;
 
   RandSSE() { cur_seed = _mm_set_epi32(666, 667, 666, 667); }
+  explicit RandSSE(uint32_t seed)
+  {
+    // Give each lane a different starting point. Lanes 0 and 2 share a
+    // multiplier and their increments agree mod 2^16, so their low halves
+    // repeat each other if their states ever do; starting them an odd distance
+    // apart keeps them apart for every seed.
+    cur_seed = _mm_set_epi32(
+      int(seed * 0x9E3779B9u + 666),
+      int(seed * 0x85EBCA6Bu + 668),
+      int(seed * 0xC2B2AE35u + 666),
+      int(seed * 0x27D4EB2Fu + 667));
+  }
 
   //----------------------------------------------------------------------------
   // convert to floats in range [0 -> 1)
@@ -69,3 +85,159 @@ private:
 };
 
 //------------------------------------------------------------------------------
+// RandSSE widened to 8 lanes, 16 values per call
+//
+// Lanes 0 -> 3 are RandSSE's four LCGs, seeded the same way (unseeded, lane 2
+// starts one further on than in RandSSE, whose lanes 0 and 2 then repeat each
+// other's low halves). Lanes 4 -> 7 are four other full period LCGs (Numerical
+// Recipes, Borland C, ANSI C and Delphi; a = 1 mod 4 and c odd), seeded with
+// differently mixed states, so an AVX2 register holds 8 distinct streams. (The
+// same LCG offset by half its period would only flip bit 31, repeating the low
+// halves of lanes 0 -> 3.) Each step is one 32-bit multiply-add per lane, using
+// even/odd lane multiplies as RandSSE does.
+//
+// Every lane is an affine map s -> a*s + c (mod 2^32), and n steps of it are
+// the affine map (a^n, c*(a^(n-1) + ... + a + 1)), built by squaring in
+// O(log n). discard() jumps every lane that way, so independent threads can
+// each skip to their own part of one stream.
+//
+// Output is the low 16 bits of lanes 0 -> 7, then their high 16 bits, as in
+// RandSSE.
+//------------------------------------------------------------------------------
+struct RandSSEx8
+{
+  static const size_t NUM_GENERATED = 16;
+  static const size_t NUM_LANES     = 8;
+
+  static constexpr uint32_t MULTIPLIERS[NUM_LANES] = {214013,
+                                                      17405,
+                                                      214013,
+                                                      69069,
+                                                      1664525,
+                                                      22695477,
+                                                      1103515245,
+                                                      134775813};
+  static constexpr uint32_t INCREMENTS[NUM_LANES] = {2531011,
+                                                     10395331,
+                                                     13737667,
+                                                     1,
+                                                     1013904223,
+                                                     1,
+                                                     12345,
+                                                     1};
+
+  RandSSEx8()
+  {
+    alignas(32) const uint32_t states[NUM_LANES]
+      = {667, 666, 668, 666, 667, 666, 667, 666};
+    load(states);
+  }
+
+  explicit RandSSEx8(uint32_t seed)
+  {
+    alignas(32) const uint32_t states[NUM_LANES]
+      = {seed * 0x27D4EB2Fu + 667,
+         seed * 0xC2B2AE35u + 666,
+         seed * 0x85EBCA6Bu + 668,
+         seed * 0x9E3779B9u + 666,
+         seed * 0x165667B1u + 667,
+         seed * 0xD3A2646Du + 666,
+         seed * 0xFD7046C5u + 667,
+         seed * 0xB55A4F09u + 666};
+    load(states);
+  }
+
+  //----------------------------------------------------------------------------
+  // No two lanes step the same affine map
+  //----------------------------------------------------------------------------
+  static constexpr bool hasDistinctLanes()
+  {
+    for (size_t a = 0; a < NUM_LANES; ++a)
+    {
+      for (size_t b = a + 1; b < NUM_LANES; ++b)
+      {
+        if (MULTIPLIERS[a] == MULTIPLIERS[b] && INCREMENTS[a] == INCREMENTS[b])
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar reference: numSteps steps of the lane's LCG in O(log numSteps)
+  //----------------------------------------------------------------------------
+  static uint32_t jump(uint32_t state, size_t lane, uint64_t numSteps)
+  {
+    uint32_t multiplier     = MULTIPLIERS[lane];
+    uint32_t increment      = INCREMENTS[lane];
+    uint32_t jumpMultiplier = 1;
+    uint32_t jumpIncrement  = 0;
+    for (; numSteps != 0; numSteps >>= 1)
+    {
+      if (numSteps & 1)
+      {
+        jumpMultiplier *= multiplier;
+        jumpIncrement = (jumpIncrement * multiplier) + increment;
+      }
+      increment *= multiplier + 1;
+      multiplier *= multiplier;
+    }
+    return (jumpMultiplier * state) + jumpIncrement;
+  }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate()
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numCalls)
+  {
+    alignas(32) uint32_t states[NUM_LANES];
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      Simd::store(&states[reg * SIMD_LANES32], m_state[reg]);
+    }
+    for (size_t lane = 0; lane < NUM_LANES; ++lane)
+    {
+      states[lane] = jump(states[lane], lane, numCalls);
+    }
+    load(states);
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    static const float INV_RANGE = 1.0f / (65535.f + 0.01f);
+    const SimdInt lowMask        = Simd::set32(0x0000FFFF);
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      const SimdInt multipliers
+        = Simd::load(&MULTIPLIERS[reg * SIMD_LANES32]);
+      const SimdInt increments = Simd::load(&INCREMENTS[reg * SIMD_LANES32]);
+      m_state[reg]
+        = Simd::add32(Simd::mulLo32(m_state[reg], multipliers), increments);
+
+      float* out = result + (reg * SIMD_LANES32);
+      Simd::storeScaledFloats(
+        out, Simd::and_(m_state[reg], lowMask), INV_RANGE);
+      Simd::storeScaledFloats(
+        out + NUM_LANES, Simd::shr32<16>(m_state[reg]), INV_RANGE);
+    }
+  }
+
+private:
+  void load(const uint32_t states[NUM_LANES])
+  {
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      m_state[reg] = Simd::load(&states[reg * SIMD_LANES32]);
+    }
+  }
+
+  SimdInt m_state[SIMD_REGS_PER_BLOCK];
+};
+
+static_assert(
+  RandSSEx8::hasDistinctLanes(), "Every RandSSEx8 lane needs its own LCG");
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <cstdint>
+//------------------------------------------------------------------------------
+// wyrand, four consecutive outputs per call
+//
+// Like SplitMix64, wyrand mixes a Weyl sequence, so the four outputs of a call
+// don't depend on each other and run in parallel in the pipeline. Its mixing
+// is a full 64x64 -> 128 bit multiply (mulx/_umul128), which has no SIMD form
+// before AVX-512, so the lanes are scalar.
+//
+// Sources:
+// Wang Yi, wyhash: https://github.com/wangyi-fudan/wyhash
+//------------------------------------------------------------------------------
+struct RandWyrand
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_LANES     = 4;    // 64-bit outputs per call
+
+  static const uint64_t INCREMENT = 0xA0761D6478BD642Full;
+  static const uint64_t MIX       = 0xE7037ED1A0B428DBull;
+
+  RandWyrand() = default;
+  explicit RandWyrand(uint64_t seed)
+      : m_state(seed)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Skip the next numCalls calls to generate()
+  //----------------------------------------------------------------------------
+  void discard(uint64_t numCalls)
+  {
+    m_state += numCalls * NUM_LANES * INCREMENT;
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    uint64_t outputs[NUM_LANES];
+    for (size_t lane = 0; lane < NUM_LANES; ++lane)
+    {
+      const uint64_t state = m_state + (lane + 1) * INCREMENT;
+      uint64_t hi;
+      const uint64_t lo = mulHiLo64(state, state ^ MIX, hi);
+      outputs[lane]     = lo ^ hi;
+    }
+    m_state += NUM_LANES * INCREMENT;
+
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      const SimdInt bits = Simd::load(&outputs[reg * SIMD_LANES64]);
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), bits);
+    }
+  }
+
+private:
+  uint64_t m_state = 0;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "rand_simd.h"
+
+#include <cstdint>
+//------------------------------------------------------------------------------
+// xoshiro256++ and xoshiro128+, several independent streams side by side in
+// SIMD lanes
+//
+// The streams are one seeded state jump()ed ahead by 2^128 (xoshiro256) or
+// 2^64 (xoshiro128) calls per lane, so they never overlap. Each call steps
+// every lane once and converts the 32 bytes of output to 8 floats.
+//
+// Sources:
+// Blackman & Vigna, Scrambled Linear Pseudorandom Number Generators (2018)
+// https://prng.di.unimi.it/
+//------------------------------------------------------------------------------
+struct RandXoshiro256pp
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_STREAMS   = 4;    // 64-bit lanes
+
+  RandXoshiro256pp()
+      : RandXoshiro256pp(0)
+  {
+  }
+
+  explicit RandXoshiro256pp(uint64_t seed)
+  {
+    uint64_t state[4];
+    for (auto& word : state)
+    {
+      word = splitMix64(seed);
+    }
+
+    uint64_t lanes[4][NUM_STREAMS];
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      for (size_t word = 0; word < 4; ++word)
+      {
+        lanes[word][stream] = state[word];
+      }
+      jump(state);
+    }
+    for (size_t word = 0; word < 4; ++word)
+    {
+      for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+      {
+        m_state[word][reg] = Simd::load(&lanes[word][reg * SIMD_LANES64]);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      SimdInt& s0 = m_state[0][reg];
+      SimdInt& s1 = m_state[1][reg];
+      SimdInt& s2 = m_state[2][reg];
+      SimdInt& s3 = m_state[3][reg];
+
+      const SimdInt output
+        = Simd::add64(Simd::rotl64<23>(Simd::add64(s0, s3)), s0);
+      const SimdInt t = Simd::shl64<17>(s1);
+      s2              = Simd::xor_(s2, s0);
+      s3              = Simd::xor_(s3, s1);
+      s1              = Simd::xor_(s1, s2);
+      s0              = Simd::xor_(s0, s3);
+      s2              = Simd::xor_(s2, t);
+      s3              = Simd::rotl64<45>(s3);
+
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), output);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar reference step, returning the next 64-bit output
+  //----------------------------------------------------------------------------
+  static uint64_t next(uint64_t s[4])
+  {
+    const uint64_t result = rotl64(s[0] + s[3], 23) + s[0];
+    const uint64_t t      = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  // Equivalent to 2^128 calls to next()
+  //----------------------------------------------------------------------------
+  static void jump(uint64_t s[4])
+  {
+    static const uint64_t JUMP[] = {0x180EC6D33CFD0ABAull,
+                                    0xD5A61266F0C9392Cull,
+                                    0xA9582618E03FC9AAull,
+                                    0x39ABDC4529B1661Cull};
+    uint64_t t[4] = {};
+    for (uint64_t jump : JUMP)
+    {
+      for (int bit = 0; bit < 64; ++bit)
+      {
+        if (jump & (uint64_t(1) << bit))
+        {
+          for (int i = 0; i < 4; ++i)
+          {
+            t[i] ^= s[i];
+          }
+        }
+        next(s);
+      }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+      s[i] = t[i];
+    }
+  }
+
+private:
+  SimdInt m_state[4][SIMD_REGS_PER_BLOCK];
+};
+
+//------------------------------------------------------------------------------
+// Only the upper bits of xoshiro128+ pass every test (the lowest bits are
+// weak), which is fine here: the float conversion uses the top 24.
+//------------------------------------------------------------------------------
+struct RandXoshiro128p
+{
+  static const size_t NUM_GENERATED = 8;
+  static const size_t NUM_STREAMS   = 8;    // 32-bit lanes
+
+  RandXoshiro128p()
+      : RandXoshiro128p(0)
+  {
+  }
+
+  explicit RandXoshiro128p(uint64_t seed)
+  {
+    uint32_t state[4];
+    for (size_t i = 0; i < 4; i += 2)
+    {
+      const uint64_t bits = splitMix64(seed);
+      state[i]            = uint32_t(bits);
+      state[i + 1]        = uint32_t(bits >> 32);
+    }
+
+    uint32_t lanes[4][NUM_STREAMS];
+    for (size_t stream = 0; stream < NUM_STREAMS; ++stream)
+    {
+      for (size_t word = 0; word < 4; ++word)
+      {
+        lanes[word][stream] = state[word];
+      }
+      jump(state);
+    }
+    for (size_t word = 0; word < 4; ++word)
+    {
+      for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+      {
+        m_state[word][reg] = Simd::load(&lanes[word][reg * SIMD_LANES32]);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void generate(float result[NUM_GENERATED])
+  {
+    for (size_t reg = 0; reg < SIMD_REGS_PER_BLOCK; ++reg)
+    {
+      SimdInt& s0 = m_state[0][reg];
+      SimdInt& s1 = m_state[1][reg];
+      SimdInt& s2 = m_state[2][reg];
+      SimdInt& s3 = m_state[3][reg];
+
+      const SimdInt output = Simd::add32(s0, s3);
+      const SimdInt t      = Simd::shl32<9>(s1);
+      s2                   = Simd::xor_(s2, s0);
+      s3                   = Simd::xor_(s3, s1);
+      s1                   = Simd::xor_(s1, s2);
+      s0                   = Simd::xor_(s0, s3);
+      s2                   = Simd::xor_(s2, t);
+      s3                   = Simd::rotl32<11>(s3);
+
+      Simd::storeUnitFloats(result + (reg * SIMD_LANES32), output);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar reference step, returning the next 32-bit output
+  //----------------------------------------------------------------------------
+  static uint32_t next(uint32_t s[4])
+  {
+    const uint32_t result = s[0] + s[3];
+    const uint32_t t      = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  // Equivalent to 2^64 calls to next()
+  //----------------------------------------------------------------------------
+  static void jump(uint32_t s[4])
+  {
+    static const uint32_t JUMP[]
+      = {0x8764000B, 0xF542D2D3, 0x6FA035C3, 0x77F2DB5B};
+    uint32_t t[4] = {};
+    for (uint32_t jump : JUMP)
+    {
+      for (int bit = 0; bit < 32; ++bit)
+      {
+        if (jump & (uint32_t(1) << bit))
+        {
+          for (int i = 0; i < 4; ++i)
+          {
+            t[i] ^= s[i];
+          }
+        }
+        next(s);
+      }
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+      s[i] = t[i];
+    }
+  }
+
+private:
+  SimdInt m_state[4][SIMD_REGS_PER_BLOCK];
+};
+
+//------------------------------------------------------------------------------
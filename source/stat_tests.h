@@ -0,0 +1,557 @@
+#pragma once
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+// Streaming statistical test battery for generators of floats in [0 -> 1)
+//
+// Every test is an accumulator that consumes chunks of values and keeps only
+// fixed size state, so any number of samples can be tested in constant memory.
+// Each thread runs its own independently seeded stream; the per-thread state is
+// merged at the end and turned into p-values.
+//
+// Tests:
+//  - Chi-square over 1024 and 65536 equal buckets
+//  - Kolmogorov-Smirnov, evaluated at the 65536 bucket edges. Most generators
+//    here only carry 16 bits per float, for which the edges are exact.
+//  - Serial correlation of consecutive values
+//  - Runs above/below 0.5 (the number of crossings is Binomial(n - 1, 0.5))
+//  - Gap test for values in [0.25 -> 0.5)
+//  - Birthday spacings (Marsaglia) with 4096 32-bit birthdays per trial
+//
+// Sources:
+// Knuth, The Art of Computer Programming Vol 2, 3.3.2 Empirical Tests
+// Marsaglia, DIEHARD battery (birthday spacings)
+// Numerical Recipes 6.2 (incomplete gamma), 14.3 (Kolmogorov-Smirnov)
+//------------------------------------------------------------------------------
+constexpr size_t BATTERY_CHUNK_SIZE = 1 << 16;    // floats (256KB, fits in L2)
+
+struct TestResult
+{
+  std::string name;
+  double statistic = 0.0;
+  double pValue    = 1.0;
+};
+
+//------------------------------------------------------------------------------
+// Upper regularized incomplete gamma function Q(a, x)
+//------------------------------------------------------------------------------
+inline double
+regularizedGammaQ(double a, double x)
+{
+  static const int MAX_ITERATIONS = 100'000;
+  static const double EPSILON     = 1e-15;
+  static const double TINY        = 1e-300;
+
+  if (x <= 0.0)
+  {
+    return 1.0;
+  }
+
+  const double logPrefix = -x + (a * std::log(x)) - std::lgamma(a);
+  if (x < a + 1.0)
+  {
+    // Series expansion of P(a, x)
+    double ap  = a;
+    double del = 1.0 / a;
+    double sum = del;
+    for (int i = 0; i < MAX_ITERATIONS; ++i)
+    {
+      ap += 1.0;
+      del *= x / ap;
+      sum += del;
+      if (std::fabs(del) < std::fabs(sum) * EPSILON)
+      {
+        break;
+      }
+    }
+    return std::max(0.0, 1.0 - (sum * std::exp(logPrefix)));
+  }
+
+  // Continued fraction for Q(a, x) (modified Lentz)
+  double b = x + 1.0 - a;
+  double c = 1.0 / TINY;
+  double d = 1.0 / b;
+  double h = d;
+  for (int i = 1; i < MAX_ITERATIONS; ++i)
+  {
+    const double an = -i * (i - a);
+    b += 2.0;
+    d = (an * d) + b;
+    d = (std::fabs(d) < TINY) ? TINY : d;
+    c = b + (an / c);
+    c = (std::fabs(c) < TINY) ? TINY : c;
+    d = 1.0 / d;
+
+    const double del = d * c;
+    h *= del;
+    if (std::fabs(del - 1.0) < EPSILON)
+    {
+      break;
+    }
+  }
+  return std::min(1.0, std::exp(logPrefix) * h);
+}
+
+//------------------------------------------------------------------------------
+inline double
+chiSquarePValue(double chiSquare, double degreesOfFreedom)
+{
+  return regularizedGammaQ(degreesOfFreedom * 0.5, chiSquare * 0.5);
+}
+
+//------------------------------------------------------------------------------
+inline double
+normalTwoSidedPValue(double z)
+{
+  return std::erfc(std::fabs(z) / std::sqrt(2.0));
+}
+
+//------------------------------------------------------------------------------
+// Asymptotic Kolmogorov distribution with the Stephens correction
+//------------------------------------------------------------------------------
+inline double
+kolmogorovPValue(double d, double n)
+{
+  const double sqrtN  = std::sqrt(n);
+  const double lambda = (sqrtN + 0.12 + (0.11 / sqrtN)) * d;
+  if (lambda < 0.3)
+  {
+    return 1.0;
+  }
+
+  double sum  = 0.0;
+  double sign = 1.0;
+  for (int k = 1; k <= 100; ++k)
+  {
+    const double term = sign * std::exp(-2.0 * k * k * lambda * lambda);
+    sum += term;
+    if (std::fabs(term) < 1e-16)
+    {
+      break;
+    }
+    sign = -sign;
+  }
+  return std::min(1.0, std::max(0.0, 2.0 * sum));
+}
+
+//------------------------------------------------------------------------------
+inline double
+poissonTwoSidedPValue(uint64_t observed, double lambda)
+{
+  // P(X <= k) and P(X >= k)
+  const double k     = double(observed);
+  const double lower = regularizedGammaQ(k + 1.0, lambda);
+  const double upper
+    = (observed == 0) ? 1.0 : 1.0 - regularizedGammaQ(k, lambda);
+  return std::min(1.0, 2.0 * std::min(lower, upper));
+}
+
+//------------------------------------------------------------------------------
+// Chi-square of observed counts against expected counts.
+// Trailing bins with an expected count below 5 are merged into one.
+//------------------------------------------------------------------------------
+inline TestResult
+chiSquareTest(
+  const std::string& name,
+  const std::vector<uint64_t>& observed,
+  const std::vector<double>& expected)
+{
+  double chiSquare = 0.0;
+  size_t numBins   = 0;
+  double tailObs   = 0.0;
+  double tailExp   = 0.0;
+  for (size_t i = 0; i < observed.size(); ++i)
+  {
+    tailObs += double(observed[i]);
+    tailExp += expected[i];
+    if (tailExp >= 5.0)
+    {
+      const double diff = tailObs - tailExp;
+      chiSquare += (diff * diff) / tailExp;
+      ++numBins;
+      tailObs = 0.0;
+      tailExp = 0.0;
+    }
+  }
+  if (tailExp > 0.0)
+  {
+    const double diff = tailObs - tailExp;
+    chiSquare += (diff * diff) / tailExp;
+    ++numBins;
+  }
+
+  TestResult result;
+  result.name      = name;
+  result.statistic = chiSquare;
+  result.pValue
+    = (numBins > 1) ? chiSquarePValue(chiSquare, double(numBins - 1)) : 1.0;
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Per-stream accumulator for the whole battery
+//------------------------------------------------------------------------------
+struct BatteryAccumulator
+{
+  static constexpr size_t NUM_BUCKETS   = 1 << 16;
+  static constexpr size_t NUM_COARSE    = 1 << 10;
+  static constexpr size_t NUM_GAP_BINS  = 64;
+  static constexpr size_t NUM_BIRTHDAYS = 4096;
+  static constexpr float GAP_LOWER      = 0.25f;
+  static constexpr float GAP_UPPER      = 0.5f;
+
+  uint64_t numValues            = 0;
+  uint64_t numOutOfRange        = 0;
+  std::vector<uint64_t> buckets = std::vector<uint64_t>(NUM_BUCKETS);
+
+  // Serial correlation and runs (consecutive pairs within a stream)
+  uint64_t numPairs     = 0;
+  uint64_t numCrossings = 0;
+  double sumProducts    = 0.0;
+  float previous        = 0.0f;
+
+  // Gap test
+  uint64_t currentGap        = 0;
+  std::vector<uint64_t> gaps = std::vector<uint64_t>(NUM_GAP_BINS + 1);
+
+  // Birthday spacings
+  uint64_t numBirthdayTrials      = 0;
+  uint64_t numBirthdayCollisions  = 0;
+  std::vector<uint32_t> birthdays = std::vector<uint32_t>(NUM_BIRTHDAYS);
+
+  //----------------------------------------------------------------------------
+  void add(const float* values, size_t count)
+  {
+    double sumProductsChunk = 0.0;
+    float prev              = previous;
+    size_t start            = 0;
+    if (numValues == 0 && count > 0)
+    {
+      prev  = values[0];
+      start = 1;
+      addSingle(values[0]);
+    }
+
+    for (size_t i = start; i < count; ++i)
+    {
+      const float x = values[i];
+      addSingle(x);
+
+      sumProductsChunk += double(prev - 0.5f) * double(x - 0.5f);
+      numCrossings += uint64_t((prev < 0.5f) != (x < 0.5f));
+      prev = x;
+    }
+    numPairs += count - start;
+    sumProducts += sumProductsChunk;
+    previous = prev;
+    numValues += count;
+
+    if (count >= NUM_BIRTHDAYS * 2)
+    {
+      birthdayTrial(values);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void merge(const BatteryAccumulator& other)
+  {
+    numValues += other.numValues;
+    numOutOfRange += other.numOutOfRange;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      buckets[i] += other.buckets[i];
+    }
+
+    numPairs += other.numPairs;
+    numCrossings += other.numCrossings;
+    sumProducts += other.sumProducts;
+
+    for (size_t i = 0; i <= NUM_GAP_BINS; ++i)
+    {
+      gaps[i] += other.gaps[i];
+    }
+
+    numBirthdayTrials += other.numBirthdayTrials;
+    numBirthdayCollisions += other.numBirthdayCollisions;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<TestResult> results() const
+  {
+    std::vector<TestResult> results;
+    const double n = double(numValues);
+
+    // Chi-square at two resolutions
+    {
+      std::vector<uint64_t> coarse(NUM_COARSE);
+      for (size_t i = 0; i < NUM_BUCKETS; ++i)
+      {
+        coarse[i / (NUM_BUCKETS / NUM_COARSE)] += buckets[i];
+      }
+      results.push_back(chiSquareTest(
+        "Chi-square (1024 buckets)",
+        coarse,
+        std::vector<double>(NUM_COARSE, n / NUM_COARSE)));
+      results.push_back(chiSquareTest(
+        "Chi-square (65536 buckets)",
+        buckets,
+        std::vector<double>(NUM_BUCKETS, n / NUM_BUCKETS)));
+    }
+
+    // Kolmogorov-Smirnov at the bucket edges
+    {
+      uint64_t cumulative = 0;
+      double maxDistance  = 0.0;
+      for (size_t i = 0; i < NUM_BUCKETS; ++i)
+      {
+        cumulative += buckets[i];
+        const double distance
+          = std::fabs((double(cumulative) / n) - (double(i + 1) / NUM_BUCKETS));
+        maxDistance = std::max(maxDistance, distance);
+      }
+
+      TestResult ks;
+      ks.name      = "Kolmogorov-Smirnov";
+      ks.statistic = maxDistance;
+      ks.pValue    = kolmogorovPValue(maxDistance, n);
+      results.push_back(ks);
+    }
+
+    // Serial correlation: E[(x - 0.5)(y - 0.5)] = 0, with variance 1/144
+    {
+      const double correlation = (sumProducts / double(numPairs)) * 12.0;
+      TestResult serial;
+      serial.name      = "Serial correlation";
+      serial.statistic = correlation;
+      serial.pValue
+        = normalTwoSidedPValue(correlation * std::sqrt(double(numPairs)));
+      results.push_back(serial);
+    }
+
+    // Runs above/below 0.5
+    {
+      const double expected = double(numPairs) * 0.5;
+      const double z
+        = (double(numCrossings) - expected) / std::sqrt(double(numPairs) * 0.25);
+      TestResult runs;
+      runs.name      = "Runs (above/below 0.5)";
+      runs.statistic = z;
+      runs.pValue    = normalTwoSidedPValue(z);
+      results.push_back(runs);
+    }
+
+    // Gap lengths are geometric with p = (upper - lower)
+    {
+      uint64_t numGaps = 0;
+      for (auto count : gaps)
+      {
+        numGaps += count;
+      }
+
+      const double p = GAP_UPPER - GAP_LOWER;
+      std::vector<double> expected(NUM_GAP_BINS + 1);
+      for (size_t r = 0; r < NUM_GAP_BINS; ++r)
+      {
+        expected[r] = double(numGaps) * p * std::pow(1.0 - p, double(r));
+      }
+      expected[NUM_GAP_BINS]
+        = double(numGaps) * std::pow(1.0 - p, double(NUM_GAP_BINS));
+      results.push_back(chiSquareTest("Gap [0.25 -> 0.5)", gaps, expected));
+    }
+
+    // Birthday spacings: duplicates ~ Poisson(m^3 / 4n) per trial
+    {
+      const double m      = double(NUM_BIRTHDAYS);
+      const double lambda = (m * m * m) / (4.0 * 4294967296.0);
+      TestResult birthday;
+      birthday.name      = "Birthday spacings";
+      birthday.statistic = double(numBirthdayCollisions);
+      birthday.pValue    = poissonTwoSidedPValue(
+        numBirthdayCollisions, lambda * double(numBirthdayTrials));
+      results.push_back(birthday);
+    }
+
+    return results;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  static uint32_t quantize16(float x)
+  {
+    const uint32_t idx = uint32_t(x * float(NUM_BUCKETS));
+    return std::min(idx, uint32_t(NUM_BUCKETS - 1));
+  }
+
+  //----------------------------------------------------------------------------
+  void addSingle(float x)
+  {
+    numOutOfRange += uint64_t(!(x >= 0.0f && x < 1.0f));
+    buckets[quantize16(x)]++;
+
+    if (x >= GAP_LOWER && x < GAP_UPPER)
+    {
+      gaps[std::min(currentGap, uint64_t(NUM_GAP_BINS))]++;
+      currentGap = 0;
+    }
+    else
+    {
+      ++currentGap;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Birthdays are 32 bits, built from the top 16 bits of two values
+  //----------------------------------------------------------------------------
+  void birthdayTrial(const float* values)
+  {
+    for (size_t i = 0; i < NUM_BIRTHDAYS; ++i)
+    {
+      birthdays[i]
+        = (quantize16(values[2 * i]) << 16) | quantize16(values[2 * i + 1]);
+    }
+    std::sort(birthdays.begin(), birthdays.end());
+
+    for (size_t i = NUM_BIRTHDAYS - 1; i > 0; --i)
+    {
+      birthdays[i] -= birthdays[i - 1];
+    }
+    std::sort(birthdays.begin() + 1, birthdays.end());
+
+    uint64_t collisions = 0;
+    for (size_t i = 2; i < NUM_BIRTHDAYS; ++i)
+    {
+      collisions += uint64_t(birthdays[i] == birthdays[i - 1]);
+    }
+
+    numBirthdayCollisions += collisions;
+    ++numBirthdayTrials;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Streams numSamples values through the battery using numThreads independent
+// streams. makeSource(streamIndex) must return an object with
+// fill(float* out, size_t count) and wholeBlocks(count), like BulkGenerator.
+//------------------------------------------------------------------------------
+template <typename MakeSource>
+std::vector<TestResult>
+runBattery(MakeSource makeSource, uint64_t numSamples, unsigned numThreads)
+{
+  numThreads = std::max(1u, numThreads);
+  std::vector<BatteryAccumulator> accumulators(numThreads);
+
+  parallelFor(numThreads, numThreads, [&](size_t stream, unsigned) {
+    const uint64_t begin = (numSamples * stream) / numThreads;
+    const uint64_t end   = (numSamples * (stream + 1)) / numThreads;
+
+    auto source = makeSource(stream);
+    std::vector<float> chunk(BATTERY_CHUNK_SIZE);
+    for (uint64_t pos = begin; pos < end; pos += BATTERY_CHUNK_SIZE)
+    {
+      const size_t count
+        = size_t(std::min<uint64_t>(BATTERY_CHUNK_SIZE, end - pos));
+      source.fill(chunk.data(), source.wholeBlocks(count));
+      accumulators[stream].add(chunk.data(), count);
+    }
+  });
+
+  for (unsigned i = 1; i < numThreads; ++i)
+  {
+    accumulators[0].merge(accumulators[i]);
+  }
+  return accumulators[0].results();
+}
+
+//------------------------------------------------------------------------------
+// Strict avalanche criterion of a 128-bit -> 128-bit function.
+// Every input bit is flipped and the change in each output bit is counted;
+// ideally each output bit flips with probability 0.5 (64 bits on average).
+// makeInput(trial, words) fills 4 random 32-bit words for the trial,
+// hash(in, out) applies the function to 4 words.
+//------------------------------------------------------------------------------
+struct AvalancheResult
+{
+  double meanFlippedBits   = 0.0;
+  double minBitProbability = 1.0;
+  double maxBitProbability = 0.0;
+  TestResult test;
+};
+
+template <typename MakeInput, typename HashFunc>
+AvalancheResult
+avalancheTest(
+  MakeInput makeInput, HashFunc hash, uint64_t numTrials, unsigned numThreads)
+{
+  static const size_t NUM_BITS = 128;
+  using Matrix                 = std::vector<uint64_t>;
+
+  numThreads = std::max(1u, numThreads);
+  std::vector<Matrix> matrices(numThreads, Matrix(NUM_BITS * NUM_BITS));
+
+  parallelFor(numThreads, numThreads, [&](size_t thread, unsigned) {
+    const uint64_t begin = (numTrials * thread) / numThreads;
+    const uint64_t end   = (numTrials * (thread + 1)) / numThreads;
+    Matrix& flips        = matrices[thread];
+
+    uint32_t input[4];
+    uint32_t output[4];
+    uint32_t flippedInput[4];
+    uint32_t flippedOutput[4];
+    for (uint64_t trial = begin; trial < end; ++trial)
+    {
+      makeInput(trial, input);
+      hash(input, output);
+      for (size_t inBit = 0; inBit < NUM_BITS; ++inBit)
+      {
+        std::copy(input, input + 4, flippedInput);
+        flippedInput[inBit / 32] ^= 1u << (inBit % 32);
+        hash(flippedInput, flippedOutput);
+
+        uint64_t* row = flips.data() + (inBit * NUM_BITS);
+        for (size_t outBit = 0; outBit < NUM_BITS; ++outBit)
+        {
+          const uint32_t diff = output[outBit / 32] ^ flippedOutput[outBit / 32];
+          row[outBit] += (diff >> (outBit % 32)) & 1u;
+        }
+      }
+    }
+  });
+
+  for (unsigned i = 1; i < numThreads; ++i)
+  {
+    for (size_t cell = 0; cell < NUM_BITS * NUM_BITS; ++cell)
+    {
+      matrices[0][cell] += matrices[i][cell];
+    }
+  }
+
+  // Each cell is Binomial(numTrials, 0.5)
+  AvalancheResult result;
+  const double trials = double(numTrials);
+  double chiSquare    = 0.0;
+  uint64_t totalFlips = 0;
+  for (uint64_t count : matrices[0])
+  {
+    const double diff = double(count) - (trials * 0.5);
+    chiSquare += (diff * diff) / (trials * 0.25);
+    totalFlips += count;
+
+    const double probability = double(count) / trials;
+    result.minBitProbability = std::min(result.minBitProbability, probability);
+    result.maxBitProbability = std::max(result.maxBitProbability, probability);
+  }
+
+  result.meanFlippedBits = double(totalFlips) / (trials * NUM_BITS);
+  result.test.name       = "Strict avalanche (128x128)";
+  result.test.statistic  = chiSquare;
+  result.test.pValue     = chiSquarePValue(chiSquare, NUM_BITS * NUM_BITS);
+  return result;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,478 @@
+#include "randocha.h"
+#include "coherent_noise.h"
+#include "cli_args.h"
+#include "parallel.h"
+#include "png_writer.h"
+
+#if _MSC_VER
+#define STBI_MSC_SECURE_CRT
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Generates large white noise textures.
+//
+// The image is split into square tiles which are filled in parallel. Each tile
+// takes its own fixed segment of the Randocha stream (skipping ahead by the
+// tile's index), so the same options always produce the same texture no matter
+// how many threads are used.
+//
+// The generator's raw 128-bit output is written straight into the channels, 16
+// 8-bit or 8 16-bit samples per call, with no float conversion.
+//
+// Coherent noise (value, Perlin or simplex, optionally as fBm octaves) is
+// evaluated over each tile's grid of pixel centres instead, one independently
+// seeded noise per channel. It's a function of the pixel position alone, so
+// the tiles join up seamlessly.
+//------------------------------------------------------------------------------
+constexpr size_t BYTES_PER_BLOCK = sizeof(__m128i);
+
+// Randocha's counter repeats after 2^32 calls
+constexpr uint64_t MAX_BLOCKS = uint64_t(1) << 32;
+
+enum class Format
+{
+  Png,
+  Bmp,
+  Raw
+};
+
+enum class Noise
+{
+  White,
+  Value,
+  Perlin,
+  Simplex
+};
+
+struct TextureOptions
+{
+  uint64_t width       = 8192;
+  uint64_t height      = 8192;
+  uint64_t numChannels = 1;
+  uint64_t bitDepth    = 8;
+  uint64_t tileSize    = 256;
+  uint64_t seed        = 0;
+  bool isSeeded        = false;
+  Format format        = Format::Png;
+  Noise noise          = Noise::White;
+  double frequency     = 1.0 / 64.0;    // lattice cells per pixel
+  FbmSettings fbm;
+  std::string fileName = "noise.png";
+  unsigned numThreads  = defaultThreadCount();
+};
+
+//------------------------------------------------------------------------------
+static void
+printUsage()
+{
+  std::cout
+    << "Usage: randocha-texture [options]\n"
+       "  --width <n>         texture width in pixels (default 8192)\n"
+       "  --height <n>        texture height in pixels (default 8192)\n"
+       "  --channels <n>      channels per pixel, 1 -> 4 (default 1)\n"
+       "  --bits <n>          bits per channel, 8 or 16 (default 8)\n"
+       "  --format <fmt>      png, bmp or raw (default: from the file\n"
+       "                      extension, otherwise png)\n"
+       "                      bmp supports 8-bit, 1 or 3 channels only\n"
+       "                      raw is tightly packed rows, 16-bit samples\n"
+       "                      in little endian order\n"
+       "  --noise <type>      white, value, perlin or simplex\n"
+       "                      (default white)\n"
+       "  --frequency <x>     coherent noise lattice cells per pixel\n"
+       "                      (default 0.015625, i.e. 64 pixel cells)\n"
+       "  --octaves <n>       fBm octaves of coherent noise (default 1)\n"
+       "  --lacunarity <x>    fBm frequency multiplier per octave (default 2)\n"
+       "  --gain <x>          fBm amplitude multiplier per octave (default\n"
+       "                      0.5)\n"
+       "  --tile <n>          tile size in pixels (default 256)\n"
+       "  --seed <n>          seed the generator (default: unseeded stream)\n"
+       "  --output <file>     output file name (default noise.png)\n"
+       "  --threads <n>       worker threads (default: all cores)\n";
+}
+
+//------------------------------------------------------------------------------
+static bool
+parseFormat(const std::string& name, Format& format)
+{
+  if (name == "png")
+  {
+    format = Format::Png;
+  }
+  else if (name == "bmp")
+  {
+    format = Format::Bmp;
+  }
+  else if (name == "raw")
+  {
+    format = Format::Raw;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+static bool
+parseNoise(const std::string& name, Noise& noise)
+{
+  if (name == "white")
+  {
+    noise = Noise::White;
+  }
+  else if (name == "value")
+  {
+    noise = Noise::Value;
+  }
+  else if (name == "perlin")
+  {
+    noise = Noise::Perlin;
+  }
+  else if (name == "simplex")
+  {
+    noise = Noise::Simplex;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// One channel of a tile: noise in [-1 -> 1] at the pixel centres, stored as
+// [0 -> max] samples every bytesPerPixel bytes
+//------------------------------------------------------------------------------
+template <NoiseType TYPE, typename Sample>
+static void
+fillNoiseChannel(
+  const TextureOptions& options,
+  const CoherentNoise<16>& noise,
+  size_t x0,
+  size_t y0,
+  size_t tileWidth,
+  size_t tileHeight,
+  float* values,
+  uint8_t* dst)
+{
+  const size_t bytesPerPixel = options.numChannels * sizeof(Sample);
+  const size_t rowStride     = options.width * bytesPerPixel;
+
+  NoiseGrid<2> grid;
+  grid.width     = tileWidth;
+  grid.height    = tileHeight;
+  grid.step      = float(options.frequency);
+  grid.origin[0] = float((double(x0) + 0.5) * options.frequency);
+  grid.origin[1] = float((double(y0) + 0.5) * options.frequency);
+  noise.evaluateGrid<TYPE>(grid, values, options.fbm);
+
+  const float maxSample = float(Sample(~Sample(0)));
+  for (size_t y = 0; y < tileHeight; ++y)
+  {
+    uint8_t* row = dst + (y * rowStride);
+    for (size_t x = 0; x < tileWidth; ++x)
+    {
+      const float value = values[y * tileWidth + x];
+      const float unit  = std::min(std::max(0.5f + 0.5f * value, 0.0f), 1.0f);
+      const Sample sample = Sample(unit * maxSample + 0.5f);
+      std::memcpy(row + (x * bytesPerPixel), &sample, sizeof(Sample));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+template <NoiseType TYPE>
+static void
+fillNoiseTile(
+  const TextureOptions& options,
+  size_t x0,
+  size_t y0,
+  size_t tileWidth,
+  size_t tileHeight,
+  float* values,
+  uint8_t* dst)
+{
+  const size_t bytesPerSample = options.bitDepth / 8;
+  for (size_t channel = 0; channel < options.numChannels; ++channel)
+  {
+    const CoherentNoise<16> noise(options.seed + channel);
+    uint8_t* channelDst = dst + (channel * bytesPerSample);
+    if (options.bitDepth == 8)
+    {
+      fillNoiseChannel<TYPE, uint8_t>(
+        options, noise, x0, y0, tileWidth, tileHeight, values, channelDst);
+    }
+    else
+    {
+      fillNoiseChannel<TYPE, uint16_t>(
+        options, noise, x0, y0, tileWidth, tileHeight, values, channelDst);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Fills the image one tile per task. Tiles are numbered in row major order and
+// every tile consumes the stream of a full tile, so edge tiles don't shift the
+// streams of the tiles after them.
+//------------------------------------------------------------------------------
+static void
+generateTiles(const TextureOptions& options, uint8_t* image)
+{
+  const size_t bytesPerPixel = options.numChannels * (options.bitDepth / 8);
+  const size_t rowStride     = options.width * bytesPerPixel;
+  const size_t tileSize      = options.tileSize;
+  const size_t tilesX        = (options.width + tileSize - 1) / tileSize;
+  const size_t tilesY        = (options.height + tileSize - 1) / tileSize;
+  const size_t blocksPerTile
+    = ((tileSize * tileSize * bytesPerPixel) + BYTES_PER_BLOCK - 1)
+      / BYTES_PER_BLOCK;
+
+  const bool isWhite = (options.noise == Noise::White);
+  std::vector<std::vector<uint8_t>> scratch(
+    std::max(1u, options.numThreads),
+    std::vector<uint8_t>(
+      isWhite ? blocksPerTile * BYTES_PER_BLOCK
+              : tileSize * tileSize * sizeof(float)));
+
+  const size_t numTiles = tilesX * tilesY;
+  parallelFor(numTiles, options.numThreads, [&](size_t tile, unsigned thread) {
+    const size_t x0           = (tile % tilesX) * tileSize;
+    const size_t y0           = (tile / tilesX) * tileSize;
+    const size_t tileWidth    = std::min<size_t>(tileSize, options.width - x0);
+    const size_t tileHeight   = std::min<size_t>(tileSize, options.height - y0);
+    const size_t tileRowBytes = tileWidth * bytesPerPixel;
+    uint8_t* dst = image + (y0 * rowStride) + (x0 * bytesPerPixel);
+    float* values = reinterpret_cast<float*>(scratch[thread].data());
+    switch (options.noise)
+    {
+      case Noise::White:
+        break;
+      case Noise::Value:
+        fillNoiseTile<NoiseType::Value>(
+          options, x0, y0, tileWidth, tileHeight, values, dst);
+        return;
+      case Noise::Perlin:
+        fillNoiseTile<NoiseType::Perlin>(
+          options, x0, y0, tileWidth, tileHeight, values, dst);
+        return;
+      case Noise::Simplex:
+        fillNoiseTile<NoiseType::Simplex>(
+          options, x0, y0, tileWidth, tileHeight, values, dst);
+        return;
+    }
+
+    const size_t numBlocks
+      = ((tileRowBytes * tileHeight) + BYTES_PER_BLOCK - 1) / BYTES_PER_BLOCK;
+
+    __m128i roundKey;
+    if (options.isSeeded)
+    {
+      randocha__seed(roundKey, options.seed);
+    }
+    else
+    {
+      randocha__init(roundKey);
+    }
+    randocha__discard(roundKey, uint64_t(tile) * blocksPerTile);
+
+    __m128i* blocks = reinterpret_cast<__m128i*>(scratch[thread].data());
+    for (size_t i = 0; i < numBlocks; ++i)
+    {
+      _mm_storeu_si128(blocks + i, randocha__generate128i(roundKey));
+    }
+
+    const uint8_t* src = scratch[thread].data();
+    for (size_t y = 0; y < tileHeight; ++y)
+    {
+      std::memcpy(dst, src, tileRowBytes);
+      src += tileRowBytes;
+      dst += rowStride;
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
+static bool
+writeTexture(const TextureOptions& options, const uint8_t* image)
+{
+  const size_t rowStride
+    = options.width * options.numChannels * (options.bitDepth / 8);
+  const char* fileName = options.fileName.c_str();
+
+  switch (options.format)
+  {
+    case Format::Png:
+      return PngWriter::write(
+        fileName,
+        uint32_t(options.width),
+        uint32_t(options.height),
+        uint32_t(options.numChannels),
+        uint32_t(options.bitDepth),
+        image,
+        rowStride);
+
+    case Format::Bmp:
+      return stbi_write_bmp(
+               fileName,
+               int(options.width),
+               int(options.height),
+               int(options.numChannels),
+               image)
+             != 0;
+
+    case Format::Raw:
+    {
+      FILE* file = std::fopen(fileName, "wb");
+      if (!file)
+      {
+        return false;
+      }
+      const size_t size  = rowStride * options.height;
+      const bool success = std::fwrite(image, 1, size, file) == size;
+      return (std::fclose(file) == 0) && success;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, char* argv[])
+{
+  CliArgs args(argc, argv);
+  if (args.has("help"))
+  {
+    printUsage();
+    return 0;
+  }
+
+  TextureOptions options;
+  options.width       = args.getUInt("width", options.width);
+  options.height      = args.getUInt("height", options.height);
+  options.numChannels = args.getUInt("channels", options.numChannels);
+  options.bitDepth    = args.getUInt("bits", options.bitDepth);
+  options.tileSize    = args.getUInt("tile", options.tileSize);
+  options.isSeeded    = args.has("seed");
+  options.seed        = args.getUInt("seed", options.seed);
+  options.fileName    = args.getString("output", options.fileName);
+  options.frequency   = args.getDouble("frequency", options.frequency);
+  options.fbm.octaves = size_t(args.getUInt("octaves", options.fbm.octaves));
+  options.fbm.lacunarity
+    = float(args.getDouble("lacunarity", options.fbm.lacunarity));
+  options.fbm.gain = float(args.getDouble("gain", options.fbm.gain));
+  options.numThreads
+    = static_cast<unsigned>(args.getUInt("threads", options.numThreads));
+
+  const size_t dot = options.fileName.rfind('.');
+  const std::string extension
+    = (dot == std::string::npos) ? "" : options.fileName.substr(dot + 1);
+  const bool isKnownExtension = (extension == "bmp" || extension == "raw");
+  const std::string formatName
+    = args.getString("format", isKnownExtension ? extension : "png");
+  if (!parseFormat(formatName, options.format))
+  {
+    args.addError("--format must be png, bmp or raw, got '" + formatName + "'");
+  }
+
+  const std::string noiseName = args.getString("noise", "white");
+  if (!parseNoise(noiseName, options.noise))
+  {
+    args.addError(
+      "--noise must be white, value, perlin or simplex, got '" + noiseName
+      + "'");
+  }
+  if (!(options.frequency > 0.0))
+  {
+    args.addError("--frequency must be greater than 0");
+  }
+  if (options.fbm.octaves < 1 || options.fbm.octaves > 16)
+  {
+    args.addError("--octaves must be between 1 and 16");
+  }
+
+  // PNG stores 31-bit dimensions; keep every format within int range
+  static const uint64_t MAX_DIMENSION = 1 << 30;
+  if (
+    options.width == 0 || options.height == 0 || options.width > MAX_DIMENSION
+    || options.height > MAX_DIMENSION)
+  {
+    args.addError("--width and --height must be between 1 and 2^30");
+  }
+  if (options.numChannels < 1 || options.numChannels > 4)
+  {
+    args.addError("--channels must be between 1 and 4");
+  }
+  if (options.bitDepth != 8 && options.bitDepth != 16)
+  {
+    args.addError("--bits must be 8 or 16");
+  }
+  if (options.tileSize == 0 || options.tileSize > 2048)
+  {
+    args.addError("--tile must be between 1 and 2048");
+  }
+  if (
+    options.format == Format::Bmp
+    && (options.bitDepth != 8
+        || (options.numChannels != 1 && options.numChannels != 3)))
+  {
+    args.addError("bmp output supports 8-bit, 1 or 3 channel textures only");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
+  const uint64_t bytesPerPixel = options.numChannels * (options.bitDepth / 8);
+  const uint64_t tileSize      = options.tileSize;
+  const uint64_t tilesX        = (options.width + tileSize - 1) / tileSize;
+  const uint64_t tilesY        = (options.height + tileSize - 1) / tileSize;
+  const uint64_t blocksPerTile
+    = ((tileSize * tileSize * bytesPerPixel) + BYTES_PER_BLOCK - 1)
+      / BYTES_PER_BLOCK;
+  if (
+    options.noise == Noise::White
+    && tilesX * tilesY * blocksPerTile > MAX_BLOCKS)
+  {
+    std::cerr << "Texture is larger than the generator's period (64GB)\n";
+    return 1;
+  }
+
+  using Clock   = std::chrono::steady_clock;
+  const auto t0 = Clock::now();
+  // Left uninitialised so the pages are first touched by the tile threads
+  std::unique_ptr<uint8_t[]> image(
+    new uint8_t[options.width * options.height * bytesPerPixel]);
+  generateTiles(options, image.get());
+  const auto t1 = Clock::now();
+
+  if (!writeTexture(options, image.get()))
+  {
+    std::cerr << "Failed writing " << options.fileName << "\n";
+    return 1;
+  }
+  const auto t2 = Clock::now();
+
+  using Seconds = std::chrono::duration<double>;
+  std::cout << "Wrote " << options.width << "x" << options.height << " "
+            << options.numChannels << "x" << options.bitDepth << "-bit "
+            << formatName << " to " << options.fileName << " (generate "
+            << Seconds(t1 - t0).count() << "s, write "
+            << Seconds(t2 - t1).count() << "s)\n";
+  return 0;
+}
+
+//------------------------------------------------------------------------------
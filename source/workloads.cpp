@@ -0,0 +1,922 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "randocha.h"
+#include "generators.h"
+#include "block_buffer.h"
+#include "bench_report.h"
+#include "cli_args.h"
+#include "cpu_topology.h"
+
+//------------------------------------------------------------------------------
+// End-to-end workloads, timed with each generator on 1 -> N pinned threads
+//
+// The micro benchmarks (randocha-bench) time the generators alone. Here the
+// random numbers feed the kind of work they're wanted for, so the timings
+// include the caller's own arithmetic and memory traffic, and show whether a
+// faster generator still matters once it's a part of the whole:
+//   pi         Monte Carlo estimate of pi, from points in the unit square
+//   integrate  Monte Carlo integral of exp(-(x^2 + y^2 + z^2)) over the cube
+//   pathtrace  per-pixel sampling as a path tracer does it: pixel jitter, lens
+//              and cosine weighted bounces with Russian roulette
+//   particles  initialising a particle system (position, Box-Muller velocity,
+//              size, lifetime and colour) into SoA arrays
+//   shuffle    Fisher-Yates shuffle of 10^8 indices, as a MergeShuffle on more
+//              than one thread
+//   sgd        stochastic gradient descent of a linear model, sampling rows
+//
+// Each thread has its own generator, seeded seed + threadIndex. The bulk
+// workloads fill chunks through BulkGenerator; those that draw values one at
+// a time read them from a BlockBuffer. Allocation, first touch and datasets
+// are prepared outside of the timed region.
+//
+// Every workload reports a result with a known expectation where there is one
+// (e.g. pi), so a broken generator shows up as well as a slow one.
+//
+// Sources:
+// Axel Bacher, Olivier Bodini, Alexandros Hollender and Jeremie Lumbroso,
+// MergeShuffle: A Very Fast, Parallel Random Permutation Algorithm (2015)
+//------------------------------------------------------------------------------
+using Clock = std::chrono::steady_clock;
+
+constexpr double PI = 3.14159265358979323846;
+
+// Samples per bulk fill, so each chunk's values stay in L1
+static const size_t SAMPLES_PER_CHUNK = 1024;
+
+//------------------------------------------------------------------------------
+struct WorkloadRun
+{
+  uint64_t numSamples = 0;
+  double seconds      = 0.0;
+  double result       = 0.0;
+};
+
+//------------------------------------------------------------------------------
+struct Workload
+{
+  const char* id;
+  const char* title;
+  const char* sampleName;    // what's counted as a sample
+  uint64_t defaultSamples;
+  const char* resultName;
+  double expected;    // NaN = no closed form
+};
+
+//------------------------------------------------------------------------------
+struct WorkloadOptions
+{
+  std::vector<std::string> workloads;     // empty = all
+  std::vector<std::string> generators;    // empty = all
+  unsigned maxThreads = 0;                // 0 = all CPUs
+  double scale        = 1.0;
+  size_t repetitions  = 3;
+  uint64_t seed       = 1;
+  std::string jsonFileName;
+  std::string csvFileName;
+};
+
+//------------------------------------------------------------------------------
+// Path tracer image and integral constants
+//------------------------------------------------------------------------------
+static const size_t IMAGE_WIDTH  = 1280;
+static const size_t IMAGE_HEIGHT = 720;
+static const size_t MAX_BOUNCES  = 4;
+
+static double
+gaussianCubeIntegral()
+{
+  // The integrand is separable: (integral of exp(-x^2) over [0 -> 1])^3
+  const double axis = 0.5 * std::sqrt(PI) * std::erf(1.0);
+  return axis * axis * axis;
+}
+
+//------------------------------------------------------------------------------
+static std::vector<Workload>
+allWorkloads()
+{
+  const double noClosedForm = std::numeric_limits<double>::quiet_NaN();
+  return {
+    {"pi", "Monte Carlo pi", "points", 100'000'000, "estimate of pi", PI},
+    {"integrate",
+     "Monte Carlo integration",
+     "points",
+     50'000'000,
+     "integral",
+     gaussianCubeIntegral()},
+    {"pathtrace",
+     "Path tracer sampling",
+     "pixel samples",
+     IMAGE_WIDTH * IMAGE_HEIGHT * 8,
+     "mean radiance",
+     noClosedForm},
+    {"particles",
+     "Particle initialisation",
+     "particles",
+     10'000'000,
+     "mean squared speed",
+     3.0},
+    {"shuffle",
+     "Fisher-Yates shuffle",
+     "elements",
+     100'000'000,
+     "fixed points",
+     1.0},
+    {"sgd",
+     "SGD index sampling",
+     "steps",
+     20'000'000,
+     "RMS weight error",
+     0.0},
+  };
+}
+
+//------------------------------------------------------------------------------
+// Runs func(threadIndex) on one thread per CPU in cpus, each pinned to its CPU,
+// and returns the seconds from releasing them all together to the last one
+// finishing
+//------------------------------------------------------------------------------
+template <typename Func>
+static double
+runPinned(const std::vector<unsigned>& cpus, Func func)
+{
+  std::atomic<unsigned> numReady(0);
+  std::atomic<bool> isStarted(false);
+
+  auto worker = [&](size_t index) {
+    pinCurrentThread(cpus[index]);
+    ++numReady;
+    while (!isStarted)
+    {
+      std::this_thread::yield();
+    }
+    func(index);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < cpus.size(); ++i)
+  {
+    threads.emplace_back(worker, i);
+  }
+  while (numReady < cpus.size())
+  {
+    std::this_thread::yield();
+  }
+
+  const auto start = Clock::now();
+  isStarted        = true;
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------
+// First of the total items in the given part, of numParts near equal parts
+//------------------------------------------------------------------------------
+static uint64_t
+partBegin(uint64_t total, size_t part, size_t numParts)
+{
+  return (total * part) / numParts;
+}
+
+//------------------------------------------------------------------------------
+// Points in the unit square that land inside the quarter circle, x4
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+monteCarloPi(
+  const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  std::vector<uint64_t> numInside(cpus.size(), 0);
+  const double seconds = runPinned(cpus, [&](size_t thread) {
+    BulkGenerator<Rand> rand(seed + thread);
+    alignas(64) float values[SAMPLES_PER_CHUNK * 2];
+
+    const uint64_t end = partBegin(numSamples, thread + 1, cpus.size());
+    uint64_t inside    = 0;
+    for (uint64_t sample = partBegin(numSamples, thread, cpus.size());
+         sample < end;
+         sample += SAMPLES_PER_CHUNK)
+    {
+      rand.fill(values, SAMPLES_PER_CHUNK * 2);
+      const size_t count
+        = size_t(std::min<uint64_t>(SAMPLES_PER_CHUNK, end - sample));
+      for (size_t i = 0; i < count; ++i)
+      {
+        const float x = values[2 * i];
+        const float y = values[2 * i + 1];
+        inside += ((x * x + y * y) < 1.0f) ? 1 : 0;
+      }
+    }
+    numInside[thread] = inside;
+  });
+
+  const uint64_t inside
+    = std::accumulate(numInside.begin(), numInside.end(), uint64_t(0));
+  return {numSamples, seconds, 4.0 * double(inside) / double(numSamples)};
+}
+
+//------------------------------------------------------------------------------
+// Mean of exp(-(x^2 + y^2 + z^2)) at points in the unit cube
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+monteCarloIntegrate(
+  const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  std::vector<double> sums(cpus.size(), 0.0);
+  const double seconds = runPinned(cpus, [&](size_t thread) {
+    BulkGenerator<Rand> rand(seed + thread);
+    alignas(64) float values[SAMPLES_PER_CHUNK * 3];
+
+    const uint64_t end = partBegin(numSamples, thread + 1, cpus.size());
+    double sum         = 0.0;
+    for (uint64_t sample = partBegin(numSamples, thread, cpus.size());
+         sample < end;
+         sample += SAMPLES_PER_CHUNK)
+    {
+      rand.fill(values, SAMPLES_PER_CHUNK * 3);
+      const size_t count
+        = size_t(std::min<uint64_t>(SAMPLES_PER_CHUNK, end - sample));
+
+      // Summed in float per chunk, then in double, to keep the precision
+      float chunkSum = 0.0f;
+      for (size_t i = 0; i < count; ++i)
+      {
+        const float x = values[3 * i];
+        const float y = values[3 * i + 1];
+        const float z = values[3 * i + 2];
+        chunkSum += std::exp(-(x * x + y * y + z * z));
+      }
+      sum += chunkSum;
+    }
+    sums[thread] = sum;
+  });
+
+  const double sum = std::accumulate(sums.begin(), sums.end(), 0.0);
+  return {numSamples, seconds, sum / double(numSamples)};
+}
+
+//------------------------------------------------------------------------------
+// The sampling side of a path tracer, against a stand-in scene: a checkered
+// floor under a sky that's brighter towards +x. Each pixel sample jitters
+// within the pixel, picks a point on the lens, then bounces off the floor in
+// cosine weighted directions until Russian roulette ends the path.
+// Rows are interleaved between the threads.
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+pathTrace(const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  const float APERTURE = 2.0f;     // lens radius, in pixels of defocus
+  const float SURVIVAL = 0.75f;    // Russian roulette after the first bounce
+
+  const size_t numPixels = IMAGE_WIDTH * IMAGE_HEIGHT;
+  const size_t samplesPerPixel
+    = size_t(std::max<uint64_t>(1, numSamples / numPixels));
+  std::vector<float> image(numPixels, 0.0f);
+
+  const double seconds = runPinned(cpus, [&](size_t thread) {
+    BlockBuffer<Rand> rand(seed + thread);
+    for (size_t y = thread; y < IMAGE_HEIGHT; y += cpus.size())
+    {
+      for (size_t x = 0; x < IMAGE_WIDTH; ++x)
+      {
+        float pixel = 0.0f;
+        for (size_t sample = 0; sample < samplesPerPixel; ++sample)
+        {
+          // Uniform on the lens disc (by rejection), then jittered in the pixel
+          float lensU, lensV;
+          do
+          {
+            lensU = 2.0f * rand.next() - 1.0f;
+            lensV = 2.0f * rand.next() - 1.0f;
+          } while ((lensU * lensU + lensV * lensV) > 1.0f);
+          const float px = float(x) + rand.next() + APERTURE * lensU;
+          const float py = float(y) + rand.next() + APERTURE * lensV;
+
+          const bool isLightSquare
+            = ((int(px * (1.0f / 32.0f)) + int(py * (1.0f / 32.0f))) & 1) != 0;
+          const float albedo = isLightSquare ? 0.8f : 0.3f;
+
+          float radiance   = 0.0f;
+          float throughput = 1.0f;
+          for (size_t bounce = 0; bounce < MAX_BOUNCES; ++bounce)
+          {
+            const float u1       = rand.next();
+            const float u2       = rand.next();
+            const float radius   = std::sqrt(u1);
+            const float phi      = float(2.0 * PI) * u2;
+            const float dirX     = radius * std::cos(phi);
+            const float cosTheta = std::sqrt(1.0f - u1);
+
+            throughput *= albedo;
+            radiance += throughput * cosTheta * (0.75f + 0.25f * dirX);
+            if (bounce != 0)
+            {
+              if (rand.next() >= SURVIVAL)
+              {
+                break;
+              }
+              throughput *= 1.0f / SURVIVAL;
+            }
+          }
+          pixel += radiance;
+        }
+        image[y * IMAGE_WIDTH + x] = pixel / float(samplesPerPixel);
+      }
+    }
+  });
+
+  double sum = 0.0;
+  for (float pixel : image)
+  {
+    sum += pixel;
+  }
+  return {numPixels * samplesPerPixel, seconds, sum / double(numPixels)};
+}
+
+//------------------------------------------------------------------------------
+// Particle attributes as separate arrays (SoA), as a SIMD update loop wants
+//------------------------------------------------------------------------------
+struct Particles
+{
+  explicit Particles(size_t count)
+      : x(count)
+      , y(count)
+      , z(count)
+      , vx(count)
+      , vy(count)
+      , vz(count)
+      , size(count)
+      , lifetime(count)
+      , hue(count)
+      , brightness(count)
+  {
+  }
+
+  std::vector<float> x, y, z;
+  std::vector<float> vx, vy, vz;
+  std::vector<float> size;
+  std::vector<float> lifetime;
+  std::vector<float> hue, brightness;
+};
+
+//------------------------------------------------------------------------------
+// Positions uniform in a box, velocities normal per axis (Box-Muller), with
+// the fourth normal of the two pairs jittering the size, and uniform lifetime
+// and colour: 10 values per particle
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+initParticles(
+  const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  const size_t VALUES_PER_PARTICLE = 10;
+  const float BOX                  = 10.0f;
+
+  Particles particles(numSamples);
+  const double seconds = runPinned(cpus, [&](size_t thread) {
+    BulkGenerator<Rand> rand(seed + thread);
+    alignas(64) float values[SAMPLES_PER_CHUNK * VALUES_PER_PARTICLE];
+
+    const uint64_t end = partBegin(numSamples, thread + 1, cpus.size());
+    for (uint64_t first = partBegin(numSamples, thread, cpus.size());
+         first < end;
+         first += SAMPLES_PER_CHUNK)
+    {
+      rand.fill(values, SAMPLES_PER_CHUNK * VALUES_PER_PARTICLE);
+      const size_t count
+        = size_t(std::min<uint64_t>(SAMPLES_PER_CHUNK, end - first));
+      for (size_t i = 0; i < count; ++i)
+      {
+        const float* u  = values + i * VALUES_PER_PARTICLE;
+        const size_t at = size_t(first) + i;
+
+        // 1 - u is in (0 -> 1], so the log is finite
+        const float r0   = std::sqrt(-2.0f * std::log(1.0f - u[3]));
+        const float r1   = std::sqrt(-2.0f * std::log(1.0f - u[5]));
+        const float phi0 = float(2.0 * PI) * u[4];
+        const float phi1 = float(2.0 * PI) * u[6];
+
+        particles.x[at]          = BOX * (2.0f * u[0] - 1.0f);
+        particles.y[at]          = BOX * (2.0f * u[1] - 1.0f);
+        particles.z[at]          = BOX * (2.0f * u[2] - 1.0f);
+        particles.vx[at]         = r0 * std::cos(phi0);
+        particles.vy[at]         = r0 * std::sin(phi0);
+        particles.vz[at]         = r1 * std::cos(phi1);
+        particles.size[at]       = 1.0f + 0.1f * r1 * std::sin(phi1);
+        particles.lifetime[at]   = 1.0f + 4.0f * u[7];
+        particles.hue[at]        = u[8];
+        particles.brightness[at] = 0.5f + 0.5f * u[9];
+      }
+    }
+  });
+
+  double sum = 0.0;
+  for (size_t i = 0; i < numSamples; ++i)
+  {
+    sum += particles.vx[i] * particles.vx[i] + particles.vy[i] * particles.vy[i]
+           + particles.vz[i] * particles.vz[i];
+  }
+  return {numSamples, seconds, sum / double(numSamples)};
+}
+
+//------------------------------------------------------------------------------
+// Fisher-Yates over values[begin -> end), which may be empty (when there are
+// fewer elements than threads)
+//------------------------------------------------------------------------------
+template <typename Rand>
+static void
+fisherYates(
+  BlockBuffer<Rand>& rand,
+  std::vector<uint32_t>& values,
+  size_t begin,
+  size_t end)
+{
+  if (end - begin < 2)
+  {
+    return;
+  }
+  for (size_t i = end - 1; i > begin; --i)
+  {
+    const size_t j = begin + size_t(rand.nextIndex(i - begin + 1));
+    std::swap(values[i], values[j]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// MergeShuffle's merge of the shuffled runs values[begin -> middle) and
+// values[middle -> end) into one shuffled run: coin flips take from either run
+// until one is used up, then the rest are inserted by Fisher-Yates
+//------------------------------------------------------------------------------
+template <typename Rand>
+static void
+mergeShuffled(
+  BlockBuffer<Rand>& rand,
+  std::vector<uint32_t>& values,
+  size_t begin,
+  size_t middle,
+  size_t end)
+{
+  size_t i = begin;
+  size_t j = middle;
+  for (;; ++i)
+  {
+    if (rand.next() < 0.5f)
+    {
+      if (i == j)
+      {
+        break;
+      }
+    }
+    else
+    {
+      if (j == end)
+      {
+        break;
+      }
+      std::swap(values[i], values[j++]);
+    }
+  }
+
+  for (; i < end; ++i)
+  {
+    const size_t k = begin + size_t(rand.nextIndex(i - begin + 1));
+    std::swap(values[i], values[k]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// A uniform permutation of 0 -> numSamples. On one thread it's a plain
+// Fisher-Yates. On T threads, T runs are shuffled in parallel, then merged
+// pairwise with MergeShuffle, halving the threads at each level.
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+shuffle(const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  std::vector<uint32_t> values(numSamples);
+  std::iota(values.begin(), values.end(), 0u);
+
+  std::vector<size_t> bounds(cpus.size() + 1);
+  for (size_t i = 0; i <= cpus.size(); ++i)
+  {
+    bounds[i] = size_t(partBegin(numSamples, i, cpus.size()));
+  }
+
+  double seconds = runPinned(cpus, [&](size_t thread) {
+    BlockBuffer<Rand> rand(seed + thread);
+    fisherYates(rand, values, bounds[thread], bounds[thread + 1]);
+  });
+
+  // Each level seeds its generators after those of the levels before
+  uint64_t levelSeed = seed + cpus.size();
+  while (bounds.size() > 2)
+  {
+    const size_t numPairs = (bounds.size() - 1) / 2;
+    const std::vector<unsigned> pairCpus(cpus.begin(), cpus.begin() + numPairs);
+    seconds += runPinned(pairCpus, [&](size_t pair) {
+      BlockBuffer<Rand> rand(levelSeed + pair);
+      mergeShuffled(
+        rand,
+        values,
+        bounds[2 * pair],
+        bounds[2 * pair + 1],
+        bounds[2 * pair + 2]);
+    });
+    levelSeed += numPairs;
+
+    // Drop the middle bound of each pair (an odd last run carries over)
+    std::vector<size_t> merged;
+    for (size_t i = 0; i < bounds.size(); i += 2)
+    {
+      merged.push_back(bounds[i]);
+    }
+    if (merged.back() != bounds.back())
+    {
+      merged.push_back(bounds.back());
+    }
+    bounds = merged;
+  }
+
+  uint64_t numFixed = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    numFixed += (values[i] == i) ? 1 : 0;
+  }
+  return {numSamples, seconds, double(numFixed)};
+}
+
+//------------------------------------------------------------------------------
+// Linear regression data: y = x . TRUE_WEIGHTS + noise, x uniform in [-1 -> 1)
+//------------------------------------------------------------------------------
+struct SgdDataset
+{
+  static const size_t NUM_ROWS     = 1 << 20;
+  static const size_t NUM_FEATURES = 16;
+
+  std::vector<float> features;    // NUM_ROWS x NUM_FEATURES, row major
+  std::vector<float> targets;
+  float trueWeights[NUM_FEATURES];
+
+  //----------------------------------------------------------------------------
+  // Built once, from a fixed generator, so every run trains on the same data
+  //----------------------------------------------------------------------------
+  static const SgdDataset& get()
+  {
+    static const SgdDataset dataset;
+    return dataset;
+  }
+
+private:
+  SgdDataset()
+      : features(NUM_ROWS * NUM_FEATURES)
+      , targets(NUM_ROWS)
+  {
+    for (size_t i = 0; i < NUM_FEATURES; ++i)
+    {
+      trueWeights[i] = (float(i) - 7.5f) / 8.0f;
+    }
+
+    BulkGenerator<Randocha> rand(0);
+    alignas(64) float values[NUM_FEATURES + Randocha::NUM_GENERATED];
+    for (size_t row = 0; row < NUM_ROWS; ++row)
+    {
+      rand.fill(values);
+      float target = 0.01f * (values[NUM_FEATURES] - 0.5f);
+      for (size_t i = 0; i < NUM_FEATURES; ++i)
+      {
+        const float x                    = 2.0f * values[i] - 1.0f;
+        features[row * NUM_FEATURES + i] = x;
+        target += x * trueWeights[i];
+      }
+      targets[row] = target;
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+// Plain SGD on the squared error, with a row sampled uniformly at each step.
+// Each thread trains its own weights on its share of the steps, and the
+// weights are averaged at the end (one shot parameter averaging).
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+stochasticGradient(
+  const std::vector<unsigned>& cpus, uint64_t numSamples, uint64_t seed)
+{
+  const size_t NUM_FEATURES = SgdDataset::NUM_FEATURES;
+  const float LEARNING_RATE = 0.02f;
+
+  const SgdDataset& dataset = SgdDataset::get();
+  std::vector<float> weights(cpus.size() * NUM_FEATURES, 0.0f);
+
+  const double seconds = runPinned(cpus, [&](size_t thread) {
+    BlockBuffer<Rand> rand(seed + thread);
+    float w[NUM_FEATURES] = {};
+
+    const uint64_t numSteps = partBegin(numSamples, thread + 1, cpus.size())
+                              - partBegin(numSamples, thread, cpus.size());
+    for (uint64_t step = 0; step < numSteps; ++step)
+    {
+      const size_t row = size_t(rand.nextIndex(SgdDataset::NUM_ROWS));
+      const float* x   = &dataset.features[row * NUM_FEATURES];
+
+      float prediction = 0.0f;
+      for (size_t i = 0; i < NUM_FEATURES; ++i)
+      {
+        prediction += x[i] * w[i];
+      }
+      const float gradient
+        = LEARNING_RATE * (prediction - dataset.targets[row]);
+      for (size_t i = 0; i < NUM_FEATURES; ++i)
+      {
+        w[i] -= gradient * x[i];
+      }
+    }
+    std::copy(w, w + NUM_FEATURES, &weights[thread * NUM_FEATURES]);
+  });
+
+  double sumSquares = 0.0;
+  for (size_t i = 0; i < NUM_FEATURES; ++i)
+  {
+    double average = 0.0;
+    for (size_t thread = 0; thread < cpus.size(); ++thread)
+    {
+      average += weights[thread * NUM_FEATURES + i];
+    }
+    average /= double(cpus.size());
+    const double error = average - dataset.trueWeights[i];
+    sumSquares += error * error;
+  }
+  return {numSamples, seconds, std::sqrt(sumSquares / double(NUM_FEATURES))};
+}
+
+//------------------------------------------------------------------------------
+template <typename Rand>
+static WorkloadRun
+runWorkload(
+  const Workload& workload,
+  const std::vector<unsigned>& cpus,
+  uint64_t numSamples,
+  uint64_t seed)
+{
+  const std::string id = workload.id;
+  if (id == "pi")
+  {
+    return monteCarloPi<Rand>(cpus, numSamples, seed);
+  }
+  if (id == "integrate")
+  {
+    return monteCarloIntegrate<Rand>(cpus, numSamples, seed);
+  }
+  if (id == "pathtrace")
+  {
+    return pathTrace<Rand>(cpus, numSamples, seed);
+  }
+  if (id == "particles")
+  {
+    return initParticles<Rand>(cpus, numSamples, seed);
+  }
+  if (id == "shuffle")
+  {
+    return shuffle<Rand>(cpus, numSamples, seed);
+  }
+  return stochasticGradient<Rand>(cpus, numSamples, seed);
+}
+
+//------------------------------------------------------------------------------
+static void
+printHeading(const std::string& title)
+{
+  std::cout << "\n\n"
+            << title << "\n"
+            << std::string(title.size(), '=') << "\n";
+}
+
+//------------------------------------------------------------------------------
+static bool
+isSelected(const std::vector<std::string>& selection, const std::string& id)
+{
+  return selection.empty()
+         || std::find(selection.begin(), selection.end(), id)
+              != selection.end();
+}
+
+//------------------------------------------------------------------------------
+// Every selected generator on 1 -> maxThreads threads (powers of two, and
+// maxThreads), keeping the fastest of the repetitions. Threads are placed on
+// separate physical cores first, then on SMT siblings.
+//------------------------------------------------------------------------------
+static void
+runWorkloads(const WorkloadOptions& options, BenchReport& report)
+{
+  const CpuTopology topology = CpuTopology::query();
+  const std::vector<unsigned> order = topology.spreadOrder();
+  const unsigned maxThreads
+    = (options.maxThreads == 0) ? unsigned(order.size()) : options.maxThreads;
+
+  std::cout << "\n" << topology.cores.size() << " cores, " << order.size()
+            << " logical CPUs available\n";
+
+  std::vector<unsigned> threadCounts;
+  for (unsigned n = 1; n < maxThreads; n *= 2)
+  {
+    threadCounts.push_back(n);
+  }
+  threadCounts.push_back(maxThreads);
+
+  for (auto& workload : allWorkloads())
+  {
+    if (!isSelected(options.workloads, workload.id))
+    {
+      continue;
+    }
+
+    const uint64_t numSamples = std::max<uint64_t>(
+      1, uint64_t(double(workload.defaultSamples) * options.scale));
+    const std::string expected
+      = std::isnan(workload.expected)
+          ? std::string("")
+          : fmt::format(", expected {:.6g}", workload.expected);
+    printHeading(fmt::format(
+      "{} ({} {}, result: {}{})",
+      workload.title,
+      numSamples,
+      workload.sampleName,
+      workload.resultName,
+      expected));
+    std::cout << "  generator          threads    wall ms  Msamples/s  speedup"
+                 "  result\n";
+
+    forEachGenerator([&](auto entry) {
+      using Rand = typename decltype(entry)::Type;
+      if (!isSelected(options.generators, entry.id))
+      {
+        return;
+      }
+
+      double singleSeconds = 0.0;
+      for (unsigned numThreads : threadCounts)
+      {
+        // More threads than CPUs wrap around (and are oversubscribed)
+        std::vector<unsigned> cpus(numThreads);
+        for (unsigned i = 0; i < numThreads; ++i)
+        {
+          cpus[i] = order[i % order.size()];
+        }
+
+        WorkloadRun best;
+        best.seconds = std::numeric_limits<double>::max();
+        for (size_t rep = 0; rep < options.repetitions; ++rep)
+        {
+          const WorkloadRun run
+            = runWorkload<Rand>(workload, cpus, numSamples, options.seed);
+          best = (run.seconds < best.seconds) ? run : best;
+        }
+        singleSeconds = (numThreads == 1) ? best.seconds : singleSeconds;
+        const double samplesPerSecond = double(best.numSamples) / best.seconds;
+        const double speedup          = singleSeconds / best.seconds;
+
+        std::cout << fmt::format(
+          "  {:<18} {:>7} {:>10.1f} {:>11.2f} {:>7.2f}x  {:.6g}\n",
+          entry.title,
+          numThreads,
+          best.seconds * 1e3,
+          samplesPerSecond / 1e6,
+          speedup,
+          best.result);
+        std::cout << std::flush;
+
+        report.beginRecord();
+        report.add("mode", "workload");
+        report.add("workload", workload.id);
+        report.add("generator", entry.id);
+        report.add("threads", uint64_t(numThreads));
+        report.add("samples", best.numSamples);
+        report.add("seconds", best.seconds);
+        report.add("samples_per_second", samplesPerSecond);
+        report.add("speedup", speedup);
+        report.add("result", best.result);
+        if (!std::isnan(workload.expected))
+        {
+          report.add("expected", workload.expected);
+        }
+      }
+    });
+  }
+}
+
+//------------------------------------------------------------------------------
+static void
+printUsage()
+{
+  std::cout
+    << "Usage: randocha-workloads [options]\n"
+       "  --workloads <list>  comma separated, from: pi, integrate,\n"
+       "                      pathtrace, particles, shuffle, sgd\n"
+       "                      (default: all)\n"
+       "  --generators <list> comma separated, from: randocha, sse, sse8,\n"
+       "                      tea, tea_simd, mt, sfmt, xoshiro256pp,\n"
+       "                      xoshiro128p, pcg32, pcg64, wyrand, splitmix64,\n"
+       "                      philox (default: all)\n"
+       "  --max-threads <n>   most threads to scale to (default: all CPUs)\n"
+       "  --scale <x>         multiplies every workload's size (default 1)\n"
+       "  --repetitions <n>   runs of each, keeping the fastest (default 3)\n"
+       "  --seed <n>          first thread's seed (default 1)\n"
+       "  --json <file>       write the results as JSON\n"
+       "  --csv <file>        write the results as CSV\n";
+}
+
+//------------------------------------------------------------------------------
+int
+main(int argc, char* argv[])
+{
+  CliArgs args(argc, argv);
+  if (args.has("help"))
+  {
+    printUsage();
+    return 0;
+  }
+
+  WorkloadOptions options;
+  options.workloads    = args.getList("workloads");
+  options.generators   = args.getList("generators");
+  options.maxThreads   = unsigned(args.getUInt("max-threads", 0));
+  options.scale        = args.getDouble("scale", options.scale);
+  options.repetitions  = size_t(args.getUInt("repetitions", 3));
+  options.seed         = args.getUInt("seed", options.seed);
+  options.jsonFileName = args.getString("json", "");
+  options.csvFileName  = args.getString("csv", "");
+
+  const std::vector<Workload> workloads = allWorkloads();
+  for (auto& id : options.workloads)
+  {
+    auto matches = [&id](const Workload& w) { return id == w.id; };
+    if (std::none_of(workloads.begin(), workloads.end(), matches))
+    {
+      args.addError("Unknown workload: " + id);
+    }
+  }
+  for (auto& id : options.generators)
+  {
+    bool isKnown = false;
+    forEachGenerator([&](auto entry) { isKnown |= (id == entry.id); });
+    if (!isKnown)
+    {
+      args.addError("Unknown generator: " + id);
+    }
+  }
+  if (!(options.scale > 0.0))
+  {
+    args.addError("--scale must be greater than 0");
+  }
+  if (options.repetitions == 0)
+  {
+    args.addError("--repetitions must be at least 1");
+  }
+  if (!args.validate(std::cerr))
+  {
+    printUsage();
+    return 1;
+  }
+
+  if (!randocha__isAesSupported())
+  {
+    std::cout << "AES-NI not supported on this CPU. Terminating.\n";
+    return 1;
+  }
+
+  const SystemInfo system = SystemInfo::query();
+  std::cout << "CPU: " << system.cpuModel << "\n";
+  BenchReport report(system);
+  runWorkloads(options, report);
+
+  if (!options.jsonFileName.empty() && !report.writeJson(options.jsonFileName))
+  {
+    std::cerr << "Failed writing " << options.jsonFileName << "\n";
+    return 1;
+  }
+  if (!options.csvFileName.empty() && !report.writeCsv(options.csvFileName))
+  {
+    std::cerr << "Failed writing " << options.csvFileName << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------